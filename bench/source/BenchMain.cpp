@@ -0,0 +1,35 @@
+// Entry point for BBSynthBench. Same as BENCHMARK_MAIN(), except that the
+// results are also written to BBSynthBench.json unless --benchmark_out is
+// given, so every run leaves something to compare against:
+// $ compare.py benchmarks before.json after.json
+// (compare.py is in the tools folder of google/benchmark)
+import JuceImports;
+import std;
+
+#include <benchmark/benchmark.h>
+
+int main(int argc, char* argv[]) {
+  // the apvts (used by the voice benchmark) expects the message manager to
+  // exist
+  const juce::ScopedJuceInitialiser_GUI juce_initialiser;
+
+  std::vector<char*> args{argv, argv + argc};
+  std::string out_arg{"--benchmark_out=BBSynthBench.json"};
+  std::string out_format_arg{"--benchmark_out_format=json"};
+  const auto has_out = std::ranges::any_of(args, [](const char* arg) {
+    return std::string_view{arg}.starts_with("--benchmark_out=");
+  });
+  if (!has_out) {
+    args.push_back(out_arg.data());
+    args.push_back(out_format_arg.data());
+  }
+
+  auto num_args = static_cast<int>(args.size());
+  benchmark::Initialize(&num_args, args.data());
+  if (benchmark::ReportUnrecognizedArguments(num_args, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+import JuceImports;
+import std;
+
+#include <benchmark/benchmark.h>
+
+namespace audio_plugin_bench {
+// host sample rate. Kernels that run oversampled are benchmarked at
+// kSampleRate * kDefaultOversample.
+constexpr double kSampleRate = 48000.0;
+
+// host block sizes
+inline const std::vector<std::int64_t> kBlockSizes{32, 128, 512};
+// MIDI notes, low to high
+inline const std::vector<std::int64_t> kNotes{36, 60, 96};
+
+/**
+ * Adds the ns_per_sample counter (and items_per_second) to the benchmark's
+ * results. Call after the benchmark loop.
+ * @param samples_per_iteration samples processed by each iteration of the
+ * benchmark loop, at whatever rate the benchmarked code runs at
+ */
+inline void SetNsPerSample(benchmark::State& state,
+                           const int samples_per_iteration) {
+  state.SetItemsProcessed(state.iterations() * samples_per_iteration);
+  // an inverted rate is seconds per (counted) sample, so counting samples in
+  // units of 1e-9 gives ns per sample. The console output still suffixes it
+  // with "s", as it does every rate.
+  state.counters["ns_per_sample"] = benchmark::Counter{
+      static_cast<double>(samples_per_iteration) * 1e-9,
+      benchmark::Counter::kIsIterationInvariantRate |
+          benchmark::Counter::kInvert};
+}
+
+/**
+ * Fills the first channel with a naive (aliased) saw, a stand-in for
+ * oscillator output when benchmarking what comes after the oscillator.
+ */
+inline void FillSaw(juce::AudioBuffer<float>& buffer, const double freq,
+                    const double sample_rate, const float amplitude = 1.f) {
+  auto* data = buffer.getWritePointer(0);
+  const auto phase_delta = freq / sample_rate;
+  auto phase = 0.0;
+  for (auto i = 0; i < buffer.getNumSamples(); ++i) {
+    data[i] = amplitude * static_cast<float>(2 * phase - 1);
+    phase += phase_delta;
+    phase -= std::floor(phase);
+  }
+}
+}  // namespace audio_plugin_bench
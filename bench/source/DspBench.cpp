@@ -0,0 +1,112 @@
+// Benchmarks for the smaller DSP building blocks: envelope, downsampler and
+// the ADAA tanh.
+import JuceImports;
+import std;
+
+#include <../../plugin/source/Constants.h>
+#include <../../plugin/source/dsp/AnalogADSR.h>
+#include <../../plugin/source/dsp/Downsampler.h>
+#include <../../plugin/source/dsp/FastMath.h>
+#include <../../plugin/source/dsp/TanhADAA.h>
+
+#include "BenchUtils.h"
+
+namespace audio_plugin_bench {
+namespace {
+using audio_plugin::kDefaultOversample;
+
+enum class EnvelopeStage { kAttack, kDecay, kSustain, kRelease };
+
+// args: block size, EnvelopeStage
+// Every block is written from the start of the stage (the note is
+// retriggered each block), with stages long enough to outlast the block.
+void BM_AnalogADSRWriteEnvelopeToBuffer(benchmark::State& state) {
+  const auto block_size = static_cast<int>(state.range(0));
+  const auto stage = static_cast<EnvelopeStage>(state.range(1));
+
+  audio_plugin::AnalogADSR envelope;
+  envelope.Prepare(kSampleRate);
+  // a stage of 0 seconds is skipped, so leave out the ones before the stage
+  // being benchmarked
+  const auto attack = stage == EnvelopeStage::kAttack ? 1.f : 0.f;
+  const auto decay =
+      stage == EnvelopeStage::kAttack || stage == EnvelopeStage::kDecay ? 1.f
+                                                                        : 0.f;
+  envelope.Configure(attack, decay, .5f, 1.f);
+
+  juce::AudioBuffer<float> buffer{1, block_size};
+  for (auto _ : state) {
+    envelope.NoteOn();
+    if (stage == EnvelopeStage::kRelease) {
+      envelope.NoteOff();
+    }
+    envelope.WriteEnvelopeToBuffer(buffer, 0, block_size);
+    benchmark::ClobberMemory();
+  }
+  SetNsPerSample(state, block_size);
+}
+BENCHMARK(BM_AnalogADSRWriteEnvelopeToBuffer)
+    ->ArgNames({"block", "stage"})
+    ->ArgsProduct({kBlockSizes, {0, 1, 2, 3}});
+
+// args: block size
+// ns_per_sample is per oversampled (input) sample.
+void BM_DownsamplerProcess(benchmark::State& state) {
+  const auto block_size = static_cast<int>(state.range(0));
+  const auto num_samples = block_size * kDefaultOversample;
+
+  audio_plugin::Downsampler downsampler;
+  downsampler.prepare(block_size, kDefaultOversample);
+  juce::AudioBuffer<float> input{1, num_samples};
+  FillSaw(input, 440.0, kSampleRate * kDefaultOversample);
+  juce::AudioBuffer<float> output{1, block_size};
+  for (auto _ : state) {
+    downsampler.process(input, output, 0, num_samples);
+    benchmark::ClobberMemory();
+  }
+  SetNsPerSample(state, num_samples);
+}
+BENCHMARK(BM_DownsamplerProcess)->ArgName("block")->ArgsProduct({kBlockSizes});
+
+// args: block size, input gain, MathQuality
+// Quiet input mostly takes the small step (Taylor series) branch, hot input
+// the antiderivative one.
+template <audio_plugin::MathQuality kQuality>
+void TanhADAAProcess(benchmark::State& state) {
+  const auto block_size = static_cast<int>(state.range(0));
+  const auto gain = static_cast<float>(state.range(1));
+  const auto num_samples = block_size * kDefaultOversample;
+
+  audio_plugin::TanhADAA tanh;
+  // a slow saw, so the quiet input's steps stay small
+  juce::AudioBuffer<float> input{1, num_samples};
+  FillSaw(input, 10.0, kSampleRate * kDefaultOversample, gain / 10.f);
+  const auto* in = input.getReadPointer(0);
+  std::vector<float> output(static_cast<std::size_t>(num_samples));
+  for (auto _ : state) {
+    for (auto i = 0; i < num_samples; ++i) {
+      output[static_cast<std::size_t>(i)] = tanh.process<kQuality>(in[i]);
+    }
+    benchmark::ClobberMemory();
+  }
+  SetNsPerSample(state, num_samples);
+}
+
+void BM_TanhADAAProcess(benchmark::State& state) {
+  switch (static_cast<audio_plugin::MathQuality>(state.range(2))) {
+    case audio_plugin::MathQuality::kFast:
+      TanhADAAProcess<audio_plugin::MathQuality::kFast>(state);
+      break;
+    case audio_plugin::MathQuality::kHigh:
+      TanhADAAProcess<audio_plugin::MathQuality::kHigh>(state);
+      break;
+    case audio_plugin::MathQuality::kExact:
+      TanhADAAProcess<audio_plugin::MathQuality::kExact>(state);
+      break;
+  }
+}
+BENCHMARK(BM_TanhADAAProcess)
+    ->ArgNames({"block", "gain", "quality"})
+    ->ArgsProduct({kBlockSizes, {1, 100}, {0, 1, 2}});
+}  // namespace
+}  // namespace audio_plugin_bench
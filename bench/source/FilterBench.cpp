@@ -0,0 +1,109 @@
+// Benchmarks for the two OTA ladder filters, run on a saw at the oversampled
+// rate, as in the voice.
+import JuceImports;
+import std;
+
+#include <../../plugin/source/Constants.h>
+#include <../../plugin/source/filter/OTAFilterDelayedFeedback.h>
+#include <../../plugin/source/filter/OTAFilterTPTNewtonRaphson.h>
+
+#include "BenchUtils.h"
+
+namespace audio_plugin_bench {
+namespace {
+using audio_plugin::kDefaultOversample;
+
+// Both filters compute tanh(x / drive) * drive, so the lowest drive
+// (kMinDrive, also the default) saturates the most and a high drive is
+// nearly linear.
+struct FilterSetting {
+  // reported with the results, so the JSON says what each setting is
+  const char* label;
+  float cutoff_freq;
+  float resonance;
+  float drive;
+  int num_stages;
+  // of the saw going in
+  float level = 1.f;
+};
+
+// indexed by the "setting" arg
+constexpr std::array kFilterSettings{
+    FilterSetting{"open, default drive (saturated)", audio_plugin::kMaxCutoff,
+                  0.f, audio_plugin::kMinDrive, 4},
+    // the usual case
+    FilterSetting{"resonant, default drive (saturated)", 1000.f, 2.f,
+                  audio_plugin::kMinDrive, 4},
+    FilterSetting{"self-oscillating, driven hard", 1000.f, 4.f,
+                  audio_plugin::kMinDrive, 4},
+    FilterSetting{"resonant -12 dB, default drive (saturated)", 1000.f, 2.f,
+                  audio_plugin::kMinDrive, 2},
+    // quiet for the drive, so the tanh stages stay linear
+    FilterSetting{"clean pad, high drive (nearly linear)", 1000.f, 1.f, 10.f,
+                  4, .2f},
+};
+
+template <typename Filter>
+void Configure(Filter& filter, const FilterSetting& setting) {
+  filter.cutoff_freq_ = setting.cutoff_freq;
+  filter.resonance_ = setting.resonance;
+  filter.drive_ = setting.drive;
+  filter.env_mod_ = 0.f;
+  filter.lfo_mod_ = 0.f;
+  filter.set_num_stages(setting.num_stages);
+  filter.input_drive_scales_.fill(1.f);
+  filter.state_drive_scales_.fill(1.f);
+  filter.set_sample_rate(kSampleRate * kDefaultOversample);
+  filter.Reset();
+}
+
+// args: block size, index into kFilterSettings
+template <typename Filter>
+void BM_FilterProcess(benchmark::State& state) {
+  const auto block_size = static_cast<int>(state.range(0));
+  const auto& setting =
+      kFilterSettings[static_cast<std::size_t>(state.range(1))];
+  const auto num_samples = block_size * kDefaultOversample;
+
+  // env and lfo are both unused here
+  audio_plugin::ModulationBus mod_bus;
+  mod_bus.Prepare(block_size);
+  Filter filter{mod_bus};
+  Configure(filter, setting);
+
+  juce::AudioBuffer<float> input{1, num_samples};
+  FillSaw(input, 110.0, kSampleRate * kDefaultOversample, setting.level);
+  juce::AudioBuffer<float> buffer{1, num_samples};
+  for (auto _ : state) {
+    // the filter works in place, so start from the same input every block
+    buffer.copyFrom(0, 0, input, 0, 0, num_samples);
+    filter.Process(buffer, 0, num_samples);
+    benchmark::ClobberMemory();
+  }
+  SetNsPerSample(state, num_samples);
+  state.SetLabel(setting.label);
+  if constexpr (std::is_same_v<Filter,
+                               audio_plugin::OTAFilterTPTNewtonRaphson>) {
+    // how hard the Newton-Raphson solve works, on average, for each sample
+    const auto& stats = filter.solver_stats();
+    state.counters["iterations_per_sample"] =
+        static_cast<double>(stats.iterations) /
+        static_cast<double>(stats.samples);
+    state.counters["linear_fraction"] =
+        static_cast<double>(stats.linear_samples) /
+        static_cast<double>(stats.samples);
+  }
+}
+
+const std::vector<std::int64_t> kFilterSettingIndices{0, 1, 2, 3, 4};
+
+BENCHMARK(BM_FilterProcess<audio_plugin::OTAFilterDelayedFeedback>)
+    ->Name("BM_OTAFilterDelayedFeedbackProcess")
+    ->ArgNames({"block", "setting"})
+    ->ArgsProduct({kBlockSizes, kFilterSettingIndices});
+BENCHMARK(BM_FilterProcess<audio_plugin::OTAFilterTPTNewtonRaphson>)
+    ->Name("BM_OTAFilterTPTNewtonRaphsonProcess")
+    ->ArgNames({"block", "setting"})
+    ->ArgsProduct({kBlockSizes, kFilterSettingIndices});
+}  // namespace
+}  // namespace audio_plugin_bench
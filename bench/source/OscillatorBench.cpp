@@ -0,0 +1,180 @@
+// Oscillator benchmarks: the wave generator, the minBLEP residual on its own,
+// a whole voice (oscillators, filter and VCA) and the processor playing
+// chords across its voices.
+import JuceImports;
+import std;
+
+#include <../../plugin/source/Constants.h>
+#include <../../plugin/source/PluginProcessor.h>
+#include <../../plugin/source/oscillator/MinBlepGenerator.h>
+#include <../../plugin/source/oscillator/Oscillator.h>
+#include <../../plugin/source/oscillator/WaveGenerator.h>
+
+#include "BenchUtils.h"
+
+namespace audio_plugin_bench {
+namespace {
+using audio_plugin::kDefaultOversample;
+
+// args: block size, MIDI note, WaveType, phase accumulator (0 or 1)
+void BM_WaveGeneratorRenderNextBlock(benchmark::State& state) {
+  const auto block_size = static_cast<int>(state.range(0));
+  const auto note = static_cast<int>(state.range(1));
+  const auto wave_type = static_cast<audio_plugin::WaveType>(state.range(2));
+  const auto phase_accumulator = state.range(3) != 0;
+  const auto num_samples = block_size * kDefaultOversample;
+  const auto sample_rate = kSampleRate * kDefaultOversample;
+
+  // no modulation
+  audio_plugin::ModulationBus mod_bus;
+  mod_bus.Prepare(block_size);
+  juce::Array<float> hard_sync_reset_sample_indices;
+  audio_plugin::WaveGenerator<false> generator{mod_bus,
+                                               hard_sync_reset_sample_indices};
+  generator.PrepareToPlay(sample_rate, num_samples);
+  generator.set_mode(audio_plugin::ANTIALIAS);
+  generator.set_wave_type(wave_type);
+  generator.set_phase_accumulator_enabled(phase_accumulator);
+  generator.set_pitch_semitone(note, sample_rate);
+
+  juce::AudioBuffer<float> output{1, num_samples};
+  for (auto _ : state) {
+    // the generator adds to the output, same as in the voice
+    output.clear();
+    generator.RenderNextBlock(output, 0, num_samples);
+    benchmark::ClobberMemory();
+  }
+  SetNsPerSample(state, num_samples);
+}
+BENCHMARK(BM_WaveGeneratorRenderNextBlock)
+    ->ArgNames({"block", "note", "wave", "phase"})
+    ->ArgsProduct({kBlockSizes, kNotes,
+                   {audio_plugin::sine, audio_plugin::sawFall,
+                    audio_plugin::triangle, audio_plugin::square},
+                   {0, 1}});
+
+// args: block size, MIDI note
+// Adds one blep per period of the note (like a saw would) and mixes them in,
+// so the cost includes AddBlep for the kernel picked for the note.
+void BM_MinBlepGeneratorProcessBlock(benchmark::State& state) {
+  const auto block_size = static_cast<int>(state.range(0));
+  const auto note = static_cast<int>(state.range(1));
+  const auto num_samples = block_size * kDefaultOversample;
+  const auto period =
+      kSampleRate * kDefaultOversample /
+      juce::MidiMessage::getMidiNoteInHertz(note);
+
+  audio_plugin::MinBlepGenerator generator;
+  generator.Prepare(num_samples);
+  generator.SelectTable(1 / period);
+
+  // never cleared - only the time taken matters, not the output
+  std::vector<float> output(static_cast<std::size_t>(num_samples));
+  // sample (from the start of the block) of the next blep
+  auto next_blep = 0.0;
+  for (auto _ : state) {
+    for (; next_blep < num_samples; next_blep += period) {
+      generator.AddBlep({.offset = -next_blep, .pos_change_magnitude = 2});
+    }
+    next_blep -= num_samples;
+    generator.ProcessBlock(output.data(), num_samples);
+    benchmark::ClobberMemory();
+  }
+  SetNsPerSample(state, num_samples);
+}
+BENCHMARK(BM_MinBlepGeneratorProcessBlock)
+    ->ArgNames({"block", "note"})
+    ->ArgsProduct({kBlockSizes, kNotes});
+
+void SetParameter(audio_plugin::AudioPluginAudioProcessor& processor,
+                  const audio_plugin::ParamId id, const float value) {
+  auto* parameter = processor.apvts_.getParameter(audio_plugin::ToString(id));
+  parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+// args: block size, MIDI note, waveType choice, vcfFilterType choice,
+// filterDrive, max oversampling factor
+// ns_per_sample is per host sample here - the voice renders factor samples
+// for each, at whatever factor (up to the max) it picks for the note.
+void BM_OscillatorVoiceRenderNextBlock(benchmark::State& state) {
+  const auto block_size = static_cast<int>(state.range(0));
+  const auto note = static_cast<int>(state.range(1));
+
+  // the voice reads its parameters from the processor's apvts, defaults
+  // apart from the ones being benchmarked
+  audio_plugin::AudioPluginAudioProcessor processor;
+  SetParameter(processor, audio_plugin::ParamId::kWaveType,
+               static_cast<float>(state.range(2)));
+  SetParameter(processor, audio_plugin::ParamId::kVcfFilterType,
+               static_cast<float>(state.range(3)));
+  SetParameter(processor, audio_plugin::ParamId::kFilterDrive,
+               static_cast<float>(state.range(4)));
+  const audio_plugin::ParameterTable params{processor.apvts_};
+
+  juce::AudioBuffer<float> lfo_buffer{1, block_size};
+  lfo_buffer.clear();
+  audio_plugin::VoiceBus voice_bus;
+  voice_bus.Prepare(block_size);
+  // the synth owns the voice and is what starts the note on it
+  juce::Synthesiser synth;
+  auto* voice = new audio_plugin::OscillatorVoice{lfo_buffer, voice_bus};
+  synth.addVoice(voice);
+  synth.addSound(new audio_plugin::OscillatorSound{processor.apvts_});
+  synth.setCurrentPlaybackSampleRate(kSampleRate);
+  voice->Prepare(kSampleRate, block_size);
+  voice->set_max_oversample_factor(static_cast<int>(state.range(5)));
+  voice->Configure(params, audio_plugin::ParameterChanges{}.set());
+  synth.noteOn(1, note, 1.f);
+
+  // unused - the voice renders into the voice bus
+  juce::AudioBuffer<float> output{2, block_size};
+  for (auto _ : state) {
+    voice_bus.Clear(block_size);
+    voice->renderNextBlock(output, 0, block_size);
+    benchmark::ClobberMemory();
+  }
+  SetNsPerSample(state, block_size);
+}
+BENCHMARK(BM_OscillatorVoiceRenderNextBlock)
+    ->ArgNames({"block", "note", "wave", "filter", "drive", "max_oversample"})
+    // sine, saw and square, through each filter type (0: DFB, 1: TPT,
+    // 2: disabled), gently and hard driven
+    ->ArgsProduct(
+        {kBlockSizes, kNotes, {0, 1, 3}, {0, 1, 2}, {1, 5}, {1, 2, 4, 8}});
+
+// args: block size, number of notes held, vcfFilterType choice
+// The whole processBlock, so the cost of a chord includes everything shared
+// between voices: the voice bus' downsampling, the TPT filter bank, the LFO
+// and the effects. Compare the ns_per_sample (per host sample) for 16 notes
+// against 1 and 2 for what polyphony costs.
+void BM_ProcessorChord(benchmark::State& state) {
+  const auto block_size = static_cast<int>(state.range(0));
+  const auto num_notes = static_cast<int>(state.range(1));
+
+  audio_plugin::AudioPluginAudioProcessor processor;
+  SetParameter(processor, audio_plugin::ParamId::kVcfFilterType,
+               static_cast<float>(state.range(2)));
+  processor.prepareToPlay(kSampleRate, block_size);
+
+  juce::AudioBuffer<float> output{2, block_size};
+  // held for the whole benchmark, a minor third apart from C2 up. Sustain
+  // is on by default, so the voices keep playing.
+  juce::MidiBuffer midi;
+  for (int i = 0; i < num_notes; ++i) {
+    midi.addEvent(juce::MidiMessage::noteOn(1, 36 + 3 * i, 1.f), 0);
+  }
+  processor.processBlock(output, midi);
+  midi.clear();
+
+  for (auto _ : state) {
+    processor.processBlock(output, midi);
+    benchmark::ClobberMemory();
+  }
+  SetNsPerSample(state, block_size);
+}
+BENCHMARK(BM_ProcessorChord)
+    ->ArgNames({"block", "notes", "filter"})
+    // DFB (one voice at a time) and TPT (run together in the filter bank)
+    ->ArgsProduct({kBlockSizes, {1, 2, 4, 8, 16}, {0, 1}});
+}  // namespace
+}  // namespace audio_plugin_bench
@@ -1,7 +1,20 @@
 #pragma once
 
 namespace audio_plugin {
-constexpr auto kOversample = 2;
+// the voices run at 1 << n times the host rate, for n < kNumOversampleFactors
+// (each voice picks n per note, up to what the Oversampling / Offline
+// Oversampling parameters allow)
+constexpr auto kNumOversampleFactors = 4;
+constexpr auto kMaxOversample = 1 << (kNumOversampleFactors - 1);
+// what the voices ran at before it was selectable (pitch is still tuned
+// relative to it, see OscillatorVoice::PitchSampleRate)
+constexpr auto kDefaultOversample = 2;
+// number of voices the synth can play at once
+constexpr auto kNumVoices = 16;
+// how long the voice mix's gain takes to follow the number of voices playing
+constexpr auto kVoiceGainRampSeconds = .05;
+// the LFO is rendered once every this many samples and interpolated in between
+constexpr auto kLfoControlInterval = 16;
 // at drive slider of "0" we still want SOME drive - the "natural" drive of the OTA.
 // Having 0 actual drive creates instability;
 constexpr auto kMinDrive = .5f;
@@ -0,0 +1,55 @@
+import JuceImports;
+import std;
+
+#include "Parameters.h"
+
+namespace audio_plugin {
+
+void ParameterChangeQueue::Push(const ParamId id) {
+  const auto index = std::to_underlying(id);
+  pending_[index / kBitsPerWord].fetch_or(
+      std::uint64_t{1} << (index % kBitsPerWord), std::memory_order_release);
+}
+
+ParameterChanges ParameterChangeQueue::PopAll() {
+  ParameterChanges changes;
+  for (std::size_t word = 0; word < pending_.size(); ++word) {
+    // cheap early out for the common case of nothing changing
+    if (pending_[word].load(std::memory_order_relaxed) == 0) continue;
+    auto bits = pending_[word].exchange(0, std::memory_order_acquire);
+    while (bits != 0) {
+      const auto bit = static_cast<std::size_t>(std::countr_zero(bits));
+      changes.set(word * kBitsPerWord + bit);
+      bits &= bits - 1;
+    }
+  }
+  return changes;
+}
+
+ParameterChangeListener::ParameterChangeListener(
+    juce::AudioProcessorValueTreeState& apvts, const ParamId id,
+    ParameterChangeQueue& queue)
+    : apvts_{apvts}, id_{id}, queue_{queue} {
+  apvts_.addParameterListener(ToString(id_), this);
+}
+
+ParameterChangeListener::~ParameterChangeListener() {
+  apvts_.removeParameterListener(ToString(id_), this);
+}
+
+void ParameterChangeListener::parameterChanged(
+    [[maybe_unused]] const juce::String& parameterID,
+    [[maybe_unused]] float newValue) {
+  // the new value is read from the ParameterTable when the change is applied
+  queue_.Push(id_);
+}
+
+ParameterTable::ParameterTable(
+    const juce::AudioProcessorValueTreeState& apvts) {
+  for (std::size_t i = 0; i < kNumParams; ++i) {
+    values_[i] = apvts.getRawParameterValue(kParamIds[i]);
+    // every ParamId must have a matching parameter in CreateParameterLayout
+    jassert(values_[i] != nullptr);
+  }
+}
+}  // namespace audio_plugin
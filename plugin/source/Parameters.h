@@ -0,0 +1,345 @@
+#pragma once
+import JuceImports;
+import std;
+
+#include "Constants.h"
+#include "dsp/FastMath.h"
+
+namespace audio_plugin {
+
+/**
+ * How a parameter is presented to the host: its kind, range and default.
+ * Built with FloatParam / ChoiceParam / BoolParam in BBSYNTH_PARAMETERS.
+ */
+struct ParamSpec {
+  enum class Kind { kFloat, kChoice, kBool };
+  static constexpr std::size_t kMaxChoices = 8;
+
+  Kind kind = Kind::kFloat;
+  // string ID (as used by the apvts and saved in plugin state)
+  const char* id = nullptr;
+  // as shown to the user
+  const char* name = nullptr;
+  // kFloat: juce::NormalisableRange's arguments
+  float min = 0.f;
+  float max = 1.f;
+  float interval = 0.f;
+  float skew = 1.f;
+  // the value for kFloat, the choice index for kChoice, 0 / 1 for kBool
+  float default_value = 0.f;
+  // kChoice
+  std::array<const char*, kMaxChoices> choices{};
+  std::size_t num_choices = 0;
+};
+
+constexpr ParamSpec FloatParam(const float min, const float max,
+                               const float interval, const float default_value,
+                               const float skew = 1.f) {
+  ParamSpec spec;
+  spec.kind = ParamSpec::Kind::kFloat;
+  spec.min = min;
+  spec.max = max;
+  spec.interval = interval;
+  spec.skew = skew;
+  spec.default_value = default_value;
+  return spec;
+}
+
+constexpr ParamSpec ChoiceParam(
+    const int default_index, const std::initializer_list<const char*> choices) {
+  ParamSpec spec;
+  spec.kind = ParamSpec::Kind::kChoice;
+  spec.default_value = static_cast<float>(default_index);
+  for (const auto* choice : choices) {
+    spec.choices[spec.num_choices++] = choice;
+  }
+  return spec;
+}
+
+constexpr ParamSpec BoolParam(const bool default_value) {
+  ParamSpec spec;
+  spec.kind = ParamSpec::Kind::kBool;
+  spec.default_value = default_value ? 1.f : 0.f;
+  return spec;
+}
+
+constexpr ParamSpec Named(ParamSpec spec, const char* id, const char* name) {
+  spec.id = id;
+  spec.name = name;
+  return spec;
+}
+
+// the quality params' choices below are indexed by these
+static_assert(kNumOversampleFactors == 4);
+static_assert(kNumMathQualities == 3);
+
+/**
+ * Every plugin parameter, in the order the layout adds them, as
+ * X(ParamId, string ID, name, ParamSpec). ParamId, kParamIds and
+ * kParamSpecs (which CreateParameterLayout is built from) all expand this,
+ * so they can't get out of step.
+ */
+#define BBSYNTH_PARAMETERS(X)                                                  \
+  /* LFO */                                                                    \
+  X(kLfoRate, "lfoRate", "LFO Rate",                                           \
+    FloatParam(0.01f, 100.f, .01f, 0.2f, .1f))                                 \
+  X(kLfoDelayTimeSeconds, "lfoDelayTimeSeconds", "LFO Delay Time",             \
+    FloatParam(0.00f, 3.f, .01f, 0.3f))                                        \
+  X(kLfoAttack, "lfoAttack", "LFO Attack",                                     \
+    FloatParam(0.001f, 1.0f, .001f, 0.01f))                                    \
+  X(kLfoWaveType, "lfoWaveType", "LFO Wave Type",                              \
+    ChoiceParam(0, {"sine", "sawFall", "triangle", "square", "random"}))       \
+  /* VCO Mod */                                                                \
+  X(kVcoModLfoFreq, "vcoModLfoFreq", "LFO Freq Mod",                           \
+    FloatParam(-.1f, .1f, .001f, 0.f))                                         \
+  X(kVcoModEnv1Freq, "vcoModEnv1Freq", "Env 1 Freq Mod",                       \
+    FloatParam(-1.f, 1.f, .01f, 0.f))                                          \
+  X(kVcoModOsc1, "vcoModOsc1", "Freq Mod Osc 1", BoolParam(true))              \
+  X(kVcoModOsc2, "vcoModOsc2", "Freq Mod Osc 2", BoolParam(true))              \
+  X(kPulseWidth, "pulseWidth", "Pulse Width",                                  \
+    FloatParam(0.f, 1.f, .01f, 0.5f))                                          \
+  X(kPulseWidthSource, "pulseWidthSource", "Pulse Width Source",               \
+    ChoiceParam(5, {"E2-", "E2+", "E1-", "E1+", "LFO", "MAN"}))                \
+  /* VCO 1 */                                                                  \
+  X(kWaveType, "waveType", "Wave Type",                                        \
+    ChoiceParam(1, {"SIN", "SAW", "TRI", "SQR", "RND"}))                       \
+  /* level should never exceed 1 as that will cause clipping when both */      \
+  /* voices are added together */                                              \
+  X(kVco1Level, "vco1Level", "VCO 1 Level", FloatParam(0.f, .5f, 0.01f, 0.5f)) \
+  /* VCO 2 */                                                                  \
+  X(kWave2Type, "wave2Type", "Wave 2 Type",                                    \
+    ChoiceParam(1, {"sine", "sawFall", "triangle", "square", "random"}))       \
+  X(kVco2Level, "vco2Level", "VCO 2 Level", FloatParam(0.f, .5f, 0.01f, 0.5f)) \
+  X(kFineTune, "fineTune", "Fine Tune", FloatParam(-1.f, 1.f, 0.01f, 0.f))     \
+  X(kVco2Sync, "vco2Sync", "Sync (VCO1->VCO2)", BoolParam(false))              \
+  X(kCrossMod, "crossMod", "Cross Mod", FloatParam(0.f, 8.f, 0.1f, 0.f))       \
+  /* ENV 1 */                                                                  \
+  X(kAdsrAttack, "adsrAttack", "ADSR Attack (s)",                              \
+    FloatParam(0.001f, 5.0f, 0.001f, 0.01f, 0.3f))                             \
+  X(kAdsrDecay, "adsrDecay", "ADSR Decay (s)",                                 \
+    FloatParam(0.001f, 5.0f, 0.001f, 0.2f, 0.3f))                              \
+  X(kAdsrSustain, "adsrSustain", "ADSR Sustain",                               \
+    FloatParam(0.0f, 1.0f, 0.001f, 0.7f))                                      \
+  X(kAdsrRelease, "adsrRelease", "ADSR Release (s)",                           \
+    FloatParam(0.001f, 5.0f, 0.001f, 0.3f, 0.3f))                              \
+  /* ENV 2 */                                                                  \
+  X(kEnv2Attack, "env2Attack", "ENV2 Attack (s)",                              \
+    FloatParam(0.001f, 5.0f, 0.001f, 0.01f, 0.3f))                             \
+  X(kEnv2Decay, "env2Decay", "ENV2 Decay (s)",                                 \
+    FloatParam(0.001f, 5.0f, 0.001f, 0.2f, 0.3f))                              \
+  X(kEnv2Sustain, "env2Sustain", "ENV2 Sustain",                               \
+    FloatParam(0.0f, 1.0f, 0.001f, 0.7f))                                      \
+  X(kEnv2Release, "env2Release", "ENV2 Release (s)",                           \
+    FloatParam(0.001f, 5.0f, 0.001f, 0.3f, 0.3f))                              \
+  /* VCF */                                                                    \
+  X(kHpfFreq, "hpfFreq", "HPF Frequency",                                      \
+    FloatParam(20.f, 2000.f, 1.f, 20.f, 0.3f))                                 \
+  /* todo what would actually be the best range, considering we do */          \
+  /* oversampling? */                                                          \
+  X(kFilterCutoffFreq, "filterCutoffFreq", "Filter Cutoff Frequency",          \
+    FloatParam(kMinCutoff, kMaxCutoff, 1.f, 23000.f))                          \
+  X(kFilterResonance, "filterResonance", "Filter Resonance",                   \
+    FloatParam(0.f, 4.f, 0.01f, 0.f))                                          \
+  X(kFilterDrive, "filterDrive", "Filter Drive",                               \
+    FloatParam(kMinDrive, 10.f, 0.0001f, kMinDrive, .4f))                      \
+  X(kFilterSlope, "filterSlope", "Filter Slope",                               \
+    ChoiceParam(0, {"-24 dB", "-18 dB", "-12 dB"}))                            \
+  X(kFilterEnvMod, "filterEnvMod", "Filter Env Mod",                           \
+    FloatParam(-1.f, 1.f, 0.01f, 0.f))                                         \
+  X(kFilterLfoMod, "filterLfoMod", "Filter LFO Mod",                           \
+    FloatParam(-1.f, 1.f, 0.01f, 0.f))                                         \
+  X(kFilterEnvSource, "filterEnvSource", "Filter Env Source",                  \
+    ChoiceParam(0, {"Env 1", "Env 2"}))                                        \
+  /* drive scaling, input / state interleaved per stage */                     \
+  X(kFilterInputDriveScale1, "filterInputDriveScale1",                         \
+    "Filter Stage 1 Input Drive Scale",                                        \
+    FloatParam(0.0001f, 10.f, 0.0001f, 1.0f, 0.4f))                            \
+  X(kFilterStateDriveScale1, "filterStateDriveScale1",                         \
+    "Filter Stage 1 State Drive Scale",                                        \
+    FloatParam(0.0001f, 10.f, 0.0001f, 1.0f, 0.4f))                            \
+  X(kFilterInputDriveScale2, "filterInputDriveScale2",                         \
+    "Filter Stage 2 Input Drive Scale",                                        \
+    FloatParam(0.0001f, 10.f, 0.0001f, 1.0f, 0.4f))                            \
+  X(kFilterStateDriveScale2, "filterStateDriveScale2",                         \
+    "Filter Stage 2 State Drive Scale",                                        \
+    FloatParam(0.0001f, 10.f, 0.0001f, 1.0f, 0.4f))                            \
+  X(kFilterInputDriveScale3, "filterInputDriveScale3",                         \
+    "Filter Stage 3 Input Drive Scale",                                        \
+    FloatParam(0.0001f, 10.f, 0.0001f, 1.0f, 0.4f))                            \
+  X(kFilterStateDriveScale3, "filterStateDriveScale3",                         \
+    "Filter Stage 3 State Drive Scale",                                        \
+    FloatParam(0.0001f, 10.f, 0.0001f, 1.0f, 0.4f))                            \
+  X(kFilterInputDriveScale4, "filterInputDriveScale4",                         \
+    "Filter Stage 4 Input Drive Scale",                                        \
+    FloatParam(0.0001f, 10.f, 0.0001f, 1.0f, 0.4f))                            \
+  X(kFilterStateDriveScale4, "filterStateDriveScale4",                         \
+    "Filter Stage 4 State Drive Scale",                                        \
+    FloatParam(0.0001f, 10.f, 0.0001f, 1.0f, 0.4f))                            \
+  X(kVcfFilterType, "vcfFilterType", "VCF Filter Type",                        \
+    ChoiceParam(1, {"Delayed Feedback", "TPT Newton-Raphson", "Disabled"}))    \
+  /* VCA */                                                                    \
+  X(kVcaLevel, "vcaLevel", "VCA Level", FloatParam(0.f, 1.f, 0.01f, 0.8f))     \
+  X(kVcaLfoMod, "vcaLfoMod", "VCA LFO Mod", FloatParam(-1.f, 1.f, 0.01f, 0.f)) \
+  X(kVcaTone, "vcaTone", "VCA Tone", FloatParam(-1.f, 1.f, 0.01f, 0.f))        \
+  /* quality: the most oversampling (1 << choice) a voice may pick, for */     \
+  /* live playing and for offline (non realtime) renders, which can */         \
+  /* afford more */                                                            \
+  X(kOversampling, "oversampling", "Oversampling",                             \
+    ChoiceParam(1, {"1x", "2x", "4x", "8x"}))                                  \
+  X(kOfflineOversampling, "offlineOversampling", "Offline Oversampling",       \
+    ChoiceParam(1, {"1x", "2x", "4x", "8x"}))                                  \
+  /* accuracy of the filters' tanh / tan approximations (MathQuality, by */    \
+  /* index) */                                                                 \
+  X(kMathQuality, "mathQuality", "Math Quality",                               \
+    ChoiceParam(1, {"Fast", "High", "Exact"}))
+
+/**
+ * Every plugin parameter, in layout order. DSP code reads parameters by this
+ * index via ParameterTable rather than by string ID.
+ */
+enum class ParamId : std::size_t {
+#define BBSYNTH_PARAM_ID(param_id, id, name, spec) param_id,
+  BBSYNTH_PARAMETERS(BBSYNTH_PARAM_ID)
+#undef BBSYNTH_PARAM_ID
+  kNumParams
+};
+
+constexpr auto kNumParams = std::to_underlying(ParamId::kNumParams);
+// number of filter stages that have their own drive scaling params
+constexpr auto kNumDriveScaleStages = 4;
+
+/**
+ * String IDs (as used by the apvts and saved in plugin state), indexed by
+ * ParamId.
+ */
+constexpr std::array<const char*, kNumParams> kParamIds{
+#define BBSYNTH_PARAM_STRING_ID(param_id, id, name, spec) id,
+    BBSYNTH_PARAMETERS(BBSYNTH_PARAM_STRING_ID)
+#undef BBSYNTH_PARAM_STRING_ID
+};
+
+/**
+ * Every parameter's ParamSpec, indexed by ParamId.
+ */
+constexpr std::array<ParamSpec, kNumParams> kParamSpecs{
+#define BBSYNTH_PARAM_SPEC(param_id, id, name, spec) Named(spec, id, name),
+    BBSYNTH_PARAMETERS(BBSYNTH_PARAM_SPEC)
+#undef BBSYNTH_PARAM_SPEC
+};
+
+constexpr bool ParamIdsAreUnique() {
+  for (std::size_t i = 0; i < kNumParams; ++i) {
+    for (auto j = i + 1; j < kNumParams; ++j) {
+      if (std::string_view{kParamIds[i]} == std::string_view{kParamIds[j]}) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+static_assert(ParamIdsAreUnique(), "duplicate parameter ID");
+
+constexpr const char* ToString(const ParamId id) {
+  return kParamIds[std::to_underlying(id)];
+}
+
+/**
+ * @param stage 0-based filter stage
+ */
+constexpr ParamId FilterInputDriveScaleId(const int stage) {
+  return static_cast<ParamId>(
+      std::to_underlying(ParamId::kFilterInputDriveScale1) +
+      static_cast<std::size_t>(2 * stage));
+}
+
+/**
+ * @param stage 0-based filter stage
+ */
+constexpr ParamId FilterStateDriveScaleId(const int stage) {
+  return static_cast<ParamId>(
+      std::to_underlying(ParamId::kFilterStateDriveScale1) +
+      static_cast<std::size_t>(2 * stage));
+}
+static_assert(FilterStateDriveScaleId(kNumDriveScaleStages - 1) ==
+              ParamId::kFilterStateDriveScale4);
+
+/**
+ * Set of parameters, indexed by ParamId (e.g. the ones that changed since the
+ * last block).
+ */
+using ParameterChanges = std::bitset<kNumParams>;
+
+inline bool AnyChanged(const ParameterChanges& changes,
+                       const std::initializer_list<ParamId> ids) {
+  return std::ranges::any_of(ids, [&changes](const ParamId id) {
+    return changes.test(std::to_underlying(id));
+  });
+}
+
+/**
+ * Lock-free record of which parameters changed since the audio thread last
+ * looked. Listeners on any thread Push(), the audio thread PopAll()s at the
+ * start of each block.
+ * Only the fact that a parameter changed is recorded - the value is read
+ * from the ParameterTable when the change is applied, so any number of
+ * changes to one parameter between blocks collapse into a single change.
+ */
+class ParameterChangeQueue {
+public:
+  void Push(ParamId id);
+  /**
+   * @return every parameter pushed since the last call, clearing them
+   */
+  ParameterChanges PopAll();
+
+private:
+  static constexpr std::size_t kBitsPerWord = 64;
+  std::array<std::atomic<std::uint64_t>,
+             (kNumParams + kBitsPerWord - 1) / kBitsPerWord>
+      pending_{};
+};
+
+/**
+ * Pushes one parameter's changes to a ParameterChangeQueue, for as long as
+ * it lives. Each parameter gets its own listener so the ParamId is known
+ * up front, rather than looked up by string ID on every change.
+ */
+class ParameterChangeListener
+    : public juce::AudioProcessorValueTreeState::Listener {
+public:
+  ParameterChangeListener(juce::AudioProcessorValueTreeState& apvts,
+                          ParamId id, ParameterChangeQueue& queue);
+  ~ParameterChangeListener() override;
+
+  ParameterChangeListener(const ParameterChangeListener&) = delete;
+  ParameterChangeListener& operator=(const ParameterChangeListener&) = delete;
+
+  void parameterChanged(const juce::String& parameterID,
+                        float newValue) override;
+
+private:
+  juce::AudioProcessorValueTreeState& apvts_;
+  ParamId id_;
+  ParameterChangeQueue& queue_;
+};
+
+/**
+ * The apvts' raw parameter values, resolved by string ID once on
+ * construction so reading a parameter is just an atomic load.
+ */
+class ParameterTable {
+public:
+  explicit ParameterTable(const juce::AudioProcessorValueTreeState& apvts);
+
+  float Get(const ParamId id) const {
+    return values_[std::to_underlying(id)]->load(std::memory_order_relaxed);
+  }
+
+  int GetInt(const ParamId id) const { return static_cast<int>(Get(id)); }
+
+  bool GetBool(const ParamId id) const { return Get(id) > 0.5f; }
+
+private:
+  std::array<std::atomic<float>*, kNumParams> values_;
+};
+}  // namespace audio_plugin
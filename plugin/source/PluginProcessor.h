@@ -2,12 +2,18 @@
 import JuceImports;
 import std;
 
+#include "Constants.h"
+#include "Parameters.h"
+#include "dsp/AudioTap.h"
+#include "dsp/VoiceBus.h"
+#include "filter/OTAFilterBank.h"
 #include "filter/ToneFilter.h"
+#include "oscillator/Oscillator.h"
 #include "oscillator/WaveGenerator.h"
 
 namespace audio_plugin {
 
-class AudioPluginAudioProcessor : public juce::AudioProcessor, public juce::AudioProcessorValueTreeState::Listener {
+class AudioPluginAudioProcessor : public juce::AudioProcessor {
 public:
   AudioPluginAudioProcessor();
   ~AudioPluginAudioProcessor() override;
@@ -41,16 +47,53 @@ public:
   void setStateInformation(const void* data, int sizeInBytes) override;
 
   juce::AudioProcessorValueTreeState apvts_;
+  ParameterTable parameters_;
+  // filled by parameter_listeners_, drained at the start of each block
+  ParameterChangeQueue parameter_changes_;
+  // MIDI from the on-screen keyboard is merged into the incoming MIDI
+  juce::MidiKeyboardState keyboard_state_;
+  // output (left channel, post limiter) for the editor's visualizers
+  AudioTap output_tap_;
 
 private:
   static juce::AudioProcessorValueTreeState::ParameterLayout CreateParameterLayout();
-  void ConfigureLFO();
-
-  void parameterChanged(const juce::String& name, float newValue) override;
-
+  /**
+   * Apply changed parameters to the voices, LFO and global effects.
+   * Audio thread only.
+   */
+  void ApplyParameterChanges(const ParameterChanges& changes);
+  void ConfigureLFO(const ParameterChanges& changes);
+  /**
+   * Cap the voices at the oversampling factor selected for the current
+   * (realtime or offline) mode, if it isn't already.
+   */
+  void UpdateOversampleFactor();
+  /**
+   * Restart the LFO from the beginning of its wave, ramping up from silence.
+   * The next RenderLFO starts where it started.
+   */
+  void StartLFO();
+  /**
+   * Write the LFO into lfo_buffer_, interpolating between its control rate
+   * samples (see kLfoControlInterval) and applying the start ramp.
+   */
+  void RenderLFO(int start_sample, int num_samples);
+
+  // one per parameter, indexed by ParamId
+  std::vector<std::unique_ptr<ParameterChangeListener>> parameter_listeners_;
   // todo: passing this around is a stupid way to do it. Let's find a better way...
   juce::AudioBuffer<float> lfo_buffer_;
-  juce::Synthesiser synth;
+  // oversampled mono mix of all voices, one bus per factor. Voices add into
+  // them, then each is downsampled once into the output buffer.
+  VoiceBus voice_bus_;
+  // the most the voices run at
+  int max_oversample_factor_ = kDefaultOversample;
+  // the voices' TPT filters, run together
+  OTAFilterBank filter_bank_;
+  // 1 / sqrt(voices playing), ramped, so a chord of uncorrelated voices
+  // comes out about as loud as one note instead of summing to clipping
+  juce::SmoothedValue<float> voice_gain_;
+  OscillatorSynthesiser synth;
   WaveGenerator<true> lfo_generator_;
   juce::dsp::IIR::Filter<float> hpf_;
   ToneFilter tone_filter_;
@@ -66,6 +109,13 @@ private:
   float lfo_delay_time_s_;
   // configured rate
   float lfo_rate_;
+  // the LFO at control rate
+  juce::AudioBuffer<float> lfo_control_buffer_;
+  // the control samples the LFO is between, and how many samples past the
+  // first one it is
+  float lfo_control_last_ = 0;
+  float lfo_control_next_ = 0;
+  int lfo_control_position_ = 0;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioPluginAudioProcessor)
 };
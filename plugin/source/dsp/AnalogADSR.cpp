@@ -4,6 +4,12 @@ import std;
 #include "AnalogADSR.h"
 
 namespace audio_plugin {
+namespace {
+// curve of each stage, see level_
+constexpr float kAttackCurve = -0.4f;
+constexpr float kDecayCurve = 0.4f;
+constexpr float kReleaseCurve = 0.4f;
+}  // namespace
 
 void AnalogADSR::Prepare(const double sample_rate) {
   sample_rate_ = static_cast<float>(sample_rate);
@@ -16,6 +22,8 @@ void AnalogADSR::Configure(const float attack_seconds,
   decay_samples_ = static_cast<int>(decay_seconds * sample_rate_);
   sustain_level_ = sustain_level;
   release_samples_ = static_cast<int>(release_seconds * sample_rate_);
+  // pick up the new length / levels from where the current stage is
+  StartStage();
 }
 
 void AnalogADSR::Reset() {
@@ -29,6 +37,7 @@ void AnalogADSR::NoteOn() {
   // todo: probably not thread safe
   state_ = State::attack;
   stage_samples_ = 0;
+  StartStage();
 }
 
 void AnalogADSR::NoteOff() {
@@ -41,11 +50,15 @@ void AnalogADSR::AdvanceStateFromAttack() {
   if (decay_samples_ > 0) {
     state_ = State::decay;
     stage_samples_ = 0;
+    StartStage();
   } else {
     AdvanceStateFromDecay();
   }
 }
 void AnalogADSR::AdvanceStateFromDecay() {
+  // the decay has arrived at the sustain level (the last sample written is
+  // one short of it), which is what a release straight from here starts at
+  last_level_ = sustain_level_;
   if (sustain_level_ > 0.0f) {
     state_ = State::sustain;
     stage_samples_ = 0;
@@ -58,6 +71,7 @@ void AnalogADSR::AdvanceStateFromSustain() {
     state_ = State::release;
     stage_samples_ = 0;
     released_level_ = last_level_;
+    StartStage();
   } else {
     AdvanceStateFromRelease();
   }
@@ -66,88 +80,125 @@ void AnalogADSR::AdvanceStateFromRelease() {
   Reset();
 }
 
-// TODO: probably all the below code can use compile-time logic more to reduce runtime computation...
+void AnalogADSR::AdvanceState() {
+  switch (state_) {
+    case State::attack:
+      AdvanceStateFromAttack();
+      break;
+    case State::decay:
+      AdvanceStateFromDecay();
+      break;
+    case State::sustain:
+      AdvanceStateFromSustain();
+      break;
+    case State::release:
+      AdvanceStateFromRelease();
+      break;
+    case State::idle:
+      break;
+  }
+}
 
-template<auto NextStateFunc,auto Curve,auto ConfiguredStageSamples,auto StartVal,auto TargetVal>
-void AnalogADSR::WriteStage(juce::AudioBuffer<float>& buffer,
-                                       const int start_sample,
-                                       const int num_samples) {
-  // todo: the taper(...) template function might be a better option here
-  // todo: smarter / more efficient corve function.
-  // todo: a lot of this is really inefficient
-  const auto remaining_stage_samples = (this->*ConfiguredStageSamples) - stage_samples_;
-  if (remaining_stage_samples <= 0.0) {
-    // we started this buffer immediately transitioning to the next state,
-    // so do the transition and continue writing using the new state
-    (this->*NextStateFunc)();
-    WriteEnvelopeToBuffer(buffer, start_sample, num_samples);
-  } else {
-    // todo: do a lot more of this calculation up front, not for every sample
-    const auto excess_samples = num_samples - remaining_stage_samples;
-    const auto samples_to_write =
-        excess_samples >= 0 ? remaining_stage_samples : num_samples;
-    // todo: could be constexpr if we find a library with a constexpr pow function
-    const auto denom = std::pow(2, Curve) - 1;
-    for (int i = 0; i < samples_to_write; ++i) {
-      // scale time to 0,1 interval
-      const float progress = (static_cast<float>(stage_samples_++) /
-          static_cast<float>((this->*ConfiguredStageSamples)));
-      const auto num = (std::pow(2, Curve * progress) - 1);
-      const auto unscaled = num / denom;
-      // now scale to target -> release (either of which may be a pointer to member or a constant)
-      const float start_actual = [](const auto* self) {
-        if constexpr (std::is_member_object_pointer_v<decltype(StartVal)>) {
-          return (self->*StartVal);
-        } else {
-          return StartVal;
-        }
-      }(this);
-      const float target_actual = [](const auto* self) {
-        if constexpr (std::is_member_object_pointer_v<decltype(TargetVal)>) {
-          return (self->*TargetVal);
-        } else {
-          return TargetVal;
-        }
-      }(this);
-      // now scale the 0 - 1 interval to start - end
-      const auto scaled = start_actual + (target_actual - start_actual) * static_cast<float>(unscaled);
-      buffer.setSample(0, start_sample + i, scaled);
-    }
-    if (excess_samples > 0) {
-      // we didn't fill the buffer up - transition to the next state and
-      // continue rendering
-      (this->*NextStateFunc)();
-      WriteEnvelopeToBuffer(buffer, start_sample + samples_to_write, num_samples - samples_to_write);
-    }
+int AnalogADSR::StageLength() const {
+  switch (state_) {
+    case State::attack:
+      return attack_samples_;
+    case State::decay:
+      return decay_samples_;
+    case State::release:
+      return release_samples_;
+    case State::idle:
+    case State::sustain:
+      break;
   }
-  last_level_ = buffer.getSample(0, start_sample + num_samples - 1);
+  return 0;
+}
+
+void AnalogADSR::StartStage() {
+  switch (state_) {
+    case State::attack:
+      StartCurve(kAttackCurve, attack_samples_, 0.f, 1.f);
+      break;
+    case State::decay:
+      StartCurve(kDecayCurve, decay_samples_, 1.f, sustain_level_);
+      break;
+    case State::release:
+      StartCurve(kReleaseCurve, release_samples_, released_level_, 0.f);
+      break;
+    case State::idle:
+    case State::sustain:
+      break;
+  }
+}
+
+void AnalogADSR::StartCurve(const float curve, const int stage_length,
+                            const float start, const float target) {
+  // an empty stage is skipped without writing anything
+  if (stage_length <= 0) return;
+  // with progress = n / stage_length, 2^(curve * progress) grows by
+  // 2^(curve / stage_length) each sample, so the level does too, once the
+  // constant part of it is taken out
+  const auto length = static_cast<double>(stage_length);
+  const auto c = static_cast<double>(curve);
+  const auto scale = static_cast<double>(target - start) / (std::exp2(c) - 1);
+  multiplier_ = std::exp2(c / length);
+  offset_ = (1 - multiplier_) * (static_cast<double>(start) - scale);
+  level_ = static_cast<double>(start) +
+           scale * (std::exp2(c * static_cast<double>(stage_samples_) / length) - 1);
 }
 
 void AnalogADSR::WriteEnvelopeToBuffer(juce::AudioBuffer<float>& buffer,
                                        const int start_sample,
-                                       const int num_samples) {
-  if (state_ == State::idle) {
-    buffer.clear(0, start_sample, num_samples);
-    return;
-  }
-  if (state_ == State::attack) {
-    WriteStage<&AnalogADSR::AdvanceStateFromAttack,-0.4f, &AnalogADSR::attack_samples_, 0.f, 1.f>
-      (buffer, start_sample, num_samples);
-  } else if (state_ == State::decay) {
-    WriteStage<&AnalogADSR::AdvanceStateFromDecay,0.4f, &AnalogADSR::decay_samples_, 1.f, &AnalogADSR::sustain_level_>
-      (buffer, start_sample, num_samples);
-  } else if (state_ == State::sustain) {
-    // sustain lasts until note off, so just write constant value
-    const auto buffer_ptr = buffer.getWritePointer(0);
-    for (int i = 0; i < num_samples; ++i) {
-      buffer_ptr[i] = sustain_level_;
+                                       int num_samples) {
+  auto* out = buffer.getWritePointer(0, start_sample);
+  while (num_samples > 0) {
+    if (state_ == State::idle) {
+      std::fill_n(out, num_samples, 0.f);
+      return;
+    }
+    if (state_ == State::sustain) {
+      // sustain lasts until note off, so just write constant value
+      std::fill_n(out, num_samples, sustain_level_);
+      last_level_ = sustain_level_;
+      return;
+    }
+    const auto remaining_stage_samples = StageLength() - stage_samples_;
+    if (remaining_stage_samples <= 0) {
+      // the stage is over, continue writing using the next state
+      AdvanceState();
+      continue;
+    }
+    const auto samples_to_write = std::min(remaining_stage_samples, num_samples);
+    auto level = level_;
+    for (int i = 0; i < samples_to_write; ++i) {
+      out[i] = static_cast<float>(level);
+      level = level * multiplier_ + offset_;
     }
-  } else if (state_ == State::release) {
-    WriteStage<&AnalogADSR::AdvanceStateFromRelease,0.4f, &AnalogADSR::release_samples_, &AnalogADSR::released_level_, 0.f>(buffer, start_sample, num_samples);
+    level_ = level;
+    stage_samples_ += samples_to_write;
+    last_level_ = out[samples_to_write - 1];
+    out += samples_to_write;
+    num_samples -= samples_to_write;
   }
 }
+
 bool AnalogADSR::IsActive() const {
   return state_ != State::idle;
 }
 
+bool AnalogADSR::IsBelow(const float level) const {
+  switch (state_) {
+    case State::idle:
+      return true;
+    case State::sustain:
+    case State::release:
+      // the release only ever falls
+      return last_level_ < level;
+    case State::attack:
+    case State::decay:
+      break;
+  }
+  return false;
+}
+
 }  // namespace audio_plugin
\ No newline at end of file
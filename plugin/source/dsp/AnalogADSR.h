@@ -19,8 +19,12 @@ class AnalogADSR {
   // this does NOT APPLY the envelope to the buffer - it writes the raw envelope
   // values to the buffer so the envelope can be used by other parts of the plugin
   // This only affects the first channel of the buffer.
+  // Curved stages cost one multiply and add per sample.
   void WriteEnvelopeToBuffer(juce::AudioBuffer<float>& buffer, int start_sample, int num_samples);
   bool IsActive() const;
+  // whether the envelope is below level and will stay there until the next
+  // NoteOn (idle, or sustaining / releasing below it)
+  bool IsBelow(float level) const;
 
  private:
   void AdvanceStateFromAttack();
@@ -28,9 +32,14 @@ class AnalogADSR {
   void AdvanceStateFromSustain();
   void AdvanceStateFromRelease();
 
-  template<auto NextStateFunc,auto Curve,auto ConfiguredStageSamples,auto StartVal, auto TargetVal>
-  void WriteStage(juce::AudioBuffer<float>& buffer, int start_sample,
-                  int num_samples);
+  // AdvanceStateFrom... for the current state
+  void AdvanceState();
+  // configured length of the current stage in samples (0 for idle / sustain)
+  int StageLength() const;
+  // set the curve coefficients for the current stage, starting from where
+  // stage_samples_ is in it
+  void StartStage();
+  void StartCurve(float curve, int stage_length, float start, float target);
 
   enum class State { idle, attack, decay, sustain, release };
   State state_{State::idle};
@@ -48,5 +57,13 @@ class AnalogADSR {
   float released_level_{0.f};
   // most recent output level, used for setting released level
   float last_level_{0.f};
+
+  // the curved stages (attack, decay, release) follow
+  // start + (target - start) * (2^(curve * progress) - 1) / (2^curve - 1),
+  // which is computed one sample to the next as
+  // level = level * multiplier + offset
+  double level_{0};
+  double multiplier_{1};
+  double offset_{0};
 };
 }  // namespace audio_plugin
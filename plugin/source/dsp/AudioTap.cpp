@@ -0,0 +1,44 @@
+import JuceImports;
+import std;
+
+#include "AudioTap.h"
+
+namespace audio_plugin {
+
+AudioTap::AudioTap(const int capacity)
+    : fifo_{capacity}, data_(static_cast<std::size_t>(capacity)) {}
+
+void AudioTap::Push(const float* data, const int num_samples) {
+  if (!attached_.load(std::memory_order_relaxed)) return;
+
+  const auto scope = fifo_.write(num_samples);
+  if (scope.blockSize1 > 0) {
+    std::copy_n(data, scope.blockSize1, data_.data() + scope.startIndex1);
+  }
+  if (scope.blockSize2 > 0) {
+    std::copy_n(data + scope.blockSize1, scope.blockSize2,
+                data_.data() + scope.startIndex2);
+  }
+}
+
+int AudioTap::Pull(float* dest, const int max_samples) {
+  const auto scope = fifo_.read(max_samples);
+  if (scope.blockSize1 > 0) {
+    std::copy_n(data_.data() + scope.startIndex1, scope.blockSize1, dest);
+  }
+  if (scope.blockSize2 > 0) {
+    std::copy_n(data_.data() + scope.startIndex2, scope.blockSize2,
+                dest + scope.blockSize1);
+  }
+  return scope.blockSize1 + scope.blockSize2;
+}
+
+void AudioTap::Attach() {
+  // the reader owns the read position, so it can skip stale samples itself
+  // without racing the writer
+  fifo_.read(fifo_.getNumReady());
+  attached_.store(true, std::memory_order_relaxed);
+}
+
+void AudioTap::Detach() { attached_.store(false, std::memory_order_relaxed); }
+}  // namespace audio_plugin
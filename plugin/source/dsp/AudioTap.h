@@ -0,0 +1,42 @@
+#pragma once
+import JuceImports;
+import std;
+
+namespace audio_plugin {
+/**
+ * Lock-free single-producer / single-consumer tap for getting audio from the
+ * audio thread to a visualizer.
+ * The audio thread Push()es blocks, the reader (e.g. a component's timer)
+ * Pull()s them. While no reader is attached Push() returns right away, so
+ * the audio path costs the same with or without an editor.
+ * If the reader falls behind, samples that don't fit are dropped.
+ */
+class AudioTap {
+public:
+  explicit AudioTap(int capacity = 1 << 14);
+
+  /**
+   * Audio thread only. Publishes num_samples samples if a reader is attached.
+   */
+  void Push(const float* data, int num_samples);
+
+  /**
+   * Reader thread only. Copies up to max_samples of the oldest published
+   * samples into dest.
+   * @return number of samples copied
+   */
+  int Pull(float* dest, int max_samples);
+
+  /**
+   * Reader thread only. Start / stop publishing. Samples left over from a
+   * previous attach are discarded on attach.
+   */
+  void Attach();
+  void Detach();
+
+private:
+  juce::AbstractFifo fifo_;
+  std::vector<float> data_;
+  std::atomic<bool> attached_{false};
+};
+}  // namespace audio_plugin
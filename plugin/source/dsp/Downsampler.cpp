@@ -9,6 +9,7 @@ void Downsampler::prepare(const int max_block_size,
                           const int oversamplingFactor) {
   oversamplingFactor_ = oversamplingFactor;
   stages_.clear();
+  tail_samples_ = 0;
 
   int numStages = 0;
   int tempFactor = oversamplingFactor;
@@ -43,6 +44,22 @@ void Downsampler::prepare(const int max_block_size,
     stages_[s].delay = 0.0f;
   }
 
+  // Each allpass rings as alpha^n at its stage's output rate, so it's below
+  // kTailLevel after log(kTailLevel) / log(alpha) samples. A cascade takes
+  // no longer than its sections one after another, plus the delay.
+  constexpr float kTailLevel = 1e-6f;
+  int stageTail = 1;
+  for (const auto alpha : alphas) {
+    if (std::abs(alpha) > 0.0f)
+      stageTail += static_cast<int>(
+          std::ceil(std::log(kTailLevel) / std::log(std::abs(alpha))));
+  }
+  // stage s runs at 2^(numStages - 1 - s) times the output rate
+  for (int s = 0; s < numStages; ++s) {
+    const int rate = 1 << (numStages - 1 - s);
+    tail_samples_ += (stageTail + rate - 1) / rate;
+  }
+
   if (numStages > 1) {
     // Internal buffer for intermediate stages
     // The largest intermediate buffer needed is for the first stage output
@@ -50,6 +67,13 @@ void Downsampler::prepare(const int max_block_size,
   }
 }
 
+void Downsampler::reset() {
+  for (auto& stage : stages_) {
+    std::fill(stage.v1.begin(), stage.v1.end(), 0.0f);
+    stage.delay = 0.0f;
+  }
+}
+
 void Downsampler::process(const juce::AudioBuffer<float>& input,
                           juce::AudioBuffer<float>& output,
                           const int sourceStartSample,
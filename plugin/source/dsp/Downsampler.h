@@ -12,10 +12,17 @@ class Downsampler {
 public:
   void prepare(int max_block_size, int oversamplingFactor);
 
+  // clear the filter state, e.g. before picking up after being unused
+  void reset();
+
   void process(const juce::AudioBuffer<float> &input,
                juce::AudioBuffer<float> &output, int sourceStartSample,
                int sourceNumSamples);
 
+  // output samples the filters take to ring out (to -120 dB) once the input
+  // goes silent
+  int tail_samples() const { return tail_samples_; }
+
 private:
   struct Stage {
     std::vector<float> alphas;
@@ -25,6 +32,7 @@ private:
 
   std::vector<Stage> stages_;
   int oversamplingFactor_ { 1 };
+  int tail_samples_ { 0 };
   juce::AudioBuffer<float> internalBuffer_;
 };
 }
\ No newline at end of file
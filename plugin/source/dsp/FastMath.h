@@ -0,0 +1,234 @@
+#pragma once
+import JuceImports;
+import std;
+
+namespace audio_plugin {
+
+/**
+ * Accuracy tiers for the approximations below, picked by the Math Quality
+ * parameter. Errors are against libm in double precision over the whole
+ * float range unless a function says otherwise, and are checked by
+ * FastMathTest.
+ */
+enum class MathQuality {
+  // 1e-4 or so (1.5e-3 for tanh). Fine for saturation curves, audible as a
+  // slight change in tone under heavy drive
+  kFast,
+  // within a few float roundings (~1e-6)
+  kHigh,
+  // libm
+  kExact
+};
+
+constexpr auto kNumMathQualities = 3;
+
+// The approximate tiers are inline, branch free (selects, min / max) and
+// call nothing, so loops over them vectorise - the array forms at the end
+// are just such loops.
+
+/**
+ * tanh(x).
+ * kFast: within 1.5e-3. kHigh: within 1e-5.
+ */
+template <MathQuality kQuality>
+inline float Tanh(const float x) {
+  if constexpr (kQuality == MathQuality::kExact) {
+    return std::tanh(x);
+  } else if constexpr (kQuality == MathQuality::kFast) {
+    // Lambert's continued fraction to 5 / 4 terms. It rises past 1 just
+    // above 3.6, so both ends are clamped.
+    const auto c = std::clamp(x, -5.f, 5.f);
+    const auto c2 = c * c;
+    return std::clamp(
+        c * (945.f + c2 * (105.f + c2)) / (945.f + c2 * (420.f + 15.f * c2)),
+        -1.f, 1.f);
+  } else {
+    // to 9 / 8 terms
+    const auto c = std::clamp(x, -9.f, 9.f);
+    const auto c2 = c * c;
+    return std::clamp(
+        c * (34459425.f + c2 * (4729725.f + c2 * (135135.f + c2 * (990.f + c2)))) /
+            (34459425.f +
+             c2 * (16216200.f + c2 * (945945.f + c2 * (13860.f + 45.f * c2)))),
+        -1.f, 1.f);
+  }
+}
+
+/**
+ * Below this magnitude x is as close to tanh(x) as Tanh<kQuality> is (tanh(x)
+ * = x - x^3 / 3 + ..., so x is within kTanhLinearLimit^3 / 3), so a tanh
+ * saturator can be treated as linear. For kExact, within half a float ulp.
+ */
+template <MathQuality kQuality>
+constexpr float kTanhLinearLimit = kQuality == MathQuality::kFast   ? .16f
+                                   : kQuality == MathQuality::kHigh ? .03f
+                                                                    : 4e-4f;
+
+/**
+ * tan(x) for |x| < PI / 2, e.g. the bilinear cutoff prewarp.
+ * Relative error - kFast: within 3e-4. kHigh: within 5e-7.
+ */
+template <MathQuality kQuality>
+inline float Tan(const float x) {
+  if constexpr (kQuality == MathQuality::kExact) {
+    return std::tan(x);
+  } else {
+    // above PI / 4, tan(x) = 1 / tan(PI / 2 - x). PI / 2 is split in two so
+    // the subtraction stays exact close to the pole.
+    constexpr auto kHalfPiHi = 1.57079637f;
+    constexpr auto kHalfPiLo = -4.37113883e-8f;
+    const auto ax = std::abs(x);
+    const auto upper = ax > kHalfPiHi / 2;
+    const auto r = upper ? (kHalfPiHi - ax) + kHalfPiLo : ax;
+    const auto r2 = r * r;
+    // Lambert's continued fraction again, which is close on [0, PI / 4]
+    float t;
+    if constexpr (kQuality == MathQuality::kFast) {
+      t = r * (15.f - r2) / (15.f - 6.f * r2);
+    } else {
+      t = r * (945.f + r2 * (-105.f + r2)) / (945.f + r2 * (-420.f + 15.f * r2));
+    }
+    return std::copysign(upper ? 1.f / t : t, x);
+  }
+}
+
+/**
+ * 2^x. Saturates to 2^-126 / 2^127 outside that range rather than going
+ * denormal / infinite.
+ * Relative error - kFast: within 1.5e-4. kHigh: within 5e-7.
+ */
+template <MathQuality kQuality>
+inline float Exp2(const float x) {
+  if constexpr (kQuality == MathQuality::kExact) {
+    return std::exp2(x);
+  } else {
+    const auto c = std::clamp(x, -126.f, 127.f);
+    // floor without a libm call
+    auto whole = static_cast<int32_t>(c);
+    whole -= static_cast<float>(whole) > c ? 1 : 0;
+    const auto f = c - static_cast<float>(whole);
+    // 2^f on [0, 1) as 1 + f + f (f - 1) q(f), so it's exact at both ends
+    // and continuous from one octave to the next. q fitted by least squares.
+    float q;
+    if constexpr (kQuality == MathQuality::kFast) {
+      q = .304605591f + f * .0781638481f;
+    } else {
+      q = .30684827f +
+          f * (.0666885786f + f * (.0108718577f + f * .00187794125f));
+    }
+    const auto fraction = 1.f + f + f * (f - 1.f) * q;
+    return fraction * std::bit_cast<float>((whole + 127) << 23);
+  }
+}
+
+/**
+ * log(cosh(x)), the antiderivative of tanh (see TanhADAA).
+ * Relative above 1 - kFast: within 1e-4. kHigh: within 1e-6.
+ */
+template <MathQuality kQuality>
+inline float LogCosh(const float x) {
+  const auto ax = std::abs(x);
+  if constexpr (kQuality == MathQuality::kExact) {
+    // cosh overflows past ~89, where this is exact in float anyway
+    if (ax > 20.0f) {
+      return ax - std::log(2.0f);
+    }
+    return std::log(std::cosh(ax));
+  } else {
+    // log(cosh(x)) = |x| - log(2) + log(1 + e^-2|x|), which never overflows.
+    // The log1p argument is in (0, 1], where a polynomial u q(u) does.
+    constexpr auto kMinusTwoLog2e = -2.88539008f;
+    constexpr auto kLog2 = .693147181f;
+    const auto u = Exp2<kQuality>(kMinusTwoLog2e * ax);
+    float q;
+    if constexpr (kQuality == MathQuality::kFast) {
+      q = .999434984f +
+          u * (-.491347927f +
+               u * (.287826289f + u * (-.134135433f + u * .0313775894f)));
+    } else {
+      q = .999978516f +
+          u * (-.499423297f +
+               u * (.327937181f +
+                    u * (-.225006931f +
+                         u * (.133351158f +
+                              u * (-.0541751417f + u * .0104858724f)))));
+    }
+    return ax - kLog2 + u * q;
+  }
+}
+
+/**
+ * sin(x) for |x| <= 4096 (the range reduction loses precision above that).
+ * kFast: within 1.5e-4. kHigh: within 5e-7.
+ */
+template <MathQuality kQuality>
+inline float Sin(const float x) {
+  if constexpr (kQuality == MathQuality::kExact) {
+    return std::sin(x);
+  } else {
+    constexpr auto kInvTwoPi = .159154943f;
+    // 2 PI split in three. The first part has few enough bits that
+    // turns * kTwoPiHi is exact, so r keeps its precision as x grows.
+    constexpr auto kTwoPiHi = 6.28125f;
+    constexpr auto kTwoPiMid = 1.93530717e-3f;
+    constexpr auto kTwoPiLo = 1.02533763e-11f;
+    constexpr auto kPi = 3.14159274f;
+    constexpr auto kHalfPi = 1.57079637f;
+    // rounds to the nearest integer (adding 1.5 * 2^23 drops the fraction)
+    constexpr auto kRound = 12582912.f;
+    const auto turns = (x * kInvTwoPi + kRound) - kRound;
+    auto r = ((x - turns * kTwoPiHi) - turns * kTwoPiMid) - turns * kTwoPiLo;
+    // sin is symmetric about +-PI / 2, so fold r into [-PI / 2, PI / 2]
+    r = r > kHalfPi ? kPi - r : r;
+    r = r < -kHalfPi ? -kPi - r : r;
+    const auto r2 = r * r;
+    // r + r^3 q(r^2), q fitted by least squares
+    float q;
+    if constexpr (kQuality == MathQuality::kFast) {
+      q = -.166078512f + r2 * .00763375367f;
+    } else {
+      q = -.166666573f +
+          r2 * (.00833302188f + r2 * (-.000198069022f + r2 * 2.60061484e-6f));
+    }
+    return r + r * r2 * q;
+  }
+}
+
+namespace fast_math_detail {
+template <float (*kFunction)(float)>
+void Apply(const float* in, float* out, const int n) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = kFunction(in[i]);
+  }
+}
+}  // namespace fast_math_detail
+
+// Array forms, for when there are many independent values at once (e.g. one
+// per voice). in and out may be the same array.
+
+template <MathQuality kQuality>
+void Tanh(const float* in, float* out, const int n) {
+  fast_math_detail::Apply<&Tanh<kQuality>>(in, out, n);
+}
+
+template <MathQuality kQuality>
+void Tan(const float* in, float* out, const int n) {
+  fast_math_detail::Apply<&Tan<kQuality>>(in, out, n);
+}
+
+template <MathQuality kQuality>
+void Exp2(const float* in, float* out, const int n) {
+  fast_math_detail::Apply<&Exp2<kQuality>>(in, out, n);
+}
+
+template <MathQuality kQuality>
+void LogCosh(const float* in, float* out, const int n) {
+  fast_math_detail::Apply<&LogCosh<kQuality>>(in, out, n);
+}
+
+template <MathQuality kQuality>
+void Sin(const float* in, float* out, const int n) {
+  fast_math_detail::Apply<&Sin<kQuality>>(in, out, n);
+}
+
+}  // namespace audio_plugin
@@ -0,0 +1,42 @@
+import JuceImports;
+import std;
+
+#include "ModulationBus.h"
+
+#include "../Constants.h"
+
+namespace audio_plugin {
+ModulationBus::ModulationBus() : control_scratch_{1, 0} {
+  // readable (if empty) before Prepare
+  for (auto& source : sources_) {
+    source.setSize(1, 0);
+  }
+}
+
+void ModulationBus::Prepare(const int max_block_size) {
+  for (auto& source : sources_) {
+    source.setSize(1, max_block_size * kMaxOversample, false, true);
+    source.clear();
+  }
+  control_scratch_.setSize(1, max_block_size, false, true);
+  control_scratch_.clear();
+}
+
+template <int kFactor>
+void ModulationBus::Upsample(const Source source, const float* control_data,
+                             const int start_sample, const int num_samples) {
+  auto* data = buffer(source).getWritePointer(0, start_sample * kFactor);
+  for (int i = 0; i < num_samples; ++i) {
+    const auto value = control_data[start_sample + i];
+    for (int j = 0; j < kFactor; ++j) {
+      *data++ = value;
+    }
+  }
+}
+
+static_assert(kMaxOversample == 8, "instantiate Upsample for every factor");
+template void ModulationBus::Upsample<1>(Source, const float*, int, int);
+template void ModulationBus::Upsample<2>(Source, const float*, int, int);
+template void ModulationBus::Upsample<4>(Source, const float*, int, int);
+template void ModulationBus::Upsample<8>(Source, const float*, int, int);
+}  // namespace audio_plugin
@@ -0,0 +1,73 @@
+#pragma once
+import JuceImports;
+import std;
+
+namespace audio_plugin {
+/**
+ * The modulation sources of one voice, each in its own contiguous array at
+ * the oversampled rate. Consumers running at the oversampled rate read
+ * sample i of a source at Read(source)[i], the same index they use for the
+ * audio, instead of each keeping references to the buffers and dividing
+ * the index down to the host rate.
+ *
+ * Control rate sources (rendered at the host rate) are written with
+ * Upsample once per block. Audio rate sources are rendered straight into
+ * buffer(source).
+ */
+class ModulationBus {
+ public:
+  enum Source {
+    // global LFO (control rate)
+    kLfo,
+    // the voice's envelopes (control rate)
+    kEnv1,
+    kEnv2,
+    // VCO 2, for cross mod (audio rate)
+    kModulator,
+    kNumSources
+  };
+
+  ModulationBus();
+
+  /**
+   * Sizes the sources for kMaxOversample.
+   * @param max_block_size most host rate samples in a block
+   */
+  void Prepare(int max_block_size);
+
+  /**
+   * Host rate scratch space for rendering a control rate source before
+   * passing it to Upsample.
+   */
+  juce::AudioBuffer<float>& control_scratch() { return control_scratch_; }
+
+  /**
+   * Write a control rate source into the bus, holding each sample for
+   * kFactor samples (the voice's oversampling factor).
+   * @param control_data host rate data, indexed the same as start_sample
+   * @param start_sample first host rate sample to write
+   * @param num_samples host rate samples to write
+   */
+  template <int kFactor>
+  void Upsample(Source source, const float* control_data, int start_sample,
+                int num_samples);
+
+  /**
+   * The buffer (one channel) an audio rate source is rendered into.
+   */
+  juce::AudioBuffer<float>& buffer(const Source source) {
+    return sources_[static_cast<std::size_t>(source)];
+  }
+
+  /**
+   * The source at the oversampled rate.
+   */
+  const float* Read(const Source source) const {
+    return sources_[static_cast<std::size_t>(source)].getReadPointer(0);
+  }
+
+ private:
+  std::array<juce::AudioBuffer<float>, kNumSources> sources_;
+  juce::AudioBuffer<float> control_scratch_;
+};
+}  // namespace audio_plugin
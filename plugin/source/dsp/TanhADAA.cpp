@@ -11,24 +11,13 @@ namespace audio_plugin {
 
 TanhADAA::TanhADAA() : x1_(0.0f) {}
 
-// To avoid overflow with log(cosh(x)) for large x, we use the identity:
-// log(cosh(x)) = |x| - log(2) + log(1 + exp(-2|x|))
-// For large |x|, this is approximately |x| - log(2).
-inline float LogCosh(const float x) {
-  const float ax = std::fabs(x);
-  if (ax > 20.0f) {
-    return ax - std::log(2.0f);
-  }
-  return std::log(std::cosh(ax));
-}
-
+template <MathQuality kQuality>
 float TanhADAA::process(const float x0) {
   float y;
 
-  const float tol = 1e-3f;
-  if (const auto dx = x0 - x1_; std::fabs(dx) < tol) {
+  if (const auto dx = x0 - x1_; std::fabs(dx) < kTaylorTolerance) {
     const auto xbar = 0.5f * (x0 + x1_);
-    const auto tanhVal = std::tanh(xbar);
+    const auto tanhVal = Tanh<kQuality>(xbar);
     const auto sech2 = 1.0f - tanhVal * tanhVal;
 
     // First-order Taylor approx for smaller dx values
@@ -36,7 +25,7 @@ float TanhADAA::process(const float x0) {
   } else {
     // Use the antiderivative formula
     // AD[tanh(x)] = log(cosh(x))
-    y = (LogCosh(x0) - LogCosh(x1_)) / dx;
+    y = (LogCosh<kQuality>(x0) - LogCosh<kQuality>(x1_)) / dx;
   }
 
   x1_ = Sanitize(x0);
@@ -47,4 +36,8 @@ void TanhADAA::reset() {
   x1_ = 0.0f;
 }
 
+template float TanhADAA::process<MathQuality::kFast>(float x0);
+template float TanhADAA::process<MathQuality::kHigh>(float x0);
+template float TanhADAA::process<MathQuality::kExact>(float x0);
+
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 import JuceImports;
 import std;
 
+#include "FastMath.h"
+
 namespace audio_plugin {
 /**
  * 1-st order approximation of tanh function using ADAA
@@ -10,9 +12,30 @@ class TanhADAA {
 public:
   TanhADAA();
 
+  // kQuality picks the tanh / log cosh approximations used
+  template <MathQuality kQuality>
   float process(float x0);
   void reset();
 
+  // the previous input, for OTAFilterBank to take over and hand back
+  float previous_input() const { return x1_; }
+  void set_previous_input(const float x1) { x1_ = x1; }
+
+  // below this change in input, process uses a Taylor expansion rather than
+  // the antiderivative
+  static constexpr float kTaylorTolerance = 1e-3f;
+
+  /**
+   * What process gives when x0 and x1 (the previous input) are both within
+   * kTanhLinearLimit, where tanh is as good as linear - to within the
+   * MathQuality's error. Doesn't update the previous input.
+   */
+  static float process_linear(const float x0, const float x1) {
+    // tanh(x) = x makes the Taylor expansion x0 and the antiderivative the
+    // mean of x0 and x1
+    return std::fabs(x0 - x1) < kTaylorTolerance ? x0 : 0.5f * (x0 + x1);
+  }
+
 private:
   // previous input
   float x1_;
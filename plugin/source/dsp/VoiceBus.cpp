@@ -0,0 +1,57 @@
+import JuceImports;
+import std;
+
+#include "VoiceBus.h"
+
+namespace audio_plugin {
+void VoiceBus::Prepare(const int max_block_size) {
+  for (std::size_t i = 0; i < buffers_.size(); ++i) {
+    const auto factor = 1 << i;
+    buffers_[i].setSize(1, max_block_size * factor, false, true);
+    buffers_[i].clear();
+    downsamplers_[i].prepare(max_block_size, factor);
+  }
+  tail_samples_.fill(0);
+  downsampled_.setSize(1, max_block_size, false, true);
+}
+
+void VoiceBus::Clear(const int num_samples) {
+  num_samples_ = num_samples;
+  for (std::size_t i = 0; i < buffers_.size(); ++i) {
+    if (tail_samples_[i] > 0) {
+      buffers_[i].clear(0, 0, num_samples << i);
+    }
+  }
+}
+
+juce::AudioBuffer<float>& VoiceBus::buffer(const int factor) {
+  const auto index = Index(factor);
+  if (tail_samples_[index] == 0) {
+    // picking up after being unused - whatever's left in it is stale
+    buffers_[index].clear(0, 0, num_samples_ << index);
+    downsamplers_[index].reset();
+  }
+  // this block, then the downsampler's tail
+  tail_samples_[index] = num_samples_ + downsamplers_[index].tail_samples();
+  return buffers_[index];
+}
+
+void VoiceBus::Downsample(juce::AudioBuffer<float>& output,
+                          const int num_samples) {
+  output.clear(0, 0, num_samples);
+  for (std::size_t i = 0; i < buffers_.size(); ++i) {
+    if (tail_samples_[i] == 0) continue;
+    tail_samples_[i] = std::max(0, tail_samples_[i] - num_samples);
+    // the downsampler is linear, so downsampling the mix is the same as
+    // downsampling every voice and summing
+    downsamplers_[i].process(buffers_[i], downsampled_, 0, num_samples << i);
+    output.addFrom(0, 0, downsampled_, 0, 0, num_samples);
+  }
+}
+
+std::size_t VoiceBus::Index(const int factor) {
+  jassert(factor <= kMaxOversample && juce::isPowerOfTwo(factor));
+  return static_cast<std::size_t>(
+      std::countr_zero(static_cast<unsigned>(factor)));
+}
+}  // namespace audio_plugin
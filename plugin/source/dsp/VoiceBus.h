@@ -0,0 +1,52 @@
+#pragma once
+import JuceImports;
+import std;
+
+#include "../Constants.h"
+#include "Downsampler.h"
+
+namespace audio_plugin {
+/**
+ * The voices' oversampled mono mix, with one buffer (and downsampler) per
+ * oversampling factor, since each voice runs at its own factor. Voices add
+ * into the buffer for their factor; the owner then downsamples each buffer
+ * in use once and sums them, so the downsampling cost doesn't grow with
+ * the number of voices.
+ */
+class VoiceBus {
+ public:
+  /**
+   * @param max_block_size most host rate samples in a block
+   */
+  void Prepare(int max_block_size);
+
+  /**
+   * Start a block of num_samples host rate samples.
+   */
+  void Clear(int num_samples);
+
+  /**
+   * The buffer voices running at factor add into this block.
+   */
+  juce::AudioBuffer<float>& buffer(int factor);
+
+  /**
+   * Write the mix of every buffer, downsampled, into the first channel of
+   * output.
+   */
+  void Downsample(juce::AudioBuffer<float>& output, int num_samples);
+
+ private:
+  static std::size_t Index(int factor);
+
+  // buffers_[n] / downsamplers_[n] are for factor 1 << n
+  std::array<juce::AudioBuffer<float>, kNumOversampleFactors> buffers_;
+  std::array<Downsampler, kNumOversampleFactors> downsamplers_;
+  // host rate samples each downsampler keeps running for after nothing was
+  // added to its buffer, so its filters ring out
+  std::array<int, kNumOversampleFactors> tail_samples_{};
+  // host rate samples in the current block
+  int num_samples_ = 0;
+  juce::AudioBuffer<float> downsampled_;
+};
+}  // namespace audio_plugin
@@ -0,0 +1,442 @@
+import JuceImports;
+import std;
+
+#include "OTAFilterBank.h"
+
+namespace audio_plugin {
+namespace {
+// Sanitize, without the logging, so it doesn't branch
+inline float SanitizeLane(const float value) {
+  return std::isinf(value) ? 1.0f : std::isnan(value) ? 0.0f : value;
+}
+
+// TanhADAA::process, working out both of its branches and picking one so it
+// doesn't branch. log_cosh_x0 / x1 are LogCosh of x0 / x1, as x1 was x0 for
+// the sample before.
+template <MathQuality kQuality>
+inline float TanhADAALane(const float x0, const float x1,
+                          const float log_cosh_x0, const float log_cosh_x1) {
+  const auto dx = x0 - x1;
+  const auto xbar = 0.5f * (x0 + x1);
+  const auto tanh_val = Tanh<kQuality>(xbar);
+  const auto sech2 = 1.0f - tanh_val * tanh_val;
+  const auto taylor = tanh_val + (dx / 2.0f) * sech2;
+  const auto antiderivative = (log_cosh_x0 - log_cosh_x1) / dx;
+  return std::fabs(dx) < TanhADAA::kTaylorTolerance ? taylor : antiderivative;
+}
+}  // namespace
+
+void OTAFilterBank::Add(OTAFilterTPTNewtonRaphson& filter,
+                        juce::AudioBuffer<float>& buffers,
+                        const int start_sample, const int num_samples) {
+  jassert(num_jobs_ < static_cast<int>(jobs_.size()));
+  if (num_samples <= 0) return;
+  jobs_[static_cast<std::size_t>(num_jobs_++)] = {
+      &filter, &buffers, start_sample, num_samples};
+}
+
+void OTAFilterBank::Process() {
+  const auto jobs = std::span{jobs_}.first(static_cast<std::size_t>(num_jobs_));
+  num_jobs_ = 0;
+  // lanes step through their blocks together, so they only share blocks of
+  // the same length (the same oversampling factor)
+  std::ranges::sort(jobs, [](const Job& a, const Job& b) {
+    return std::tie(a.filter->math_quality_, a.num_samples) <
+           std::tie(b.filter->math_quality_, b.num_samples);
+  });
+  for (std::size_t first = 0; first < jobs.size();) {
+    const auto& first_job = jobs[first];
+    const auto math_quality = first_job.filter->math_quality_;
+    auto last = first + 1;
+    while (last < jobs.size() && last - first < kLanes &&
+           jobs[last].filter->math_quality_ == math_quality &&
+           jobs[last].num_samples == first_job.num_samples) {
+      ++last;
+    }
+    const auto* lane_jobs = jobs.data() + first;
+    const auto num_lane_jobs = last - first;
+    if (num_lane_jobs == 1) {
+      // a filter on its own is quicker without the lanes
+      first_job.filter->Process(*first_job.buffers, first_job.start_sample,
+                                first_job.num_samples);
+    } else {
+      switch (math_quality) {
+        case MathQuality::kFast:
+          ProcessLanes<MathQuality::kFast>(lane_jobs, num_lane_jobs);
+          break;
+        case MathQuality::kHigh:
+          ProcessLanes<MathQuality::kHigh>(lane_jobs, num_lane_jobs);
+          break;
+        case MathQuality::kExact:
+          ProcessLanes<MathQuality::kExact>(lane_jobs, num_lane_jobs);
+          break;
+      }
+    }
+    first = last;
+  }
+}
+
+template <MathQuality kQuality>
+std::array<bool, OTAFilterBank::kLanes> OTAFilterBank::SolveLinearLanes(
+    const int t, const std::size_t max_stages,
+    const std::array<bool, kLanes>& active,
+    const std::array<float, kLanes>& in, const std::array<float, kLanes>& G) {
+  auto& lanes = lanes_;
+  constexpr auto limit = kTanhLinearLimit<kQuality>;
+  // SolveLinear's maths, the same way round as ProcessLanes does
+  // ProcessSample's. Lanes out of range carry on to the end, then drop out.
+  std::array<float, kLanes> a;
+  std::array<float, kLanes> b;
+  for (std::size_t l = 0; l < kLanes; ++l) {
+    a[l] = 1.0f;
+    b[l] = 0.0f;
+  }
+  for (std::size_t n = 0; n < max_stages; ++n) {
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      const auto used = static_cast<int>(n) < lanes.num_stages[l];
+      a[l] = used ? G[l] * a[l] : a[l];
+      b[l] = used ? G[l] * b[l] + (1.0f - G[l]) * lanes.s[n][l] : b[l];
+    }
+  }
+  auto linear = active;
+  std::array<float, kLanes> solution;
+  std::array<float, kLanes> x;
+  for (std::size_t l = 0; l < kLanes; ++l) {
+    solution[l] = (a[l] * in[l] + b[l]) / (1.0f + lanes.k[l] * a[l]);
+    x[l] = in[l] - lanes.k[l] * solution[l];
+  }
+  for (std::size_t n = 0; n < max_stages; ++n) {
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      const auto used = static_cast<int>(n) < lanes.num_stages[l];
+      const auto s = lanes.s[n][l];
+      const auto in_range = (std::abs(x[l] / lanes.drive[n][l]) < limit) &
+                            (std::abs(s / lanes.state_drive[n][l]) < limit);
+      linear[l] = used ? linear[l] & in_range : linear[l];
+      x[l] = s + G[l] * (x[l] - s);
+    }
+  }
+  bool any_linear = false;
+  for (std::size_t l = 0; l < kLanes; ++l) {
+    any_linear = any_linear || linear[l];
+  }
+  if (!any_linear) return linear;
+
+  // the final evaluation, through the ADAA stages
+  std::array<std::array<float, kLanes>, 4> v;
+  std::array<std::array<float, kLanes>, 4> v_in;
+  std::array<std::array<float, kLanes>, 4> s_in;
+  std::array<float, kLanes> final_out{};
+  for (std::size_t l = 0; l < kLanes; ++l) {
+    x[l] = in[l] - lanes.k[l] * solution[l];
+  }
+  for (std::size_t n = 0; n < max_stages; ++n) {
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      const auto used = static_cast<int>(n) < lanes.num_stages[l];
+      const auto drive = lanes.drive[n][l];
+      const auto state_drive = lanes.state_drive[n][l];
+      const auto s = lanes.s[n][l];
+      v_in[n][l] = x[l] / drive;
+      s_in[n][l] = s / state_drive;
+      const auto v_previous = lanes.adaa[n][l];
+      const auto s_previous = lanes.state_adaa[n][l];
+      const auto in_range = (std::abs(v_in[n][l]) < limit) &
+                            (std::abs(v_previous) < limit) &
+                            (std::abs(s_previous) < limit);
+      linear[l] = used ? linear[l] & in_range : linear[l];
+      v[n][l] =
+          s + G[l] * (TanhADAA::process_linear(v_in[n][l], v_previous) * drive -
+                      TanhADAA::process_linear(s_in[n][l], s_previous) *
+                          state_drive);
+      x[l] = v[n][l];
+      final_out[l] = lanes.num_stages[l] == static_cast<int>(n) + 1
+                         ? x[l]
+                         : final_out[l];
+    }
+  }
+
+  // the state update
+  std::array<std::array<float, kLanes>, 4> updated;
+  for (std::size_t l = 0; l < kLanes; ++l) {
+    x[l] = in[l] - lanes.k[l] * final_out[l];
+  }
+  for (std::size_t n = 0; n < max_stages; ++n) {
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      const auto used = static_cast<int>(n) < lanes.num_stages[l];
+      const auto s = lanes.s[n][l];
+      const auto in_range = std::abs(x[l] / lanes.drive[n][l]) < limit;
+      linear[l] = used ? linear[l] & in_range : linear[l];
+      updated[n][l] = s + 2.0f * G[l] * (x[l] - s);
+      x[l] = v[n][l];
+    }
+  }
+
+  for (std::size_t n = 0; n < max_stages; ++n) {
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      const auto update =
+          linear[l] & (static_cast<int>(n) < lanes.num_stages[l]);
+      lanes.s[n][l] = update ? updated[n][l] : lanes.s[n][l];
+      lanes.adaa[n][l] = update ? v_in[n][l] : lanes.adaa[n][l];
+      lanes.state_adaa[n][l] = update ? s_in[n][l] : lanes.state_adaa[n][l];
+    }
+  }
+  for (std::size_t l = 0; l < kLanes; ++l) {
+    lanes.solutions[2][l] =
+        linear[l] ? lanes.solutions[1][l] : lanes.solutions[2][l];
+    lanes.solutions[1][l] =
+        linear[l] ? lanes.solutions[0][l] : lanes.solutions[1][l];
+    lanes.solutions[0][l] = linear[l] ? solution[l] : lanes.solutions[0][l];
+    lanes.linear_samples[l] += linear[l] ? 1u : 0u;
+    if (linear[l]) lanes.data[l][t] = final_out[l];
+  }
+  return linear;
+}
+
+template <MathQuality kQuality>
+void OTAFilterBank::ProcessLanes(const Job* jobs, const std::size_t num_jobs) {
+  auto& lanes = lanes_;
+  int max_samples = 0;
+  std::size_t max_stages = 1;
+  for (std::size_t l = 0; l < kLanes; ++l) {
+    // spare lanes copy the last filter, so they compute something sane, but
+    // have no samples
+    const auto& job = jobs[std::min(l, num_jobs - 1)];
+    const auto& filter = *job.filter;
+    lanes.data[l] = job.buffers->getWritePointer(0, job.start_sample);
+    lanes.env_data[l] =
+        filter.mod_bus_.Read(filter.env_source_) + job.start_sample;
+    lanes.lfo_data[l] =
+        filter.mod_bus_.Read(ModulationBus::kLfo) + job.start_sample;
+    lanes.num_samples[l] = l < num_jobs ? job.num_samples : 0;
+    max_samples = std::max(max_samples, lanes.num_samples[l]);
+    lanes.cutoff_freq[l] = filter.cutoff_freq_;
+    lanes.env_mod[l] = filter.env_mod_;
+    lanes.lfo_mod[l] = filter.lfo_mod_;
+    lanes.sample_rate[l] = filter.sample_rate_;
+    lanes.k[l] = std::clamp(filter.resonance_, 0.0f, 0.99f) * 4.0f;
+    lanes.num_stages[l] = filter.num_stages_;
+    max_stages =
+        std::max(max_stages, static_cast<std::size_t>(lanes.num_stages[l]));
+    for (std::size_t i = 0; i < 3; ++i) {
+      lanes.solutions[i][l] = filter.solutions_[i];
+    }
+    lanes.iterations[l] = 0;
+    lanes.linear_samples[l] = 0;
+    for (std::size_t n = 0; n < 4; ++n) {
+      lanes.drive[n][l] = filter.drive_ * filter.input_drive_scales_[n];
+      lanes.state_drive[n][l] = filter.drive_ * filter.state_drive_scales_[n];
+      lanes.s[n][l] = filter.s_[n];
+      lanes.adaa[n][l] = filter.tanh_stages_[n].previous_input();
+      lanes.state_adaa[n][l] = filter.state_tanh_stages_[n].previous_input();
+      lanes.adaa_log_cosh[n][l] = LogCosh<kQuality>(lanes.adaa[n][l]);
+      lanes.state_adaa_log_cosh[n][l] =
+          LogCosh<kQuality>(lanes.state_adaa[n][l]);
+    }
+  }
+  // what the ADAA history's log cosh becomes when it's sanitised
+  const auto log_cosh_inf = LogCosh<kQuality>(1.0f);
+  const auto log_cosh_nan = LogCosh<kQuality>(0.0f);
+  // SolveLinearLanes moves the ADAA history on without its log cosh
+  bool stale_log_cosh = false;
+
+  // The maths below is OTAFilterTPTNewtonRaphson::ProcessSample's (with
+  // EvaluateFilter and EvaluateFilterADAA written out), in the same order so
+  // it rounds the same, but a stage at a time across all the lanes. Lanes
+  // with fewer stages pick their result out as it goes by.
+  constexpr int max_iterations = 4;
+  constexpr float tolerance = 1e-6f;
+  constexpr float converged_step = 1e-3f;
+  for (int t = 0; t < max_samples; ++t) {
+    std::array<bool, kLanes> active;
+    std::array<float, kLanes> in;
+    std::array<float, kLanes> G;
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      active[l] = t < lanes.num_samples[l];
+      // lanes past the end of their block read their first sample instead
+      const auto i = active[l] ? t : 0;
+      in[l] = lanes.data[l][i];
+      const float modulated_cutoff = juce::jlimit(
+          kMinCutoff, kMaxCutoff,
+          lanes.cutoff_freq[l] +
+              lanes.env_mod[l] * lanes.env_data[l][i] * kMaxCutoff +
+              lanes.lfo_mod[l] * lanes.lfo_data[l][i] * kMaxCutoff);
+      const float g = Tan<kQuality>(juce::MathConstants<float>::pi *
+                                    modulated_cutoff / lanes.sample_rate[l]);
+      const float g_clamped = std::min(g, OTAFilterTPTNewtonRaphson::kMaxG);
+      G[l] = g_clamped / (1.0f + g_clamped);
+    }
+
+    const auto linear = SolveLinearLanes<kQuality>(t, max_stages, active, in, G);
+    // the stages that run this sample - none when the lane's block is done,
+    // or it was solved in closed form
+    std::array<int, kLanes> stages;
+    bool any_stages = false;
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      stages[l] = active[l] & !linear[l] ? lanes.num_stages[l] : 0;
+      any_stages = any_stages || stages[l] > 0;
+      stale_log_cosh = stale_log_cosh || linear[l];
+    }
+    if (!any_stages) continue;
+    if (stale_log_cosh) {
+      for (std::size_t n = 0; n < max_stages; ++n) {
+        for (std::size_t l = 0; l < kLanes; ++l) {
+          lanes.adaa_log_cosh[n][l] = LogCosh<kQuality>(lanes.adaa[n][l]);
+          lanes.state_adaa_log_cosh[n][l] =
+              LogCosh<kQuality>(lanes.state_adaa[n][l]);
+        }
+      }
+      stale_log_cosh = false;
+    }
+
+    std::array<float, kLanes> out_guess;
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      out_guess[l] = OTAFilterTPTNewtonRaphson::WarmStart(
+          {lanes.solutions[0][l], lanes.solutions[1][l],
+           lanes.solutions[2][l]});
+    }
+    std::array<std::array<float, kLanes>, 4> s_sat;
+    for (std::size_t n = 0; n < max_stages; ++n) {
+      for (std::size_t l = 0; l < kLanes; ++l) {
+        const auto state_drive = lanes.state_drive[n][l];
+        s_sat[n][l] = Tanh<kQuality>(lanes.s[n][l] / state_drive) * state_drive;
+      }
+    }
+
+    // Newton-Raphson. A lane that has converged keeps its guess while the
+    // others carry on.
+    std::array<bool, kLanes> solving;
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      solving[l] = stages[l] > 0;
+    }
+    for (int iter = 0; iter < max_iterations; ++iter) {
+      std::array<float, kLanes> x;
+      std::array<float, kLanes> deriv;
+      std::array<float, kLanes> predicted_out{};
+      std::array<float, kLanes> dF{};
+      for (std::size_t l = 0; l < kLanes; ++l) {
+        x[l] = in[l] - lanes.k[l] * out_guess[l];
+        deriv[l] = -lanes.k[l];
+      }
+      for (std::size_t n = 0; n < max_stages; ++n) {
+        for (std::size_t l = 0; l < kLanes; ++l) {
+          const auto drive = lanes.drive[n][l];
+          const float sat = Tanh<kQuality>(x[l] / drive);
+          deriv[l] = G[l] * (deriv[l] * (1.0f - sat * sat));
+          x[l] = lanes.s[n][l] + G[l] * (sat * drive - s_sat[n][l]);
+          const auto last = lanes.num_stages[l] == static_cast<int>(n) + 1;
+          predicted_out[l] = last ? x[l] : predicted_out[l];
+          dF[l] = last ? deriv[l] : dF[l];
+        }
+      }
+      bool any_solving = false;
+      for (std::size_t l = 0; l < kLanes; ++l) {
+        lanes.iterations[l] += solving[l] ? 1u : 0u;
+        const float residual = out_guess[l] - predicted_out[l];
+        const float jacobian = 1.0f - dF[l];
+        const float step = residual / jacobian;
+        solving[l] = solving[l] && !(std::abs(residual) < tolerance) &&
+                     !(std::abs(jacobian) < 1e-10f);
+        out_guess[l] = solving[l]
+                           ? std::clamp(out_guess[l] - step, -10.0f, 10.0f)
+                           : out_guess[l];
+        solving[l] = solving[l] && !(std::abs(step) < converged_step);
+        any_solving = any_solving || solving[l];
+      }
+      if (!any_solving) break;
+    }
+
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      const auto solved = stages[l] > 0;
+      lanes.solutions[2][l] =
+          solved ? lanes.solutions[1][l] : lanes.solutions[2][l];
+      lanes.solutions[1][l] =
+          solved ? lanes.solutions[0][l] : lanes.solutions[1][l];
+      lanes.solutions[0][l] = solved ? out_guess[l] : lanes.solutions[0][l];
+    }
+
+    // the final evaluation, through the ADAA stages
+    std::array<float, kLanes> x;
+    std::array<float, kLanes> final_out{};
+    std::array<std::array<float, kLanes>, 4> v{};
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      x[l] = in[l] - lanes.k[l] * out_guess[l];
+    }
+    for (std::size_t n = 0; n < max_stages; ++n) {
+      for (std::size_t l = 0; l < kLanes; ++l) {
+        const auto drive = lanes.drive[n][l];
+        const auto state_drive = lanes.state_drive[n][l];
+        const auto s = lanes.s[n][l];
+        const auto v_in = x[l] / drive;
+        const auto s_in = s / state_drive;
+        const auto v_log_cosh = LogCosh<kQuality>(v_in);
+        const auto s_log_cosh = LogCosh<kQuality>(s_in);
+        const float v_sat =
+            TanhADAALane<kQuality>(v_in, lanes.adaa[n][l], v_log_cosh,
+                                   lanes.adaa_log_cosh[n][l]) *
+            drive;
+        const float s_sat_adaa =
+            TanhADAALane<kQuality>(s_in, lanes.state_adaa[n][l], s_log_cosh,
+                                   lanes.state_adaa_log_cosh[n][l]) *
+            state_drive;
+        v[n][l] = s + G[l] * (v_sat - s_sat_adaa);
+        x[l] = v[n][l];
+        final_out[l] = lanes.num_stages[l] == static_cast<int>(n) + 1
+                           ? SanitizeLane(x[l])
+                           : final_out[l];
+
+        const auto used = static_cast<int>(n) < stages[l];
+        // the log cosh of what SanitizeLane makes the history
+        const auto v_history_log_cosh = std::isinf(v_in)   ? log_cosh_inf
+                                        : std::isnan(v_in) ? log_cosh_nan
+                                                           : v_log_cosh;
+        const auto s_history_log_cosh = std::isinf(s_in)   ? log_cosh_inf
+                                        : std::isnan(s_in) ? log_cosh_nan
+                                                           : s_log_cosh;
+        lanes.adaa_log_cosh[n][l] =
+            used ? v_history_log_cosh : lanes.adaa_log_cosh[n][l];
+        lanes.state_adaa_log_cosh[n][l] =
+            used ? s_history_log_cosh : lanes.state_adaa_log_cosh[n][l];
+        lanes.adaa[n][l] = used ? SanitizeLane(v_in) : lanes.adaa[n][l];
+        lanes.state_adaa[n][l] =
+            used ? SanitizeLane(s_in) : lanes.state_adaa[n][l];
+      }
+    }
+
+    // state update, from the converged output
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      x[l] = in[l] - lanes.k[l] * final_out[l];
+    }
+    for (std::size_t n = 0; n < max_stages; ++n) {
+      for (std::size_t l = 0; l < kLanes; ++l) {
+        const auto drive = lanes.drive[n][l];
+        const float v_sat = Tanh<kQuality>(x[l] / drive) * drive;
+        const auto s = lanes.s[n][l];
+        const auto updated =
+            SanitizeLane(s + 2.0f * G[l] * (v_sat - s_sat[n][l]));
+        const auto used = static_cast<int>(n) < stages[l];
+        lanes.s[n][l] = used ? updated : s;
+        x[l] = v[n][l];
+      }
+    }
+    for (std::size_t l = 0; l < kLanes; ++l) {
+      if (stages[l] > 0) lanes.data[l][t] = final_out[l];
+    }
+  }
+
+  for (std::size_t l = 0; l < num_jobs; ++l) {
+    auto& filter = *jobs[l].filter;
+    for (std::size_t i = 0; i < 3; ++i) {
+      filter.solutions_[i] = lanes.solutions[i][l];
+    }
+    filter.solver_stats_.samples +=
+        static_cast<std::uint64_t>(lanes.num_samples[l]);
+    filter.solver_stats_.iterations += lanes.iterations[l];
+    filter.solver_stats_.linear_samples += lanes.linear_samples[l];
+    for (std::size_t n = 0; n < 4; ++n) {
+      filter.s_[n] = lanes.s[n][l];
+      filter.tanh_stages_[n].set_previous_input(lanes.adaa[n][l]);
+      filter.state_tanh_stages_[n].set_previous_input(lanes.state_adaa[n][l]);
+    }
+  }
+}
+
+}  // namespace audio_plugin
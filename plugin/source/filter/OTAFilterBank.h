@@ -0,0 +1,102 @@
+#pragma once
+import JuceImports;
+import std;
+
+#include "../Constants.h"
+#include "../dsp/FastMath.h"
+#include "OTAFilterTPTNewtonRaphson.h"
+
+namespace audio_plugin {
+
+/**
+ * Runs the OTAFilterTPTNewtonRaphson filters of several voices together, one
+ * voice per lane. The Newton-Raphson solve depends on the sample before, so
+ * it can't be vectorised along a voice's block - across voices it can.
+ *
+ * Each voice Adds its filter and block. Process then takes up to kLanes
+ * filters with blocks of the same length at a time, copies their state and
+ * settings into the lanes, steps through their blocks together (lanes that
+ * have converged sit out the rest of the iterations) and hands the state
+ * back. So the filters stay the owners of their state, and a voice can filter
+ * on its own for a block whenever it isn't part of a bank. The output is the
+ * same either way, to the bit.
+ */
+class OTAFilterBank {
+ public:
+  // 4 floats fill an SSE / NEON register, the widest the default build
+  // targets. A lane that's left idle costs as much as a busy one.
+  static constexpr std::size_t kLanes = 4;
+
+  /**
+   * Filter the block in place in the next Process, as filter.Process would.
+   * Doesn't allocate.
+   */
+  void Add(OTAFilterTPTNewtonRaphson& filter, juce::AudioBuffer<float>& buffers,
+           int start_sample, int num_samples);
+
+  /**
+   * Filter every block added since the last Process.
+   */
+  void Process();
+
+ private:
+  struct Job {
+    OTAFilterTPTNewtonRaphson* filter;
+    juce::AudioBuffer<float>* buffers;
+    int start_sample;
+    int num_samples;
+  };
+
+  // one lane per filter
+  struct Lanes {
+    std::array<float*, kLanes> data;
+    std::array<const float*, kLanes> env_data;
+    std::array<const float*, kLanes> lfo_data;
+    std::array<int, kLanes> num_samples;
+    // settings
+    std::array<float, kLanes> cutoff_freq;
+    std::array<float, kLanes> env_mod;
+    std::array<float, kLanes> lfo_mod;
+    std::array<float, kLanes> sample_rate;
+    // resonance feedback amount
+    std::array<float, kLanes> k;
+    std::array<int, kLanes> num_stages;
+    // the drive scaled for each stage's input / state
+    std::array<std::array<float, kLanes>, 4> drive;
+    std::array<std::array<float, kLanes>, 4> state_drive;
+    // state
+    std::array<std::array<float, kLanes>, 4> s;
+    // the last three solved outputs, latest first
+    std::array<std::array<float, kLanes>, 3> solutions;
+    // filter evaluations while solving, and samples solved in closed form,
+    // for the filter's SolverStats
+    std::array<std::uint64_t, kLanes> iterations;
+    std::array<std::uint64_t, kLanes> linear_samples;
+    // each stage's input / state ADAA history, and its log cosh
+    std::array<std::array<float, kLanes>, 4> adaa;
+    std::array<std::array<float, kLanes>, 4> state_adaa;
+    std::array<std::array<float, kLanes>, 4> adaa_log_cosh;
+    std::array<std::array<float, kLanes>, 4> state_adaa_log_cosh;
+  };
+
+  /**
+   * Copy jobs (up to kLanes, all at the same MathQuality, with blocks of the
+   * same length) into lanes_, filter them and copy their state back.
+   */
+  template <MathQuality kQuality>
+  void ProcessLanes(const Job* jobs, std::size_t num_jobs);
+  /**
+   * OTAFilterTPTNewtonRaphson::SolveLinear for sample t of each active lane.
+   * Returns the lanes it filtered, which are done with for the sample.
+   */
+  template <MathQuality kQuality>
+  std::array<bool, kLanes> SolveLinearLanes(
+      int t, std::size_t max_stages, const std::array<bool, kLanes>& active,
+      const std::array<float, kLanes>& in, const std::array<float, kLanes>& G);
+
+  std::array<Job, kNumVoices> jobs_;
+  int num_jobs_ = 0;
+  Lanes lanes_;
+};
+
+}  // namespace audio_plugin
@@ -8,32 +8,30 @@ import std;
 
 namespace audio_plugin {
 OTAFilterDelayedFeedback::OTAFilterDelayedFeedback(
-    const juce::AudioBuffer<float>& env_buffer,
-    const juce::AudioBuffer<float>& lfo_buffer)
+    const ModulationBus& mod_bus)
     : cutoff_freq_{0.f},
       resonance_{0.f},
       drive_{0.f},
       env_mod_{0.f},
       lfo_mod_{0.f},
+      mod_bus_{mod_bus},
+      env_source_{ModulationBus::kEnv1},
+      math_quality_{MathQuality::kHigh},
       num_stages_{4},
-      env_buffer_{&env_buffer},
-      lfo_buffer_{lfo_buffer},
       sample_rate_{0},
-      s1_{0},
-      s2_{0},
-      s3_{0},
-      s4_{0},
+      s_{},
       dc_out_x1_{0},
       dc_out_y1_{0} {}
 
+template <MathQuality kQuality>
 inline void OTAFilterDelayedFeedback::FilterStage(const float in, float& out,
                                    TanhADAA& tanh_in, TanhADAA& tanh_state,
                                    const float g, const float scale) const {
   constexpr auto kLeak = 0.99995f;
   const auto stage_index = &tanh_in - &tanh_in_[0];
   const auto state_scale = 1.f / (drive_ * state_drive_scales_[static_cast<size_t>(stage_index)]);
-  const auto tanh_in_val = tanh_in.process(in * scale);
-  const auto tanh_state_val = tanh_state.process(out * state_scale);
+  const auto tanh_in_val = tanh_in.process<kQuality>(in * scale);
+  const auto tanh_state_val = tanh_state.process<kQuality>(out * state_scale);
   const float v = tanh_in_val * (1.f / scale);
   out = Sanitize(kLeak * out + g * (v - tanh_state_val * (1.f / state_scale)));
 }
@@ -42,20 +40,69 @@ void OTAFilterDelayedFeedback::Process(juce::AudioBuffer<float>& buffers,
                                        const int start_sample,
                                        const int numSamples) {
   jassert(sample_rate_ > 0);
+  (this->*process_block_)(buffers, start_sample, numSamples);
+}
+
+void OTAFilterDelayedFeedback::set_math_quality(
+    const MathQuality math_quality) {
+  math_quality_ = math_quality;
+  SelectProcessBlock();
+}
 
+void OTAFilterDelayedFeedback::set_num_stages(const int num_stages) {
+  num_stages_ = num_stages == 2 || num_stages == 3 ? num_stages : 4;
+  SelectProcessBlock();
+}
+
+void OTAFilterDelayedFeedback::SelectProcessBlock() {
+  switch (math_quality_) {
+    case MathQuality::kFast:
+      SelectProcessBlock<MathQuality::kFast>();
+      break;
+    case MathQuality::kHigh:
+      SelectProcessBlock<MathQuality::kHigh>();
+      break;
+    case MathQuality::kExact:
+      SelectProcessBlock<MathQuality::kExact>();
+      break;
+  }
+}
+
+template <MathQuality kQuality>
+void OTAFilterDelayedFeedback::SelectProcessBlock() {
+  switch (num_stages_) {
+    case 2:
+      process_block_ = &OTAFilterDelayedFeedback::ProcessBlock<kQuality, 2>;
+      break;
+    case 3:
+      process_block_ = &OTAFilterDelayedFeedback::ProcessBlock<kQuality, 3>;
+      break;
+    default:
+      process_block_ = &OTAFilterDelayedFeedback::ProcessBlock<kQuality, 4>;
+      break;
+  }
+}
+
+template <MathQuality kQuality, std::size_t kNumStages>
+void OTAFilterDelayedFeedback::ProcessBlock(juce::AudioBuffer<float>& buffers,
+                                            const int start_sample,
+                                            const int numSamples) {
   // todo vectorize
   const auto buf = buffers.getWritePointer(0);
-  const auto env_data = env_buffer_->getReadPointer(0);
-  const auto lfo_data = lfo_buffer_.getReadPointer(0);
+  const auto env_data = mod_bus_.Read(env_source_);
+  const auto lfo_data = mod_bus_.Read(ModulationBus::kLfo);
+  // the integrator states, kept in registers rather than reloaded after every
+  // write to buf
+  auto s = s_;
 
   for (auto i = start_sample; i < start_sample + numSamples; ++i) {
     const auto sample = buf[i];
     // modulation - envelope and LFO affects cutoff frequency
-    const float modulated_cutoff = juce::jlimit(kMinCutoff, kMaxCutoff, cutoff_freq_ + env_mod_ * env_data[i / kOversample] * kMaxCutoff + lfo_mod_ * lfo_data[i / kOversample] * kMaxCutoff);
+    const float modulated_cutoff = juce::jlimit(kMinCutoff, kMaxCutoff, cutoff_freq_ + env_mod_ * env_data[i] * kMaxCutoff + lfo_mod_ * lfo_data[i] * kMaxCutoff);
 
     // this was my original "naive" approach which can exceed 1 in some cases and blow the filter up.
     // It seems to work fine now that I've addressed other issues with the filter.
-    const auto g = tanf(juce::MathConstants<float>::pi * modulated_cutoff / static_cast<float>(sample_rate_));
+    const auto g = Tan<kQuality>(juce::MathConstants<float>::pi * modulated_cutoff / sample_rate_);
     // this TPT method of calculating g ensures the value won't exceed 1.
     //const auto g = tanf(juce::MathConstants<float>::pi * modulated_cutoff/static_cast<float>(sample_rate_)) /
     //  (1 + tanf(juce::MathConstants<float>::pi * modulated_cutoff/static_cast<float>(sample_rate_)));
@@ -63,14 +110,7 @@ void OTAFilterDelayedFeedback::Process(juce::AudioBuffer<float>& buffers,
     //const auto g = std::min(.9f, std::tanf(juce::MathConstants<float>::pi * modulated_cutoff/static_cast<float>(sample_rate_)));
 
     // resonance feedback from output
-    float last_stage_output = 0;
-    switch (num_stages_) {
-      case 1: last_stage_output = s1_; break;
-      case 2: last_stage_output = s2_; break;
-      case 3: last_stage_output = s3_; break;
-      case 4: last_stage_output = s4_; break;
-      default: last_stage_output = s4_; break;
-    }
+    const auto last_stage_output = s[kNumStages - 1];
 
     // feedback with compensation
     //const auto feedback = resonance_ * last_stage_output / (1 + resonance_ * (1.f / static_cast<float>(num_stages_)));
@@ -82,14 +122,14 @@ void OTAFilterDelayedFeedback::Process(juce::AudioBuffer<float>& buffers,
     // todo: we could even expose this as yet another param
     constexpr auto kFeedbackDrive = 1.f;
     constexpr auto kFeedbackScale = 1.f / kFeedbackDrive;
-    const auto u = sample - tanh_feedback_.process(feedback * kFeedbackScale) * kFeedbackDrive;
+    const auto u = sample - tanh_feedback_.process<kQuality>(feedback * kFeedbackScale) * kFeedbackDrive;
 
     // todo: different scale / drive amount for each stage as opposed to the same for each.
 
-    FilterStage(u, s1_, tanh_in_[0], tanh_state_[0], g, 1.f / (drive_ * input_drive_scales_[0]));
-    if (num_stages_ >= 2) FilterStage(s1_, s2_, tanh_in_[1], tanh_state_[1], g, 1.f / (drive_ * input_drive_scales_[1]));
-    if (num_stages_ >= 3) FilterStage(s2_, s3_, tanh_in_[2], tanh_state_[2], g, 1.f / (drive_ * input_drive_scales_[2]));
-    if (num_stages_ >= 4) FilterStage(s3_, s4_, tanh_in_[3], tanh_state_[3], g, 1.f / (drive_ * input_drive_scales_[3]));
+    FilterStage<kQuality>(u, s[0], tanh_in_[0], tanh_state_[0], g, 1.f / (drive_ * input_drive_scales_[0]));
+    for (std::size_t n = 1; n < kNumStages; ++n) {
+      FilterStage<kQuality>(s[n - 1], s[n], tanh_in_[n], tanh_state_[n], g, 1.f / (drive_ * input_drive_scales_[n]));
+    }
 
     // DC block and soft clip the output
     // try 2.0 - 4.0 range
@@ -98,7 +138,7 @@ void OTAFilterDelayedFeedback::Process(juce::AudioBuffer<float>& buffers,
     constexpr auto kOutputScale = 1.f / kOutputDrive;
     // prevents the clipping inherent in the TanhADAA calculation
     // (happens at extreme g, res, drive values)
-    const auto tanh_final_out_val = tanh_final_out_.process((last_stage_output) * kOutputScale);
+    const auto tanh_final_out_val = tanh_final_out_.process<kQuality>((last_stage_output) * kOutputScale);
     const auto dc_in = tanh_final_out_val;
     const auto dc_out = Sanitize(dc_in - dc_out_x1_ + 0.99f * dc_out_y1_);
     dc_out_x1_ = dc_in;
@@ -107,33 +147,31 @@ void OTAFilterDelayedFeedback::Process(juce::AudioBuffer<float>& buffers,
     // we don't clamp here.
     buf[i] = dc_out;
   }
+  s_ = s;
 }
 
-void OTAFilterDelayedFeedback::Configure(const juce::AudioProcessorValueTreeState& state) {
-  cutoff_freq_ = state.getRawParameterValue("filterCutoffFreq")->load();
-  resonance_ = state.getRawParameterValue("filterResonance")->load();
-  drive_ = state.getRawParameterValue("filterDrive")->load();
-  env_mod_ = state.getRawParameterValue("filterEnvMod")->load();
-  lfo_mod_ = state.getRawParameterValue("filterLfoMod")->load();
-  for (int i = 0; i < 4; ++i) {
+void OTAFilterDelayedFeedback::Configure(const ParameterTable& params) {
+  cutoff_freq_ = params.Get(ParamId::kFilterCutoffFreq);
+  resonance_ = params.Get(ParamId::kFilterResonance);
+  drive_ = params.Get(ParamId::kFilterDrive);
+  env_mod_ = params.Get(ParamId::kFilterEnvMod);
+  lfo_mod_ = params.Get(ParamId::kFilterLfoMod);
+  for (int i = 0; i < kNumDriveScaleStages; ++i) {
     input_drive_scales_[static_cast<size_t>(i)] =
-        state.getRawParameterValue("filterInputDriveScale" + juce::String(i + 1))
-            ->load();
+        params.Get(FilterInputDriveScaleId(i));
     state_drive_scales_[static_cast<size_t>(i)] =
-        state.getRawParameterValue("filterStateDriveScale" + juce::String(i + 1))
-            ->load();
+        params.Get(FilterStateDriveScaleId(i));
   }
-  switch (static_cast<int>(
-              state.getRawParameterValue("filterSlope")->load())) {
-    case 0: num_stages_ = 4; break;
-    case 1: num_stages_ = 3; break;
-    case 2: num_stages_ = 2; break;
-    default: num_stages_ = 4; break;
+  switch (params.GetInt(ParamId::kFilterSlope)) {
+    case 0: set_num_stages(4); break;
+    case 1: set_num_stages(3); break;
+    case 2: set_num_stages(2); break;
+    default: set_num_stages(4); break;
   }
 }
 
 void OTAFilterDelayedFeedback::Reset() {
-  s1_ = s2_ = s3_ = s4_ = 0;
+  s_ = {};
   dc_out_x1_ = dc_out_y1_ = 0;
   tanh_final_out_.reset();
   tanh_feedback_.reset();
@@ -2,6 +2,9 @@
 import JuceImports;
 import std;
 
+#include "../Parameters.h"
+#include "../dsp/FastMath.h"
+#include "../dsp/ModulationBus.h"
 #include "../dsp/TanhADAA.h"
 
 namespace audio_plugin {
@@ -13,8 +16,11 @@ namespace audio_plugin {
  */
 class OTAFilterDelayedFeedback {
  public:
-  OTAFilterDelayedFeedback(const juce::AudioBuffer<float>& env_buffer,
-                           const juce::AudioBuffer<float>& lfo_buffer);
+  /**
+   * @param mod_bus the voice's modulation sources, read at the oversampled
+   * rate
+   */
+  OTAFilterDelayedFeedback(const ModulationBus& mod_bus);
   /**
    * Perform in place filtering on the left channel only,
    * for numSamples samples.
@@ -22,14 +28,21 @@ class OTAFilterDelayedFeedback {
   void Process(juce::AudioBuffer<float>& buffers, int start_sample,
                int numSamples);
 
-  void set_env_buffer(const juce::AudioBuffer<float>& env_buffer) {
-    env_buffer_ = &env_buffer;
+  // which envelope modulates the cutoff
+  void set_env_source(const ModulationBus::Source env_source) {
+    env_source_ = env_source;
   }
 
+  // accuracy of the tanh / tan approximations
+  void set_math_quality(MathQuality math_quality);
+
+  // 2, 3 or 4, for -12 / -18 / -24 dB. Anything else is 4.
+  void set_num_stages(int num_stages);
+
   /**
    * Update params based on current state
    */
-  void Configure(const juce::AudioProcessorValueTreeState& state);
+  void Configure(const ParameterTable& params);
 
   /**
    * Reset for next note
@@ -43,19 +56,36 @@ class OTAFilterDelayedFeedback {
   float drive_;
   float env_mod_;
   float lfo_mod_;
-  int num_stages_;
   std::array<float, 4> input_drive_scales_;
   std::array<float, 4> state_drive_scales_;
 
  private:
+  // Each MathQuality and number of stages has its own ProcessBlock, so the
+  // stages unroll.
+  template <MathQuality kQuality, std::size_t kNumStages>
+  void ProcessBlock(juce::AudioBuffer<float>& buffers, int start_sample,
+                    int numSamples);
+  // point process_block_ at the ProcessBlock for math_quality_ and
+  // num_stages_
+  void SelectProcessBlock();
+  template <MathQuality kQuality>
+  void SelectProcessBlock();
+  template <MathQuality kQuality>
   void FilterStage(float in, float& out, TanhADAA& tanh_in,
                    TanhADAA& tanh_state, float g, float scale) const;
 
-  const juce::AudioBuffer<float>* env_buffer_;
-  const juce::AudioBuffer<float>& lfo_buffer_;
+  const ModulationBus& mod_bus_;
+  ModulationBus::Source env_source_;
+  MathQuality math_quality_;
+  // 2, 3 or 4
+  int num_stages_;
+  // ProcessBlock for math_quality_ and num_stages_
+  void (OTAFilterDelayedFeedback::*process_block_)(juce::AudioBuffer<float>&,
+                                                   int, int) =
+      &OTAFilterDelayedFeedback::ProcessBlock<MathQuality::kHigh, 4>;
   float sample_rate_;
   // integrator states
-  float s1_, s2_, s3_, s4_;
+  std::array<float, 4> s_;
   // dc blocker
   float dc_out_x1_, dc_out_y1_;
   // ADAA tanh
@@ -8,49 +8,44 @@ import std;
 
 namespace audio_plugin {
 OTAFilterTPTNewtonRaphson::OTAFilterTPTNewtonRaphson(
-    const juce::AudioBuffer<float>& env_buffer,
-    const juce::AudioBuffer<float>& lfo_buffer)
+    const ModulationBus& mod_bus)
     : cutoff_freq_{0.f},
       resonance_{0.f},
       drive_{0.f},
       env_mod_{0.f},
       lfo_mod_{0.f},
+      mod_bus_{mod_bus},
+      env_source_{ModulationBus::kEnv1},
+      math_quality_{MathQuality::kHigh},
       num_stages_{4},
-      env_buffer_{&env_buffer},
-      lfo_buffer_{lfo_buffer},
       sample_rate_{0},
-      s1_{0},
-      s2_{0},
-      s3_{0},
-      s4_{0} {}
-
-void OTAFilterTPTNewtonRaphson::Configure(
-    const juce::AudioProcessorValueTreeState& state) {
-  cutoff_freq_ = state.getRawParameterValue("filterCutoffFreq")->load();
-  resonance_ = state.getRawParameterValue("filterResonance")->load();
-  drive_ = state.getRawParameterValue("filterDrive")->load();
-  env_mod_ = state.getRawParameterValue("filterEnvMod")->load();
-  lfo_mod_ = state.getRawParameterValue("filterLfoMod")->load();
-  for (int i = 0; i < 4; ++i) {
+      s_{},
+      solutions_{} {}
+
+void OTAFilterTPTNewtonRaphson::Configure(const ParameterTable& params) {
+  cutoff_freq_ = params.Get(ParamId::kFilterCutoffFreq);
+  resonance_ = params.Get(ParamId::kFilterResonance);
+  drive_ = params.Get(ParamId::kFilterDrive);
+  env_mod_ = params.Get(ParamId::kFilterEnvMod);
+  lfo_mod_ = params.Get(ParamId::kFilterLfoMod);
+  for (int i = 0; i < kNumDriveScaleStages; ++i) {
     input_drive_scales_[static_cast<size_t>(i)] =
-        state.getRawParameterValue("filterInputDriveScale" + juce::String(i + 1))
-            ->load();
+        params.Get(FilterInputDriveScaleId(i));
     state_drive_scales_[static_cast<size_t>(i)] =
-        state.getRawParameterValue("filterStateDriveScale" + juce::String(i + 1))
-            ->load();
+        params.Get(FilterStateDriveScaleId(i));
   }
-  switch (static_cast<int>(state.getRawParameterValue("filterSlope")->load())) {
+  switch (params.GetInt(ParamId::kFilterSlope)) {
     case 0:
-      num_stages_ = 4;
+      set_num_stages(4);
       break;
     case 1:
-      num_stages_ = 3;
+      set_num_stages(3);
       break;
     case 2:
-      num_stages_ = 2;
+      set_num_stages(2);
       break;
     default:
-      num_stages_ = 4;
+      set_num_stages(4);
       break;
   }
 }
@@ -59,8 +54,17 @@ void OTAFilterTPTNewtonRaphson::set_sample_rate(const double rate) {
   sample_rate_ = static_cast<float>(rate);
 }
 
+float OTAFilterTPTNewtonRaphson::max_modulated_cutoff() const {
+  // as in ProcessSample, with the envelope at 1 and the LFO at whichever end
+  // raises the cutoff
+  return juce::jlimit(kMinCutoff, kMaxCutoff,
+                      cutoff_freq_ + std::max(env_mod_, 0.f) * kMaxCutoff +
+                          std::abs(lfo_mod_) * kMaxCutoff);
+}
+
 void OTAFilterTPTNewtonRaphson::Reset() {
-  s1_ = s2_ = s3_ = s4_ = 0;
+  s_ = {};
+  solutions_ = {};
   for (auto& t : tanh_stages_) {
     t.reset();
   }
@@ -69,154 +73,169 @@ void OTAFilterTPTNewtonRaphson::Reset() {
   }
 }
 
+template <MathQuality kQuality, std::size_t kNumStages>
 float OTAFilterTPTNewtonRaphson::EvaluateFilter(
     const float in, const float out_guess, const float G, const float k,
-    float& v1_out, float& v2_out, float& v3_out, float& v4_out,
-    const bool use_adaa) const {
-  // Input with feedback
-  const float u = in - k * out_guess;
-
-  // Each stage: y = s + G * (sat(x) - sat(s))
-  // where x is the input to the stage
-
-  const float drive1 = drive_ * input_drive_scales_[0];
-  const float state_drive1 = drive_ * state_drive_scales_[0];
-  const float v1_sat = use_adaa ? tanh_stages_[0].process(u / drive1) * drive1
-                                : std::tanh(u / drive1) * drive1;
-  const float s1_sat = use_adaa ? state_tanh_stages_[0].process(s1_ / state_drive1) * state_drive1
-                                : std::tanh(s1_ / state_drive1) * state_drive1;
-  const float y1 = s1_ + G * (v1_sat - s1_sat);
-  v1_out = y1;
-  if (num_stages_ == 1) return y1;
-
-  const float drive2 = drive_ * input_drive_scales_[1];
-  const float state_drive2 = drive_ * state_drive_scales_[1];
-  const float v2_sat = use_adaa ? tanh_stages_[1].process(y1 / drive2) * drive2
-                                : std::tanh(y1 / drive2) * drive2;
-  const float s2_sat = use_adaa ? state_tanh_stages_[1].process(s2_ / state_drive2) * state_drive2
-                                : std::tanh(s2_ / state_drive2) * state_drive2;
-  const float y2 = s2_ + G * (v2_sat - s2_sat);
-  v2_out = y2;
-  if (num_stages_ == 2) return y2;
-
-  const float drive3 = drive_ * input_drive_scales_[2];
-  const float state_drive3 = drive_ * state_drive_scales_[2];
-  const float v3_sat = use_adaa ? tanh_stages_[2].process(y2 / drive3) * drive3
-                                : std::tanh(y2 / drive3) * drive3;
-  const float s3_sat = use_adaa ? state_tanh_stages_[2].process(s3_ / state_drive3) * state_drive3
-                                : std::tanh(s3_ / state_drive3) * state_drive3;
-  const float y3 = s3_ + G * (v3_sat - s3_sat);
-  v3_out = y3;
-  if (num_stages_ == 3) return y3;
-
-  const float drive4 = drive_ * input_drive_scales_[3];
-  const float state_drive4 = drive_ * state_drive_scales_[3];
-  const float v4_sat = use_adaa ? tanh_stages_[3].process(y3 / drive4) * drive4
-                                : std::tanh(y3 / drive4) * drive4;
-  const float s4_sat = use_adaa ? state_tanh_stages_[3].process(s4_ / state_drive4) * state_drive4
-                                : std::tanh(s4_ / state_drive4) * state_drive4;
-  const float y4 = s4_ + G * (v4_sat - s4_sat);
-  v4_out = y4;
-
-  return y4;
+    const std::array<float, 4>& s_sat, float& d_out) const {
+  // Each stage: y = s + G * (sat(x) - sat(s)), where x is the input to the
+  // stage. s is constant with respect to out_guess, so dy/dx = G * sat'(x),
+  // chained through the stages from the feedback's d(x)/d(out_guess) = -k.
+  float x = in - k * out_guess;
+  float deriv = -k;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    const float drive = drive_ * input_drive_scales_[n];
+    const float sat = Tanh<kQuality>(x / drive);
+    deriv = G * (deriv * (1.0f - sat * sat));
+    x = s_[n] + G * (sat * drive - s_sat[n]);
+  }
+  d_out = deriv;
+  return x;
 }
 
-float OTAFilterTPTNewtonRaphson::ComputeJacobian(const float in,
-                                                 const float out_guess,
-                                                 const float G,
-                                                 const float k) const {
-  // the derivative of the entire filter chain with respect to out_guess
+template <MathQuality kQuality, std::size_t kNumStages>
+float OTAFilterTPTNewtonRaphson::EvaluateFilterADAA(
+    const float in, const float out, const float G, const float k,
+    std::array<float, 4>& v_out) {
+  float x = in - k * out;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    const float drive = drive_ * input_drive_scales_[n];
+    const float state_drive = drive_ * state_drive_scales_[n];
+    const float v_sat = tanh_stages_[n].process<kQuality>(x / drive) * drive;
+    const float s_sat =
+        state_tanh_stages_[n].process<kQuality>(s_[n] / state_drive) *
+        state_drive;
+    v_out[n] = s_[n] + G * (v_sat - s_sat);
+    x = v_out[n];
+  }
+  return x;
+}
 
-  // Start with feedback: d(u)/d(out_guess) = -k
-  float deriv = -k;
+template <MathQuality kQuality, std::size_t kNumStages>
+bool OTAFilterTPTNewtonRaphson::SolveLinear(const float in, const float G,
+                                            const float k, float& out) {
+  constexpr auto limit = kTanhLinearLimit<kQuality>;
+  // With tanh(x) = x each stage is y = G * x + (1 - G) * s, so the filter's
+  // output is a * x + b, x being the first stage's input, in - k * out.
+  float a = 1.0f;
+  float b = 0.0f;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    a = G * a;
+    b = G * b + (1.0f - G) * s_[n];
+  }
+  const float solution = (a * in + b) / (1.0f + k * a);
+
+  // The same steps as ProcessSample from here, with each tanh taken as
+  // linear, and checking each tanh's input is in range before going on.
+  float x = in - k * solution;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    const float drive = drive_ * input_drive_scales_[n];
+    const float state_drive = drive_ * state_drive_scales_[n];
+    if (!(std::abs(x / drive) < limit) ||
+        !(std::abs(s_[n] / state_drive) < limit)) {
+      return false;
+    }
+    x = s_[n] + G * (x - s_[n]);
+  }
+
+  // the final evaluation, through the ADAA stages
+  std::array<float, 4> v;
+  std::array<float, 4> v_in;
+  std::array<float, 4> s_in;
+  x = in - k * solution;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    const float drive = drive_ * input_drive_scales_[n];
+    const float state_drive = drive_ * state_drive_scales_[n];
+    v_in[n] = x / drive;
+    s_in[n] = s_[n] / state_drive;
+    const float v_previous = tanh_stages_[n].previous_input();
+    const float s_previous = state_tanh_stages_[n].previous_input();
+    if (!(std::abs(v_in[n]) < limit) || !(std::abs(v_previous) < limit) ||
+        !(std::abs(s_previous) < limit)) {
+      return false;
+    }
+    v[n] = s_[n] + G * (TanhADAA::process_linear(v_in[n], v_previous) * drive -
+                        TanhADAA::process_linear(s_in[n], s_previous) *
+                            state_drive);
+    x = v[n];
+  }
+  const float final_out = x;
+
+  // the state update
+  std::array<float, 4> s = s_;
+  x = in - k * final_out;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    const float drive = drive_ * input_drive_scales_[n];
+    if (!(std::abs(x / drive) < limit)) {
+      return false;
+    }
+    s[n] = s_[n] + 2.0f * G * (x - s_[n]);
+    x = v[n];
+  }
 
-  // Chain through each stage
-  // Each stage: y = s + G * (sat(x) - sat(s))
-  // dy/dx = G * d(sat(x))/dx
-  // (Note: s is constant with respect to out_guess, so d(sat(s))/dx = 0)
-
-  const float u = in - k * out_guess;
-
-  const float drive1 = drive_ * input_drive_scales_[0];
-  const float t1 = std::tanh(u / drive1);
-  const float d_sat1 = 1.0f - t1 * t1;
-  deriv = deriv * d_sat1;
-  const float v1_sat = t1 * drive1;
-  const float state_drive1 = drive_ * state_drive_scales_[0];
-  const float s1_sat = std::tanh(s1_ / state_drive1) * state_drive1;
-  const float y1 = s1_ + G * (v1_sat - s1_sat);
-  deriv = G * deriv;
-  if (num_stages_ == 1) return deriv;
-
-  const float drive2 = drive_ * input_drive_scales_[1];
-  const float t2 = std::tanh(y1 / drive2);
-  const float d_sat2 = 1.0f - t2 * t2;
-  deriv = deriv * d_sat2;
-  const float v2_sat = t2 * drive2;
-  const float state_drive2 = drive_ * state_drive_scales_[1];
-  const float s2_sat = std::tanh(s2_ / state_drive2) * state_drive2;
-  const float y2 = s2_ + G * (v2_sat - s2_sat);
-  deriv = G * deriv;
-  if (num_stages_ == 2) return deriv;
-
-  const float drive3 = drive_ * input_drive_scales_[2];
-  const float t3 = std::tanh(y2 / drive3);
-  const float d_sat3 = 1.0f - t3 * t3;
-  deriv = deriv * d_sat3;
-  const float v3_sat = t3 * drive3;
-  const float state_drive3 = drive_ * state_drive_scales_[2];
-  const float s3_sat = std::tanh(s3_ / state_drive3) * state_drive3;
-  const float y3 = s3_ + G * (v3_sat - s3_sat);
-  deriv = G * deriv;
-  if (num_stages_ == 3) return deriv;
-
-  const float drive4 = drive_ * input_drive_scales_[3];
-  const float t4 = std::tanh(y3 / drive4);
-  const float d_sat4 = 1.0f - t4 * t4;
-  deriv = deriv * d_sat4;
-  deriv = G * deriv;
-
-  return deriv;
+  s_ = s;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    tanh_stages_[n].set_previous_input(v_in[n]);
+    state_tanh_stages_[n].set_previous_input(s_in[n]);
+  }
+  solutions_ = {solution, solutions_[0], solutions_[1]};
+  ++solver_stats_.samples;
+  ++solver_stats_.linear_samples;
+  out = final_out;
+  return true;
 }
 
+template <MathQuality kQuality, std::size_t kNumStages>
 float OTAFilterTPTNewtonRaphson::ProcessSample(const float in, const int index) {
-  const auto env_data = env_buffer_->getReadPointer(0);
-  const auto lfo_data = lfo_buffer_.getReadPointer(0);
+  const auto env_data = mod_bus_.Read(env_source_);
+  const auto lfo_data = mod_bus_.Read(ModulationBus::kLfo);
   const float modulated_cutoff = juce::jlimit(
       kMinCutoff, kMaxCutoff,
-      cutoff_freq_ + env_mod_ * env_data[index / kOversample] * kMaxCutoff +
-          lfo_mod_ * lfo_data[index / kOversample] * kMaxCutoff);
+      cutoff_freq_ + env_mod_ * env_data[index] * kMaxCutoff +
+          lfo_mod_ * lfo_data[index] * kMaxCutoff);
 
   // Calculate TPT coefficient
-  const float g = std::tanf(juce::MathConstants<float>::pi * modulated_cutoff /
-                            sample_rate_);
-  const float g_clamped = std::min(g, 0.9f);
+  const float g = Tan<kQuality>(juce::MathConstants<float>::pi *
+                                modulated_cutoff / sample_rate_);
+  const float g_clamped = std::min(g, kMaxG);
   const float G = g_clamped / (1.0f + g_clamped);
 
   // Resonance feedback amount (scaled for 4-pole)
   const float k = std::clamp(resonance_, 0.0f, 0.99f) * 4.0f;
 
+  // quiet enough (for the drive) that no solving is needed
+  if (float out; SolveLinear<kQuality, kNumStages>(in, G, k, out)) {
+    return out;
+  }
+
+  // each stage's saturated state, which stays the same while solving and
+  // through the state update
+  std::array<float, 4> s_sat;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    const float state_drive = drive_ * state_drive_scales_[n];
+    s_sat[n] = Tanh<kQuality>(s_[n] / state_drive) * state_drive;
+  }
+
   // Newton-Raphson iteration to solve implicit equation
   // We're solving: out = F(input, out)
   // Or equivalently: out - F(input, out) = 0
 
-  float out_guess = 0;
-  switch (num_stages_) {
-    case 1: out_guess = s1_; break;
-    case 2: out_guess = s2_; break;
-    case 3: out_guess = s3_; break;
-    case 4: out_guess = s4_; break;
-    default: out_guess = s4_; break;
-  }
-  constexpr int max_iterations = 4;  // Usually converges in 2-3 iterations
+  // The solution moves smoothly from one (oversampled) sample to the next,
+  // so carrying on the curve through the last few lands much closer than
+  // any stage's state does.
+  float out_guess = WarmStart(solutions_);
+  constexpr int max_iterations = 4;
   constexpr float tolerance = 1e-6f;
-
-  float v1, v2, v3, v4;  // Stage outputs
+  // Newton-Raphson converges quadratically, so once a step is this small
+  // the residual after it is below tolerance and checking it is wasted work
+  constexpr float converged_step = 1e-3f;
 
   for (int iter = 0; iter < max_iterations; ++iter) {
-    // Evaluate what output would be for this guess
+    // Evaluate what output would be for this guess, and how it changes with
+    // the guess
+    float dF;
     const float predicted_out =
-        EvaluateFilter(in, out_guess, G, k, v1, v2, v3, v4);
+        EvaluateFilter<kQuality, kNumStages>(in, out_guess, G, k, s_sat, dF);
+    ++solver_stats_.iterations;
 
     // Residual: how far off is our prediction?
     // We want: out_guess = predicted_out
@@ -228,10 +247,8 @@ float OTAFilterTPTNewtonRaphson::ProcessSample(const float in, const int index)
       break;
     }
 
-    // Compute Jacobian (derivative)
     // J = d(out_guess - F(input, out_guess))/d(out_guess)
     //   = 1 - dF/d(out_guess)
-    const float dF = ComputeJacobian(in, out_guess, G, k);
     const float jacobian = 1.0f - dF;
 
     // Avoid division by zero
@@ -240,56 +257,90 @@ float OTAFilterTPTNewtonRaphson::ProcessSample(const float in, const int index)
     }
 
     // Newton-Raphson update
-    out_guess -= residual / jacobian;
+    const float step = residual / jacobian;
+    out_guess -= step;
 
     // Clamp to reasonable range to prevent divergence
     out_guess = std::clamp(out_guess, -10.0f, 10.0f);
+    if (std::abs(step) < converged_step) {
+      break;
+    }
   }
+  ++solver_stats_.samples;
+  solutions_ = {out_guess, solutions_[0], solutions_[1]};
 
   // Final evaluation with converged output
+  std::array<float, 4> v;
   const float final_out =
-      Sanitize(EvaluateFilter(in, out_guess, G, k, v1, v2, v3, v4, true));
+      Sanitize(EvaluateFilterADAA<kQuality, kNumStages>(in, out_guess, G, k, v));
 
   // Update states using the converged solution
   // State update: s_new = 2*y - s_old
   // In TPT with sat: s_new = s_old + 2 * G * (sat(x) - sat(s_old))
-  const float u = in - k * final_out;
-  const float drive1 = drive_ * input_drive_scales_[0];
-  const float state_drive1 = drive_ * state_drive_scales_[0];
-  const float v1_sat = std::tanh(u / drive1) * drive1;
-  const float s1_sat = std::tanh(s1_ / state_drive1) * state_drive1;
-  s1_ = Sanitize(s1_ + 2.0f * G * (v1_sat - s1_sat));
-  if (num_stages_ == 1) return final_out;
-
-  const float drive2 = drive_ * input_drive_scales_[1];
-  const float state_drive2 = drive_ * state_drive_scales_[1];
-  const float v2_sat = std::tanh(v1 / drive2) * drive2;
-  const float s2_sat = std::tanh(s2_ / state_drive2) * state_drive2;
-  s2_ = Sanitize(s2_ + 2.0f * G * (v2_sat - s2_sat));
-  if (num_stages_ == 2) return final_out;
-
-  const float drive3 = drive_ * input_drive_scales_[2];
-  const float state_drive3 = drive_ * state_drive_scales_[2];
-  const float v3_sat = std::tanh(v2 / drive3) * drive3;
-  const float s3_sat = std::tanh(s3_ / state_drive3) * state_drive3;
-  s3_ = Sanitize(s3_ + 2.0f * G * (v3_sat - s3_sat));
-  if (num_stages_ == 3) return final_out;
-
-  const float drive4 = drive_ * input_drive_scales_[3];
-  const float state_drive4 = drive_ * state_drive_scales_[3];
-  const float v4_sat = std::tanh(v3 / drive4) * drive4;
-  const float s4_sat = std::tanh(s4_ / state_drive4) * state_drive4;
-  s4_ = Sanitize(s4_ + 2.0f * G * (v4_sat - s4_sat));
+  float x = in - k * final_out;
+  for (std::size_t n = 0; n < kNumStages; ++n) {
+    const float drive = drive_ * input_drive_scales_[n];
+    const float v_sat = Tanh<kQuality>(x / drive) * drive;
+    s_[n] = Sanitize(s_[n] + 2.0f * G * (v_sat - s_sat[n]));
+    x = v[n];
+  }
 
   return final_out;
 }
 
+template <MathQuality kQuality, std::size_t kNumStages>
+void OTAFilterTPTNewtonRaphson::ProcessBlock(juce::AudioBuffer<float>& buffers,
+                                             const int start_sample,
+                                             const int numSamples) {
+  const auto data = buffers.getWritePointer(0);
+  for (auto i = start_sample; i < start_sample + numSamples; ++i) {
+    data[i] = ProcessSample<kQuality, kNumStages>(data[i], i);
+  }
+}
+
 void OTAFilterTPTNewtonRaphson::Process(juce::AudioBuffer<float>& buffers,
                                         const int start_sample,
                                         const int numSamples) {
-  const auto data = buffers.getWritePointer(0);
-  for (auto i = start_sample; i < start_sample + numSamples; ++i) {
-    data[i] = ProcessSample(data[i], i);
+  (this->*process_block_)(buffers, start_sample, numSamples);
+}
+
+void OTAFilterTPTNewtonRaphson::set_math_quality(
+    const MathQuality math_quality) {
+  math_quality_ = math_quality;
+  SelectProcessBlock();
+}
+
+void OTAFilterTPTNewtonRaphson::set_num_stages(const int num_stages) {
+  num_stages_ = num_stages == 2 || num_stages == 3 ? num_stages : 4;
+  SelectProcessBlock();
+}
+
+void OTAFilterTPTNewtonRaphson::SelectProcessBlock() {
+  switch (math_quality_) {
+    case MathQuality::kFast:
+      SelectProcessBlock<MathQuality::kFast>();
+      break;
+    case MathQuality::kHigh:
+      SelectProcessBlock<MathQuality::kHigh>();
+      break;
+    case MathQuality::kExact:
+      SelectProcessBlock<MathQuality::kExact>();
+      break;
+  }
+}
+
+template <MathQuality kQuality>
+void OTAFilterTPTNewtonRaphson::SelectProcessBlock() {
+  switch (num_stages_) {
+    case 2:
+      process_block_ = &OTAFilterTPTNewtonRaphson::ProcessBlock<kQuality, 2>;
+      break;
+    case 3:
+      process_block_ = &OTAFilterTPTNewtonRaphson::ProcessBlock<kQuality, 3>;
+      break;
+    default:
+      process_block_ = &OTAFilterTPTNewtonRaphson::ProcessBlock<kQuality, 4>;
+      break;
   }
 }
 
@@ -2,6 +2,9 @@
 import JuceImports;
 import std;
 
+#include "../Parameters.h"
+#include "../dsp/FastMath.h"
+#include "../dsp/ModulationBus.h"
 #include "../dsp/TanhADAA.h"
 
 namespace audio_plugin {
@@ -15,8 +18,11 @@ namespace audio_plugin {
  */
 class OTAFilterTPTNewtonRaphson {
  public:
-  OTAFilterTPTNewtonRaphson(const juce::AudioBuffer<float>& env_buffer,
-                            const juce::AudioBuffer<float>& lfo_buffer);
+  /**
+   * @param mod_bus the voice's modulation sources, read at the oversampled
+   * rate
+   */
+  OTAFilterTPTNewtonRaphson(const ModulationBus& mod_bus);
   /**
    * Perform in place filtering on the left channel only,
    * for numSamples samples.
@@ -24,14 +30,33 @@ class OTAFilterTPTNewtonRaphson {
   void Process(juce::AudioBuffer<float>& buffers, int start_sample,
                int numSamples);
 
-  void set_env_buffer(const juce::AudioBuffer<float>& env_buffer) {
-    env_buffer_ = &env_buffer;
+  // which envelope modulates the cutoff
+  void set_env_source(const ModulationBus::Source env_source) {
+    env_source_ = env_source;
   }
 
+  // accuracy of the tanh / tan approximations
+  void set_math_quality(MathQuality math_quality);
+
+  // 2, 3 or 4, for -12 / -18 / -24 dB. Anything else is 4.
+  void set_num_stages(int num_stages);
+
+  // Newton-Raphson work done since the last reset_solver_stats
+  struct SolverStats {
+    // samples solved
+    std::uint64_t samples = 0;
+    // filter evaluations (Newton-Raphson iterations) over them
+    std::uint64_t iterations = 0;
+    // of the samples, those solved in closed form (see SolveLinear)
+    std::uint64_t linear_samples = 0;
+  };
+  const SolverStats& solver_stats() const { return solver_stats_; }
+  void reset_solver_stats() { solver_stats_ = {}; }
+
   /**
    * Update params based on current state
    */
-  void Configure(const juce::AudioProcessorValueTreeState& state);
+  void Configure(const ParameterTable& params);
 
   /**
    * Reset for next note
@@ -39,37 +64,87 @@ class OTAFilterTPTNewtonRaphson {
   void Reset();
   void set_sample_rate(double rate);
 
+  // tan(pi * cutoff / sample rate) is clamped to this to keep the solve
+  // stable near nyquist, which caps the cutoff (see HighestCutoff)
+  static constexpr float kMaxG = 0.9f;
+  // the highest cutoff the filter reaches at sample_rate, about
+  // 0.23 * sample_rate
+  static double HighestCutoff(const double sample_rate) {
+    return sample_rate * std::atan(static_cast<double>(kMaxG)) /
+           std::numbers::pi;
+  }
+  // the highest the envelope and LFO can take the cutoff to
+  float max_modulated_cutoff() const;
+
   float cutoff_freq_;
   float resonance_;
   // value of zero disables the distortion
   float drive_;
   float env_mod_;
   float lfo_mod_;
-  int num_stages_;
   std::array<float, 4> input_drive_scales_;
   std::array<float, 4> state_drive_scales_;
 
  private:
-  float ProcessSample(float in, int index);
+  // runs these filters a voice per lane, on their own state
+  friend class OTAFilterBank;
 
+  // Each MathQuality and number of stages has its own ProcessBlock, so the
+  // loops over the stages unroll.
+  template <MathQuality kQuality, std::size_t kNumStages>
+  void ProcessBlock(juce::AudioBuffer<float>& buffers, int start_sample,
+                    int numSamples);
+  template <MathQuality kQuality, std::size_t kNumStages>
+  float ProcessSample(float in, int index);
+  // point process_block_ at the ProcessBlock for math_quality_ and
+  // num_stages_
+  void SelectProcessBlock();
+  template <MathQuality kQuality>
+  void SelectProcessBlock();
+  // If every tanh the sample goes through stays within kTanhLinearLimit, the
+  // filter is linear as far as kQuality can tell, and the sample has a
+  // closed form solution: filter it that way into out and return true.
+  // Otherwise change nothing and return false.
+  template <MathQuality kQuality, std::size_t kNumStages>
+  bool SolveLinear(float in, float G, float k, float& out);
   // Evaluate filter for a given output guess.
-  // Returns what the output would be if the actual output were 'out_guess'
+  // Returns what the output would be if the actual output were 'out_guess',
+  // and in d_out how much changing the guess changes that (d(output) /
+  // d(out_guess)). s_sat is each stage's saturated state.
+  template <MathQuality kQuality, std::size_t kNumStages>
   float EvaluateFilter(float in, float out_guess, float G, float k,
-    float& v1_out, float& v2_out, float& v3_out, float& v4_out, bool use_adaa = false) const;
-  // Compute derivative for newton raphson
-  // d(output)/d(out_guess) = how much does changing our guess change the predicted output?
-  float ComputeJacobian(float in, float out_guess, float G, float k) const;
+                       const std::array<float, 4>& s_sat, float& d_out) const;
+  // Evaluate filter for the solved output, with ADAA on the saturation.
+  // Advances the ADAA history. Each stage's output goes in v_out.
+  template <MathQuality kQuality, std::size_t kNumStages>
+  float EvaluateFilterADAA(float in, float out, float G, float k,
+                           std::array<float, 4>& v_out);
+  // first guess for the solve, carrying on the parabola through the last
+  // three solutions (latest first)
+  static float WarmStart(const std::array<float, 3>& solutions) {
+    return std::clamp(3.0f * (solutions[0] - solutions[1]) + solutions[2],
+                      -10.0f, 10.0f);
+  }
 
-  const juce::AudioBuffer<float>* env_buffer_;
-  const juce::AudioBuffer<float>& lfo_buffer_;
+  const ModulationBus& mod_bus_;
+  ModulationBus::Source env_source_;
+  MathQuality math_quality_;
+  // 2, 3 or 4
+  int num_stages_;
+  // ProcessBlock for math_quality_ and num_stages_
+  void (OTAFilterTPTNewtonRaphson::*process_block_)(juce::AudioBuffer<float>&,
+                                                    int, int) =
+      &OTAFilterTPTNewtonRaphson::ProcessBlock<MathQuality::kHigh, 4>;
   float sample_rate_;
   // state vars for each stage
-  float s1_, s2_, s3_, s4_;
+  std::array<float, 4> s_;
+  // the last three samples' solved outputs, latest first
+  std::array<float, 3> solutions_;
+  SolverStats solver_stats_;
   // Tanh ADAA for each stage's input
-  // todo: should these really have mutable keyword?
-  mutable std::array<TanhADAA, 4> tanh_stages_;
+  std::array<TanhADAA, 4> tanh_stages_;
   // Tanh ADAA for each stage's state
-  mutable std::array<TanhADAA, 4> state_tanh_stages_;
+  std::array<TanhADAA, 4> state_tanh_stages_;
   // dc blocker
   // todo: convert all my DC blockers to juse use juce builtin filters
   //todo float dc_out_x1_, dc_out_y1_;
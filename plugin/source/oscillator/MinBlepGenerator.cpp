@@ -14,59 +14,8 @@ import std;
 
 namespace audio_plugin {
 
-// STATIC ARRAYS - to house the minBlep and integral of the minBlep ...
-// this array is used to handle POSITION discontinuities - 0th order - i.e. step response
-static juce::Array<float> minBlepArray;
-// this array is used to handle VELOCITY discontinuities - 1st order (effectively, BLAMP) i.e. ramp response.
-// note that "deriv" refers to the fact that it CORRRECTS the derivative - it is not itself a derivative.
-// In fact, it's actually the second integral of the minimum-phase impulse.
-// This may as well have been called the blampArray.
-static juce::Array<float> minBlepDerivArray;
-
-// Helper: dump a numeric buffer to a CSV file in the user's Documents folder
-static void dumpArrayToCsv(const juce::Array<double>& buffer, const juce::String& fileName)
-{
-  juce::File outFile = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
-                            .getChildFile(fileName);
-  std::ofstream csv(outFile.getFullPathName().toStdString(), std::ios::out | std::ios::trunc);
-  if (!csv.is_open())
-    return;
-
-  csv << "index,value\n";
-  const int count = buffer.size();
-  for (int i = 0; i < count; ++i)
-  {
-    csv << i << "," << buffer.getUnchecked(i) << "\n";
-  }
-  csv.flush();
-}
-
-// todo use template to dedupe
-static void dumpArrayToCsv(const juce::Array<float>& buffer, const juce::String& fileName)
-{
-  juce::File outFile = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
-                            .getChildFile(fileName);
-  std::ofstream csv(outFile.getFullPathName().toStdString(), std::ios::out | std::ios::trunc);
-  if (!csv.is_open())
-    return;
-
-  csv << "index,value\n";
-  const int count = buffer.size();
-  for (int i = 0; i < count; ++i)
-  {
-    csv << i << "," << buffer.getUnchecked(i) << "\n";
-  }
-  csv.flush();
-}
-
 MinBlepGenerator::MinBlepGenerator() {
-  over_sampling_ratio_ = 16;
-  zero_crossings_ = 16;
   return_derivative_ = false;
-  proportional_blep_freq_ = 0.5;  // defaults to NyQuist ....
-
-  last_value_ = 0;
-  last_delta_ = 0;
 
   // AA FILTER
   juce::zeromem(coefficients_, sizeof(coefficients_));
@@ -79,443 +28,109 @@ MinBlepGenerator::MinBlepGenerator() {
 
   CreateLowPass(ratio_);
   ResetFilters();
-
-  BuildBlep();
 }
 MinBlepGenerator::~MinBlepGenerator() {
   //
 }
 
-void MinBlepGenerator::set_limiting_freq(float proportionOfSamplingRate) {
-  //
-  // Instead of limiting to the sampling F,
-  // We bring the maximum allowable F down to some known quantity
-  // Doing this we can "tune" the blep to some desired F
-  // So .... making wave-generators better ....
-
-  // SINCE the buffer is only resized to 8x, we can only use blep adjustments
-  // down to 0.125
-  proportionOfSamplingRate =
-      juce::jlimit<float>(0.0001f, 1.0f, proportionOfSamplingRate);
-  proportional_blep_freq_ = static_cast<double>(proportionOfSamplingRate);
+void MinBlepGenerator::SelectTable(const double freq_ratio) {
+  const auto it = std::ranges::upper_bound(kMaxFreqRatios, freq_ratio);
+  table_ = &kMinBlepTables[static_cast<std::size_t>(
+      std::distance(kMaxFreqRatios.begin(), it))];
 }
 
-juce::Array<float> MinBlepGenerator::min_blep_array() {
-  return minBlepArray;
-}
-juce::Array<float> MinBlepGenerator::min_blep_deriv_array() {
-  return minBlepDerivArray;
+void MinBlepGenerator::Prepare(const int max_block_size) {
+  jassert(max_block_size > 0);
+
+  // longest a blep can be, in output samples (+1 for the partial sample at
+  // the start)
+  const auto max_blep_samples = kMinBlepTables.back().length + 1;
+  // a blep can start on the last sample of a block, so the ring has to cover
+  // a whole block plus the longest blep
+  const auto size = juce::nextPowerOfTwo(max_block_size + max_blep_samples);
+  residual_.assign(static_cast<std::size_t>(size), 0.f);
+  residual_mask_ = size - 1;
+  read_index_ = 0;
+  pending_samples_ = 0;
 }
 
 void MinBlepGenerator::Clear() {
-  jassert(currentActiveBlepOffsets.size() == 0);
-
-  currentActiveBlepOffsets.clear();
+  std::ranges::fill(residual_, 0.f);
+  pending_samples_ = 0;
 }
 bool MinBlepGenerator::IsClear() const {
-  return currentActiveBlepOffsets.isEmpty();
+  return pending_samples_ == 0;
 }
 
-// todo below calculation seems sus - there is more straightforward impl in cardinal
-//  that we could try to use instead. The generated minBlepArray doesn't seem right - values
-//  are WAY too big. Could be rounding or precision error caused by my changes?
-
-
-// MIN BLEP - freq domain calc
-void MinBlepGenerator::BuildBlep() const {
-  // ALREADY built - so return ...
-  if (minBlepArray.size() > 0)
-    return;
-
-  // BUILD the BLEP
-  int i;
-  juce::Array<double> buffer1;
-
-  const auto n = static_cast<int>(zero_crossings_ * 2 * over_sampling_ratio_);
-
-  DBG("BUILD minBLEP - ratio " + juce::String(over_sampling_ratio_) + " -> " +
-      juce::String(n));
-
-  // Generate symmetric sinc array with specified number of
-  // zero crossings on each side
-  for (i = 0; i < n; i++) {
-    // rescale from 0 - n-1 to -zeroCrossing to zeroCrossing
-    const auto p = static_cast<float>(i) / static_cast<float>(n - 1)
-      * ((static_cast<float>(zero_crossings_)*2)) - static_cast<float>(zero_crossings_);
-    buffer1.add(Sinc(static_cast<double>(p)));
-  }
-
-  jassert(buffer1.size() == static_cast<int>(n));
-
-  dumpArrayToCsv(buffer1, "sinc.csv");
-
-  // Window Sinc
-  ApplyBlackmanHarrisWindow(n, buffer1.getRawDataPointer());
-
-  dumpArrayToCsv(buffer1, "blackman.csv");
-
-  // Minimum Phase Reconstruction
-  RealCepstrum(static_cast<size_t>(n), buffer1.getRawDataPointer());
-  dumpArrayToCsv(buffer1, "cepstrum.csv");
-  MinimumPhase(static_cast<size_t>(n), buffer1.getRawDataPointer());
-
-  dumpArrayToCsv(buffer1, "minphase.csv");
-
-  // Integrate Into MinBLEP and BLAMP lookups
-  minBlepArray.ensureStorageAllocated(static_cast<int>(n));
-  minBlepDerivArray.ensureStorageAllocated(static_cast<int>(n));
-
-  double a = 0;
-  double secondInt = 0;
-  for (i = 0; i < n; i++) {
-    a += buffer1[static_cast<int>(i)];  // full integral ... so that we can normalize (make area=1)
-    minBlepArray.add(static_cast<float>(a));
-
-    // 2ND ORDER ::::
-    secondInt += a;
-    minBlepDerivArray.add(static_cast<float>(secondInt));
+void MinBlepGenerator::AddBlep(const BlepOffset& newBlep) {
+  jassert(newBlep.offset <= 0);
+  jassert(!residual_.empty());
+
+  // remember offset will be negative when the blep occurred this buffer and
+  // the magnitude (ignoring the sign) is the index it occurred at.
+  // The correction is mixed in starting on the LOW SAMPLE (hence the +1),
+  // i.e. the first sample at which (offset + sample + 1) >= 0.
+  const auto first_sample =
+      std::max(0, static_cast<int>(std::ceil(-newBlep.offset - 1)));
+  // the table is oversampled, so rather than lerping between table samples
+  // the blep is placed to the nearest table sample (phase) and the table is
+  // then stepped through a whole output sample at a time
+  const auto first_index = static_cast<int>(
+      std::lround((newBlep.offset + first_sample + 1) *
+                  kMinBlepOverSamplingRatio));
+
+  // 0TH ORDER (POSITION DISCONTINUITY) COMPENSATION ::::
+  if (std::abs(newBlep.pos_change_magnitude) > 0) {
+    AddKernel(table_->step, newBlep.pos_change_magnitude, first_sample,
+              first_index);
   }
 
-  dumpArrayToCsv(minBlepArray, "minbleparr.csv");
-  dumpArrayToCsv(minBlepDerivArray, "minblepDevarr.csv");
-
-  // Normalize
-  double maxVal = static_cast<double>(minBlepArray.getUnchecked(static_cast<int>(n - 1)));
-  juce::FloatVectorOperations::multiply(minBlepArray.getRawDataPointer(),
-                                  static_cast<float>(1.0 / maxVal), n);
-
-  // Normalize ...
-  float max = juce::FloatVectorOperations::findMaximum(
-      minBlepDerivArray.getRawDataPointer(), n);
-  // todo assert fails - problem?
-  //jassert(fabs(static_cast<double>(max - minBlepDerivArray.getLast())) < 0.0001);
-  juce::FloatVectorOperations::multiply(minBlepDerivArray.getRawDataPointer(),
-                                  1.0f / max, minBlepDerivArray.size());
-
-  for (double ramp = 0; ramp < static_cast<double>(n); ramp++) {
-    // 2ND ORDER ::::
-    // todo not sure what this does, but falling saw doesnt even use 2nd order corrections
-    minBlepDerivArray.getRawDataPointer()[static_cast<int>(ramp)] -=
-        static_cast<float>(ramp / static_cast<double>(n - 1));
+  // 1ST ORDER COMPENSATION ::::
+  /// add the BLEP DERIVATIVE to compensate for discontinuties in the
+  /// VELOCITY - this is BLAMP basically.
+  if (std::abs(newBlep.vel_change_magnitude) > 0) {
+    AddKernel(table_->ramp, newBlep.vel_change_magnitude, first_sample,
+              first_index);
   }
-
-  // todo assert fails here - problem?
-  //jassert(fabsf(minBlepDerivArray[0]) < 0.01f);
-  // todo assert here fails - problem?
-  //jassert(fabsf(minBlepDerivArray[static_cast<int>(n - 1)]) < 0.01f);
-
-  // SUBTRACT 1 and invert so the signal (so it goes 1->0)
-  juce::FloatVectorOperations::add(minBlepArray.getRawDataPointer(), -1.f,
-                             minBlepArray.size());
-  juce::FloatVectorOperations::multiply(minBlepArray.getRawDataPointer(), -1.f,
-                                  minBlepArray.size());
-
-  jassert(fabsf(minBlepArray[static_cast<int>(n)]) < 0.001f);
-
-  dumpArrayToCsv(minBlepArray, "minbleparrNormSub.csv");
-  dumpArrayToCsv(minBlepDerivArray, "minblepDevarrNormSub.csv");
-}
-
-void MinBlepGenerator::AddBlep(BlepOffset newBlep) {
-  jassert(newBlep.offset <= 0);
-
-  newBlep.freqMultiple = over_sampling_ratio_ * proportional_blep_freq_;
-  currentActiveBlepOffsets.add(newBlep);
-}
-
-void MinBlepGenerator::AddBlepArray(const juce::Array<BlepOffset>& newBleps) {
-  currentActiveBlepOffsets.addArray(newBleps, 0, newBleps.size());
 }
 
-juce::Array<MinBlepGenerator::BlepOffset> MinBlepGenerator::GetNextBleps() {
-  juce::Array<MinBlepGenerator::BlepOffset> newBleps;
-  newBleps.addArray(currentActiveBlepOffsets, 0,
-                    currentActiveBlepOffsets.size());
-
-  jassert(newBleps.size() == currentActiveBlepOffsets.size());
+void MinBlepGenerator::AddKernel(const std::span<const float> kernel,
+                                 const double magnitude,
+                                 const int first_sample,
+                                 const int first_index) {
+  const auto table_size = static_cast<int>(kernel.size());
+  const auto scale = static_cast<float>(magnitude);
 
-  // CLEAR the array ...
-  currentActiveBlepOffsets.clearQuick();
+  auto sample = first_sample;
+  for (auto index = first_index; index < table_size;
+       index += kMinBlepOverSamplingRatio, ++sample) {
+    residual_[static_cast<std::size_t>((read_index_ + sample) &
+                                       residual_mask_)] +=
+        kernel[static_cast<std::size_t>(index)] * scale;
+  }
 
-  return newBleps;
+  pending_samples_ = std::max(pending_samples_, sample);
+  jassert(pending_samples_ <= static_cast<int>(residual_.size()));
 }
 
 // REAL TIME ::::: the core functions :::::
-void MinBlepGenerator::ProcessBlock(float* buffer, int numSamples) {
-  // look for non-linearities ....
+void MinBlepGenerator::ProcessBlock(float* buffer, const int numSamples) {
   jassert(numSamples > 0);
 
-  // NON-LINEARITIES :::::
-  // This is for processing detected nonlinearities about which we ONLY know the
-  // POSITION process_nonlinearities(buffer, numSamples, nonlinearities);
-
-  // GRAB the final value ....
-  // just in case there is a nonlinearity at sample 0 of the next block ...
-  // MUST be done BEFORE we ADD the bleps
-  last_value_ = buffer[numSamples - 1];
-
-  // todo: what is this even and do we even care?
-  // Hmmm .... once in a while there is a nonlinearity at the edge ....
-  // inwhich case, we probably shouldn't update the delta ...
-  if (static_cast<int>(currentActiveBlepOffsets.getLast().offset) != -(numSamples - 1)) {
-    last_delta_ = buffer[numSamples - 1] - buffer[numSamples - 2];
-  } else  // hacky .... hmmm ...
-  {
-    last_delta_ = buffer[numSamples - 2] - buffer[numSamples - 3];
+  // only the part of the ring that bleps have reached needs to be touched -
+  // the rest is already zero
+  const auto num_pending = std::min(numSamples, pending_samples_);
+  for (int i = 0; i < num_pending; ++i) {
+    auto& residual =
+        residual_[static_cast<std::size_t>((read_index_ + i) & residual_mask_)];
+    buffer[i] += residual;
+    residual = 0;
   }
 
-  // PROCESS BLEPS :::::
-  ProcessCurrentBleps(buffer, numSamples);
-}
-
-void MinBlepGenerator::RescaleBlepsToBuffer(const float* buffer,
-                                               const int numSamples,
-                                               const float shiftBlepsBy) {
-  // MUST be big enough to hold the entire wave after all ... and safety factor
-  // of 2
-  jassert(currentActiveBlepOffsets.size() < 1000);
-
-  for (int i = currentActiveBlepOffsets.size(); --i >= 0;) {
-    // confusingly, the nonlinearities actually occued 1 sample BEFORE the
-    // number we get this is because the detector detects that one JUST OCCURED,
-    // and then adds it with the fractional offset from the last sample
-    BlepOffset blep = currentActiveBlepOffsets.getUnchecked(i);  // ie 101.2
-
-    // SCALE FREQ (to this bleps prop freq)
-    blep.freqMultiple = over_sampling_ratio_ * proportional_blep_freq_;
-
-    // MODIFY :::: the exact offset ...
-    // since this is an effect ... it manifests 1 sample later than the
-    // discontinuity
-    float exactOffset =
-        static_cast<float>(-blep.offset + static_cast<double>(shiftBlepsBy));  // +1 here is NEEDED for flanger/chorus !!
-    blep.offset =
-        blep.offset -
-        static_cast<double>(shiftBlepsBy);  // starts compensating on the sample AFTER the blep ....
-
-    // ACTIVE blep .... (not upcoming)
-    if (exactOffset < 0)
-      continue;
-
-    // CHECK :::: further away than 1 buffer ... should never happen
-    if (exactOffset > static_cast<float>(numSamples)) {
-      // LFOs have nonlinearities that affect the audio 1 sample later
-      // ... so we can get edge cases here ....
-      // simply roll it over to the next buffer ...
-      DBG("OUT OF RANGE NONLINEARITY ??? " + juce::String(exactOffset));
-      blep.offset = static_cast<double>(exactOffset - static_cast<float>(numSamples));
-      currentActiveBlepOffsets.setUnchecked(i, blep);
-      continue;
-    }
-
-    // CALCULATE the MAGNITUDE of the nonlinearity
-    float magnitude_position = 0;
-    float magnitude_velocity = 0;
-    {
-      float currentDelta = 0;
-      // CALCULATE the integer (sample) offset, and the fractional (subsample)
-      // offset
-      double intOffset = static_cast<int>(exactOffset);
-      double fraction = modf(static_cast<double>(exactOffset), &intOffset);
-
-      // UNLESS we're on the edge case, we get the most recent value from the
-      // buffer ...
-      if (intOffset > 0)
-        last_value_ = buffer[static_cast<int>(intOffset) - 1];
-
-      // 1st order (velocity)
-      // MUST do this one first - since the 0th order may change the LastValue
-      {
-        // FIND the last and next deltas ... and compute the difference ....
-        if (intOffset >= 2)
-          last_delta_ = buffer[static_cast<int>(intOffset) - 1] - buffer[static_cast<int>(intOffset) - 2];
-        else if (intOffset >= 1)
-          last_delta_ = buffer[static_cast<int>(intOffset) - 1] - last_value_;
-
-        // DEFAULT :: assume flat ...
-        currentDelta = 0;
-
-        if (intOffset + 1 < numSamples)
-          currentDelta = buffer[static_cast<int>(intOffset) + 1] - buffer[static_cast<int>(intOffset)];
-
-        // CALCULATE change in velocity
-        double change_in_delta = static_cast<double>(currentDelta - last_delta_);
-        double propDepth = proportional_blep_freq_;
-
-        // magnitude_velocity = -4*change_in_delta*(1/propDepth);
-        // jassert(magnitude_velocity <= 1);
-
-        // actualCurrentAngleDelta below is added to compensate for higher order
-        // nonlinearities 66 here was experimentally determined ...
-        magnitude_velocity =
-            static_cast<float>(64.7 * change_in_delta * (1 / propDepth) * change_in_delta);
-      }
-
-      // 0th order (position)
-      {
-        // CALCULATE the magnitude of the 0 order nonlinearity *change in
-        // position*
-        float extrapolated_last_pos = static_cast<float>(static_cast<double>(last_value_ + last_delta_) * fraction);
-        float extrapolated_jump_pos =
-            static_cast<float>(static_cast<double>(buffer[static_cast<int>(intOffset)] - currentDelta) * (1 - fraction));
-        magnitude_position = extrapolated_last_pos - extrapolated_jump_pos;
-      }
-    }
-
-    // TOO SMALL :::
-    /// no need to compensating for tiny discontinuities
-    if (fabsf(magnitude_position) < .001f && fabsf(magnitude_velocity) < .001f) {
-      currentActiveBlepOffsets.remove(i);
-      continue;
-    }
-
-    // NEGLIGIBLE MAGNITUDES :::
-    /// zero out any tiny effects here, so we don't waste time calculating them
-    if (fabsf(magnitude_position) < .001f)
-      magnitude_position = 0;
-    if (fabsf(magnitude_velocity) < .001f)
-      magnitude_velocity = 0;
-
-    // ADD ::::
-    // GAIN factors ... how big of a discontinutiy are we talking about ?
-    blep.pos_change_magnitude = static_cast<double>(magnitude_position);
-    blep.vel_change_magnitude = static_cast<double>(magnitude_velocity);
-
-    // ALTER :::
-    currentActiveBlepOffsets.setUnchecked(i, blep);
-  }
-}
-
-/**
- * Applies a correction, looked up from the appropriate blep or blamp
- * correction table (oversampled), at a specified index + subsample within
- * that table, using lerp to interp between the samples of the correction table.
- * The correction is added to the given outputSampleIdx within outputBuffer.
- */
-static void lerpCorrection(float* outputBuffer,
-  const juce::Array<float>& correctionTable,
-  const int correctionSample, const double correctionSubSample,
-  const double discontinuityMagnitude,
-  const int outputSampleIdx) {
-  // We have the subsample within the blep table, not just the sample, so we'll use that with linear interpolation
-  // to ensure we get an even more accuracte blep value to mix in.
-  const float blepSampleBefore = correctionTable.getRawDataPointer()[correctionSample];
-  float blepSampleAfter = blepSampleBefore;
-
-  if (static_cast<int>(correctionSample) + 1 < correctionTable.size())
-    blepSampleAfter = correctionTable.getRawDataPointer()[static_cast<int>(correctionSample) + 1];
-
-  const float delta = blepSampleAfter - blepSampleBefore;
-  float exactValue = static_cast<float>(static_cast<double>(blepSampleBefore) + correctionSubSample * static_cast<double>(delta));
-
-  // SCALE by the discontinuity magnitude
-  exactValue *= static_cast<float>(discontinuityMagnitude);
-
-  // ADD to the thruput
-  outputBuffer[static_cast<int>(outputSampleIdx)] += exactValue;
-}
-
-// TODO: this approach was what I originally copied and does work, but
-//  I think a much more efficient approach would not actively track "ongoing bleps.".
-//  Instead, we would use a ring buffer sized 2x the length of the blep signal.
-//  When a blep is detected, it would simply be scaled _and added to the ring buffer_
-//  When the buffer advances, it would zero out the "old" part of the buffer being expanded to.
-//  This way, rather than constantly track bleps, we simply accumulate everything in a buffer and
-//  Ultimately add that buffer to the signal. Note it has to deal with both scaling and frequency correction.
-//  But frequency should have a lower bound as below that bound we no longer have aliasing, and
-//  higher frequency only makes the signal shorter, so we can definitely size the ring buffer
-//  so that it will accommodate the longest possible blep.
-void MinBlepGenerator::ProcessCurrentBleps(float* buffer, int numSamples) {
-  // PROCESS ALL BLEPS -
-  /// for each offset, mix a portion of the blep array with the output ....
-  for (int i = currentActiveBlepOffsets.size(); --i >= 0;) {
-    BlepOffset blep = currentActiveBlepOffsets[i];
-
-    // this determines how fast we step through the (oversampled) blep table
-    // per output sample - it scales output samples into kernel samples (the blep table is the kernel)
-    const double freqMultiple = blep.freqMultiple;
-    // remember this will be negative when the blep occurred this buffer (as opposed to a recent previous buffer)
-    // and the magnitude (ignoring the negative sign) is the index it occurred at in this buffer.
-    const double exactBlepOffset = blep.offset;
-
-    // mix the minBLEP table into the buffer at the point where the blep occurs
-    // within the current buffer.
-    // To do this, we first have to step through the current buffer until we reach a point
-    // where the blep has occurred (which will already be true if the blep happened in a recent previous
-    // buffer).
-    for (float p = 0; p < static_cast<float>(numSamples); p++) {
-
-      // figure out how many output samples (p) have transpired
-      // since the blep - this will be negative if we haven't yet reached the blep.
-      // +1 because the blep needs to be mixed in starting on the LOW SAMPLE
-      const auto outputSamplesSinceBlep = exactBlepOffset + static_cast<double>(p) + 1;
-
-      // by scaling by freqMultiple, we convert to a lookup on the blep table (which is oversampled).
-      // Think of it as a "blep sample".
-      // It's a double because we also preserve the fractional part (subsample).
-      // Again, this number is negative and basically meaningless if we haven't yet reached the blep
-      // todo we shouldn't even bother to calculate until we've passed the blep
-      const double currentBlepTableSampleExact = freqMultiple * outputSamplesSinceBlep;
-      double currentBlepTableSample = 0;
-      // the fractional part of the "blep sample" we need.
-      const double currentBlepTableSubSample = modf(currentBlepTableSampleExact, &currentBlepTableSample);
-
-      // LIMIT the correction applied for velocity discontinuity
-      // otherwise, it can get TOO large (for example at high freqs) and ends up over-correcting.
-      // This limiting is done by reducing how fast we advance through the BLAMP table - adjusting
-      // the scaling factor that converts from output sample idx to blamp lookup idx.
-      const double depthLimited =
-          proportional_blep_freq_;  // jlimit<double>(.1, 1, proportionalBlepFreq);
-      const double currentBlepDerivTableSampleExact =
-          depthLimited * over_sampling_ratio_ * (exactBlepOffset + static_cast<double>(p) + 1);
-      double currentBlepDerivTableSample = 0;
-      const double currentBlepDerivTableSubSample = modf(currentBlepDerivTableSampleExact, &currentBlepDerivTableSample);
-
-      // DONE ... we reached the place where this blep should end (which may be after multiple bufferfulls
-      // of applying the blep)
-      if (static_cast<int>(currentBlepTableSampleExact) > minBlepArray.size() &&
-          static_cast<int>(currentBlepDerivTableSampleExact) > minBlepArray.size())
-        break;
-
-      // BLEP has not yet occurred ...
-      if (currentBlepTableSampleExact < 0)
-        continue;
-
-      // 0TH ORDER (POSITION DISCONTINUITY) COMPENSATION ::::
-      // we reached the location of this blep or we are somewhere after it
-      // We need to mix in the corresponding value in the blep table. E.g.
-      // if blep occurred 3 samples ago we should mix in sample 3 of the blep table.
-      // But that's not quite the case - the blep table is oversampled, so we need to
-      // convert the index to one on the blep table (using the subsample information we preserved about the blep).
-      // We also don't want to mix the blep in at its full value - we scale the blep based on how big the
-      // original blep discontinuity was.
-      if (fabs(blep.pos_change_magnitude) > 0 &&
-          currentBlepTableSample < minBlepArray.size()) {
-        lerpCorrection(buffer, minBlepArray,
-          static_cast<int>(currentBlepTableSample),
-          currentBlepTableSubSample, blep.pos_change_magnitude,
-          static_cast<int>(p));
-      }
-
-      // 1ST ORDER COMPENSATION ::::
-      /// add the BLEP DERIVATIVE to compensate for discontinuties in the
-      /// VELOCITY - this is BLAMP basically.
-      if (fabs(blep.vel_change_magnitude) > 0 &&
-          currentBlepDerivTableSampleExact < minBlepDerivArray.size()) {
-
-        lerpCorrection(buffer, minBlepDerivArray,
-          static_cast<int>(currentBlepDerivTableSample), currentBlepDerivTableSubSample,
-          blep.vel_change_magnitude, static_cast<int>(p));
-      }
-    }
-
-    // UPDATE ::::
-    blep.offset = blep.offset + static_cast<double>(numSamples);
-    if (blep.offset * freqMultiple > minBlepArray.size()) {
-      currentActiveBlepOffsets.remove(i);
-    } else
-      currentActiveBlepOffsets.setUnchecked(i, blep);
+  if (!residual_.empty()) {
+    read_index_ = (read_index_ + numSamples) & residual_mask_;
   }
+  pending_samples_ = std::max(0, pending_samples_ - numSamples);
 }
 
 }  // namespace audio_plugin
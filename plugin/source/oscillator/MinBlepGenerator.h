@@ -13,6 +13,9 @@ https://forum.juce.com/t/open-source-square-waves-for-the-juceplugin/19915/8
 import JuceImports;
 import std;
 
+// generated at build time by plugin/tools/MinBlepTableGenerator.cpp
+#include "MinBlepTables.h"
+
 namespace audio_plugin {
 
 class MinBlepGenerator {
@@ -36,14 +39,6 @@ class MinBlepGenerator {
   double ratio_, last_ratio_;
 
 public:
-  double over_sampling_ratio_;
-  int zero_crossings_;
-
-  float last_value_;
-  float last_delta_;  // previous derivative ...
-
-  // Tweaking the Blep F
-  double proportional_blep_freq_;
   bool return_derivative_;  // set this to return the FIRST DERIVATIVE of the blep
                           // (for first der. discontinuities)
 
@@ -60,231 +55,25 @@ public:
      * continue to step through samples. This is used to convert to a lookup against the blep
      * table so we know what part of the blep table we should be mixing in for a given offset in
      * output samples from the start of the blep.
-     * The sign flips to positive once we start processing the next buffer of audio, and
-     * (todo presumably) the magnitude at that point represents how many samples ago the blep occurred
-     * (so the blep tail is processed when it spans multiple buffers).
+     * Only used when the blep is added - the part of it that spans later
+     * buffers is already in the residual ring by then.
      */
     double offset = 0;
-    double freqMultiple = 0;
     double pos_change_magnitude = 0;
     double vel_change_magnitude = 0;
   };
 
-  juce::Array<BlepOffset, juce::CriticalSection> currentActiveBlepOffsets;
-
 public:
   MinBlepGenerator();
   ~MinBlepGenerator();
 
-  static juce::Array<float> min_blep_array();
-  static juce::Array<float> min_blep_deriv_array();
-
-  void set_return_derivative(const bool derivative) { return_derivative_ = derivative; }
-
-  // Utility ....
-
-  // SINC Function
-  static inline double Sinc(const double x) {
-    if (x == 0.0)
-      return 1.0;
-    else {
-      double pix = juce::MathConstants<double>::pi * x;
-      return sin(pix) / pix;
-    }
-  }
-
-  // Generate Blackman Window
-  static inline double BlackmanHarris(const double p) {
-    return
-      + 0.35875
-      - 0.48829 * std::cos(2 * juce::MathConstants<double>::pi * p)
-      + 0.14128 * std::cos(4 * juce::MathConstants<double>::pi * p)
-      - 0.01168 * std::cos(6 * juce::MathConstants<double>::pi * p);
-  }
-
   /**
-   * Applies the window to x
+   * Allocates the residual ring. Must be called before any bleps are added.
+   * @param max_block_size most samples ProcessBlock will be passed at once
    */
-  static inline void ApplyBlackmanHarrisWindow(const int n, double* x) {
-    for (int i = 0; i < n; i++) {
-      x[i] *= BlackmanHarris(static_cast<double>(i) / (n - 1));
-    }
-  }
-
-  // Discrete Fourier Transform
-  static void DFT(const size_t N,
-           const double* realTime,
-           const double* imagTime,
-           double* realFreq,
-           double* imagFreq) {
-    for (size_t k = 0; k < N; k++) {
-      realFreq[k] = 0.0;
-      imagFreq[k] = 0.0;
-    }
-
-    // Calculate DFT for each frequency bin k
-    for (size_t k = 0; k < N; k++) {
-      double realSum = 0.0;
-      double imagSum = 0.0;
-
-      // Sum over all input samples n
-      for (size_t n = 0; n < N; n++) {
-        double angle = -2.0 * M_PI * static_cast<double>(k)
-          * static_cast<double>(n) / static_cast<double>(N);
-        double cosAngle = cos(angle);
-        double sinAngle = sin(angle);
-
-        // Complex multiplication: (inputReal[n] + i*inputImag[n]) * (cos(angle) + i*sin(angle))
-        realSum += realTime[n] * cosAngle - imagTime[n] * sinAngle;
-        imagSum += realTime[n] * sinAngle + imagTime[n] * cosAngle;
-      }
-
-      realFreq[k] = realSum;
-      imagFreq[k] = imagSum;
-    }
-  }
-
-  // Inverse Discrete Fourier Transform.
-  // Note the result is scaled by 1/n, which assumes the DFT was NOT scaled.
-  static void InverseDFT(const size_t N,
-                  double* realTime,
-                  double* imagTime,
-                  const double* realFreq,
-                  const double* imagFreq) {
-    for (size_t k = 0; k < N; k++) {
-      realTime[k] = 0.0;
-      imagTime[k] = 0.0;
-    }
-
-    // Calculate IDFT for each time sample n
-    for (size_t n = 0; n < N; n++) {
-      double realSum = 0.0;
-      double imagSum = 0.0;
-
-      // Sum over all frequency bins k
-      for (size_t k = 0; k < N; k++) {
-        double angle = 2.0 * M_PI * static_cast<double>(k)
-          * static_cast<double>(n) / static_cast<double>(N);  // Note: positive angle (opposite of DFT)
-        double cosAngle = cos(angle);
-        double sinAngle = sin(angle);
-
-        // Complex multiplication: (inputReal[k] + i*inputImag[k]) * (cos(angle) + i*sin(angle))
-        realSum += realFreq[k] * cosAngle - imagFreq[k] * sinAngle;
-        imagSum += realFreq[k] * sinAngle + imagFreq[k] * cosAngle;
-      }
-
-      // Normalize by dividing by N
-      realTime[n] = realSum / static_cast<double>(N);
-      imagTime[n] = imagSum / static_cast<double>(N);
-    }
-  }
-
-  // Complex Absolute Value
-  static inline double Cabs(const double x, const double y) { return sqrt((x * x) + (y * y)); }
-
-  // Complex Exponential
-  static inline void Cexp(const double x,
-                          const double y, double* zx, double* zy) {
-    const double expx = exp(x);
-    *zx = expx * cos(y);
-    *zy = expx * sin(y);
-  }
-
-  // Compute Real Cepstrum Of x
-  static void RealCepstrum(const size_t n, double* x) {
-    size_t i;
-
-    const auto realTime = new double[n];
-    const auto imagTime = new double[n];
-    const auto realFreq = new double[n];
-    const auto imagFreq = new double[n];
-
-    // Compose Complex FFT Input
-    for (i = 0; i < n; i++) {
-      realTime[i] = x[i];
-      imagTime[i] = 0.0;
-    }
-
-    DFT(n, realTime, imagTime, realFreq, imagFreq);
-
-    // Note: For real cepstrum, we only return the real part
-    // The imaginary part should be negligible (numerical errors only)
-    for (i = 0; i < n; i++) {
-      // Calculate magnitude: sqrt(real^2 + imag^2)
-      double magnitude = sqrt(realFreq[i] * realFreq[i] +
-                             imagFreq[i] * imagFreq[i]);
-
-      // Take natural log (add small epsilon to avoid log(0))
-      const double epsilon = 1e-10;
-      realFreq[i] = log(magnitude + epsilon);
-      imagFreq[i] = 0;
-    }
+  void Prepare(int max_block_size);
 
-    // Perform Inverse FFT (this also scales by 1/n)
-    InverseDFT(n, realTime, imagTime, realFreq, imagFreq);
-
-    // Output Real Part Of FFT
-    for (i = 0; i < n; i++)
-      x[i] = realTime[i];
-
-    delete[] realTime;
-    delete[] imagTime;
-    delete[] realFreq;
-    delete[] imagFreq;
-  }
-
-  // Compute Minimum Phase Reconstruction Of x
-  static void MinimumPhase(const size_t n, double* x) {
-    const auto realTime = new double[n];
-    const auto imagTime = new double[n];
-    const auto realFreq = new double[n];
-    const auto imagFreq = new double[n];
-
-    // Compose Complex FFT Input
-    // keep DC component
-    realTime[0] = x[0];
-    for (size_t i = 1; i < n; i++) {
-      realTime[i] = x[i];
-      imagTime[i] = 0.0;
-    }
-
-    // double the positive freqs (causal part)
-    for (size_t i = 0; i < n / 2; i++) {
-      realTime[i] *= 2;
-    }
-
-    // nyquist freq (for even N)
-    // todo assumes nyquist bin is half the input - is this correct?
-    if (n % 2 == 0) {
-      realTime[n / 2] = x[n / 2];
-    }
-
-    // zero out negative freqs (anti-causal part)
-    for (size_t i = (n / 2) + 1; i < n; i++) {
-      realTime[i] = 0;
-    }
-
-    DFT(n, realTime, imagTime, realFreq, imagFreq);
-
-    // exponentiate to get complex spectrum
-    for (size_t k = 0; k < n; k++) {
-      double magnitude = exp(realFreq[k]);
-      double phase = imagFreq[k];
-
-      realFreq[k] = magnitude * cos(phase);
-      imagFreq[k] = magnitude * sin(phase);
-    }
-
-    InverseDFT(n, realTime, imagTime, realFreq, imagFreq);
-
-    for (size_t i = 0; i < n; i++)
-      x[i] = realTime[i];
-
-    delete[] realTime;
-    delete[] imagTime;
-    delete[] realFreq;
-    delete[] imagFreq;
-  }
+  void set_return_derivative(const bool derivative) { return_derivative_ = derivative; }
 
   // FILTER ::::::
   void CreateLowPass(const double frequencyRatio) {
@@ -362,23 +151,67 @@ public:
     return static_cast<float>(out);
   }
 
+  /**
+   * Drops any corrections that haven't been output yet.
+   */
   void Clear();
+  /**
+   * @return true if no added blep still has a correction left to output
+   */
   bool IsClear() const;
 
-  // CUSTOM ::::
-  void set_limiting_freq(float proportionOfSamplingRate);
-
-  void BuildBlep() const;
-  void AddBlep(BlepOffset newBlep);
-  void AddBlepArray(const juce::Array<BlepOffset>& newBleps);
+  /**
+   * Picks the kernel used for the bleps added from now on. Higher notes have
+   * more (and denser) harmonics near nyquist, so they get the longer kernels
+   * with a steeper cutoff. Lower notes have little energy up there, so a
+   * short kernel is inaudible and much cheaper to add.
+   * @param freq_ratio fundamental freq / sampling freq
+   */
+  void SelectTable(double freq_ratio);
+  const MinBlepTable& table() const { return *table_; }
+  /**
+   * The BLAMP's correction grows with the length of the kernel. The
+   * WaveGenerator's BLAMP magnitudes were tuned with a 32 sample kernel, so
+   * they're scaled by this to match the current one.
+   */
+  double blamp_scale() const { return table_->length / 32.0; }
 
-  juce::Array<BlepOffset> GetNextBleps();
+  /**
+   * Scales the blep (and/or blamp) by its magnitudes and adds its whole
+   * correction into the residual ring, using the current table.
+   * @param newBlep offset is relative to the block that will be passed to
+   * the next ProcessBlock call
+   */
+  void AddBlep(const BlepOffset& newBlep);
 
+  /**
+   * Mixes the corrections of every blep added so far into the next numSamples
+   * of output and advances past them.
+   */
   void ProcessBlock(float* buffer, int numSamples);
-  void RescaleBlepsToBuffer(const float* buffer,
-                               int numSamples,
-                               float shiftBlepsBy = 0);
-  void ProcessCurrentBleps(float* buffer, int numSamples);
+
+private:
+  /**
+   * Adds magnitude * the kernel into the ring, taking every
+   * kMinBlepOverSamplingRatio'th kernel sample from first_index on, starting
+   * at first_sample.
+   */
+  void AddKernel(std::span<const float> kernel, double magnitude,
+                 int first_sample, int first_index);
+
+  // upper bound of the freq ratio each table but the last is used for
+  static constexpr std::array<double, kMinBlepTables.size() - 1>
+      kMaxFreqRatios{1.0 / 512, 1.0 / 128, 1.0 / 32};
+  const MinBlepTable* table_ = &kMinBlepTables[2];
+  // Sum of the remaining corrections of every blep added so far, indexed by
+  // output sample (modulo the ring size). Each block adds its slice to the
+  // output and zeroes it so it can be reused for later samples.
+  std::vector<float> residual_;
+  int residual_mask_ = 0;
+  // ring index of the first sample of the next block
+  int read_index_ = 0;
+  // samples from read_index_ on that may hold a correction
+  int pending_samples_ = 0;
 };
 
 }  // namespace audio_plugin
@@ -4,6 +4,95 @@
 #include "../Utils.h"
 
 namespace audio_plugin {
+namespace {
+// Above this, a saw / square has enough harmonics left near nyquist after
+// minBLEP to alias audibly at 1x
+constexpr auto kHighNoteHz = 1000.0;
+// The OTA stages compute tanh(x / drive) * drive, so they saturate more the
+// lower the drive goes. Below these drives (or past these resonances, which
+// feed the output back into the tanh) they add harmonics worth oversampling
+// for, and a lot of them.
+constexpr auto kSoftDrive = 3.f;
+constexpr auto kHardDrive = 1.f;
+constexpr auto kSoftResonance = 1.f;
+constexpr auto kHardResonance = 3.f;
+// -120 dB. Once the VCA envelope is below this, the voice can't be heard.
+constexpr auto kSilenceLevel = 1e-6f;
+
+// maps the waveType / wave2Type choice index to a wave type
+WaveType ToWaveType(const int choice) {
+  switch (choice) {
+    case 0:
+      return sine;
+    case 2:
+      return triangle;
+    case 3:
+      return square;
+    case 4:
+      return random;
+    case 1:
+    default:
+      return sawFall;
+  }
+}
+
+// maps the pulseWidthSource choice index to a mod type
+PulseWidthModType ToPulseWidthModType(const int choice) {
+  switch (choice) {
+    case 0:
+      return env2Minus;
+    case 1:
+      return env2Plus;
+    case 2:
+      return env1Minus;
+    case 3:
+      return env1Plus;
+    case 4:
+      return lfo;
+    case 5:
+    default:
+      return manual;
+  }
+}
+}  // namespace
+
+int PickOversampleFactor(const OversampleSettings& settings,
+                         const double note_hz, const double sample_rate,
+                         const int max_factor) {
+  const auto high_note = note_hz > kHighNoteHz;
+  auto factor = 1;
+  // minBLEP keeps saws and squares clean at 1x, apart from high notes
+  if (settings.harmonic_rich && high_note) factor = 2;
+  // FM (which falls back to polyBLEP) and hard sync spread the spectrum
+  // further than minBLEP can clean up
+  if (settings.spread_spectrum) factor = std::max(factor, 2);
+  if (settings.filter_type == 0) {
+    // the delayed feedback filter's prewarp blows up as the cutoff gets near
+    // nyquist, which it can at 1x
+    factor = std::max(factor, 2);
+  } else if (settings.filter_type == 1 && sample_rate > 0) {
+    // the TPT filter clamps g, which caps its cutoff well below nyquist at
+    // 1x. Run fast enough for the cutoff to get where it's modulated to.
+    while (factor < max_factor &&
+           OTAFilterTPTNewtonRaphson::HighestCutoff(sample_rate * factor) <
+               static_cast<double>(settings.max_cutoff)) {
+      factor *= 2;
+    }
+  }
+  if (settings.filter_type != 2) {
+    // the filter's tanh stages add harmonics of whatever goes in, more the
+    // lower the drive and the more the resonance feeds back
+    if (settings.filter_drive < kHardDrive ||
+        settings.filter_resonance > kHardResonance) {
+      const auto hard_factor = !settings.harmonic_rich ? 2 : high_note ? 8 : 4;
+      factor = std::max(factor, hard_factor);
+    } else if (settings.filter_drive < kSoftDrive ||
+               settings.filter_resonance > kSoftResonance) {
+      factor = std::max(factor, 2);
+    }
+  }
+  return std::min(factor, max_factor);
+}
 
 OscillatorSound::OscillatorSound(
     [[maybe_unused]] juce::AudioProcessorValueTreeState& apvts) {}
@@ -16,207 +105,303 @@ bool OscillatorSound::appliesToChannel([[maybe_unused]] int midiChannelIndex) {
   return true;
 }
 
-OscillatorVoice::OscillatorVoice(const juce::AudioBuffer<float>& lfo_buffer)
+OscillatorVoice::OscillatorVoice(const juce::AudioBuffer<float>& lfo_buffer,
+                                 VoiceBus& voice_bus)
     : lfo_buffer_{lfo_buffer},
-      waveGenerator_{lfo_buffer_, env1_buffer_, env2_buffer_, wave2_buffer_,
-                     hard_sync_reset_sample_indices_},
-      wave2Generator_{lfo_buffer_, env1_buffer_, env2_buffer_, wave2_buffer_,
-                      hard_sync_reset_sample_indices_},
-      filter_tpt_{env1_buffer_, lfo_buffer_},
-      filter_dfb_{env1_buffer_, lfo_buffer_} {
-  waveGenerator_.PrepareToPlay(getSampleRate() * kOversample);
-  wave2Generator_.PrepareToPlay(getSampleRate() * kOversample);
+      voice_bus_{voice_bus},
+      waveGenerator_{mod_bus_, hard_sync_reset_sample_indices_},
+      wave2Generator_{mod_bus_, hard_sync_reset_sample_indices_},
+      filter_tpt_{mod_bus_},
+      filter_dfb_{mod_bus_} {
   waveGenerator_.set_mode(ANTIALIAS);
   wave2Generator_.set_mode(ANTIALIAS);
-  filter_tpt_.set_sample_rate(getSampleRate() * kOversample);
-  filter_dfb_.set_sample_rate(getSampleRate() * kOversample);
+  waveGenerator_.set_phase_accumulator_enabled(true);
+  wave2Generator_.set_phase_accumulator_enabled(true);
 }
 
 bool OscillatorVoice::canPlaySound(juce::SynthesiserSound* sound) {
   return dynamic_cast<OscillatorSound*>(sound) != nullptr;
 }
 
-void OscillatorVoice::Configure(
-    const juce::AudioProcessorValueTreeState& apvts) {
-  filter_type_ = static_cast<int>(apvts.getRawParameterValue("vcfFilterType")->load());
-  filter_tpt_.Configure(apvts);
-  filter_dfb_.Configure(apvts);
+void OscillatorVoice::Configure(const ParameterTable& params,
+                                const ParameterChanges& changes) {
+  if (changes[std::to_underlying(ParamId::kVcfFilterType)]) {
+    filter_type_ = params.GetInt(ParamId::kVcfFilterType);
+    oversample_settings_.filter_type = filter_type_;
+  }
+  if (AnyChanged(changes,
+                 {ParamId::kFilterCutoffFreq, ParamId::kFilterResonance,
+                  ParamId::kFilterDrive, ParamId::kFilterSlope,
+                  ParamId::kFilterEnvMod, ParamId::kFilterLfoMod,
+                  ParamId::kFilterInputDriveScale1,
+                  ParamId::kFilterStateDriveScale1,
+                  ParamId::kFilterInputDriveScale2,
+                  ParamId::kFilterStateDriveScale2,
+                  ParamId::kFilterInputDriveScale3,
+                  ParamId::kFilterStateDriveScale3,
+                  ParamId::kFilterInputDriveScale4,
+                  ParamId::kFilterStateDriveScale4})) {
+    filter_tpt_.Configure(params);
+    filter_dfb_.Configure(params);
+    oversample_settings_.filter_drive = params.Get(ParamId::kFilterDrive);
+    oversample_settings_.filter_resonance =
+        params.Get(ParamId::kFilterResonance);
+    oversample_settings_.max_cutoff = filter_tpt_.max_modulated_cutoff();
+  }
 
   // Configure ADSR envelope from parameters
-  envelope_.Prepare(getSampleRate());
-  envelope_.Configure(apvts.getRawParameterValue("adsrAttack")->load(),
-                      apvts.getRawParameterValue("adsrDecay")->load(),
-                      apvts.getRawParameterValue("adsrSustain")->load(),
-                      apvts.getRawParameterValue("adsrRelease")->load());
-  envelope2_.Prepare(getSampleRate());
-  envelope2_.Configure(apvts.getRawParameterValue("env2Attack")->load(),
-                       apvts.getRawParameterValue("env2Decay")->load(),
-                       apvts.getRawParameterValue("env2Sustain")->load(),
-                       apvts.getRawParameterValue("env2Release")->load());
-
-  if (apvts.getRawParameterValue("vcoModOsc1")->load() > 0) {
-    waveGenerator_.set_pitch_bend_lfo_mod(
-        apvts.getRawParameterValue("vcoModLfoFreq")->load());
-    waveGenerator_.set_pitch_bend_env1_mod(
-        apvts.getRawParameterValue("vcoModEnv1Freq")->load());
-  } else {
-    waveGenerator_.set_pitch_bend_lfo_mod(0);
-    waveGenerator_.set_pitch_bend_env1_mod(0);
+  if (AnyChanged(changes, {ParamId::kAdsrAttack, ParamId::kAdsrDecay,
+                           ParamId::kAdsrSustain, ParamId::kAdsrRelease})) {
+    envelope_.Configure(params.Get(ParamId::kAdsrAttack),
+                        params.Get(ParamId::kAdsrDecay),
+                        params.Get(ParamId::kAdsrSustain),
+                        params.Get(ParamId::kAdsrRelease));
+  }
+  if (AnyChanged(changes, {ParamId::kEnv2Attack, ParamId::kEnv2Decay,
+                           ParamId::kEnv2Sustain, ParamId::kEnv2Release})) {
+    envelope2_.Configure(params.Get(ParamId::kEnv2Attack),
+                         params.Get(ParamId::kEnv2Decay),
+                         params.Get(ParamId::kEnv2Sustain),
+                         params.Get(ParamId::kEnv2Release));
   }
 
-  if (apvts.getRawParameterValue("vcoModOsc2")->load() > 0) {
-    wave2Generator_.set_pitch_bend_lfo_mod(
-        apvts.getRawParameterValue("vcoModLfoFreq")->load());
-    wave2Generator_.set_pitch_bend_env1_mod(
-        apvts.getRawParameterValue("vcoModEnv1Freq")->load());
-  } else {
-    wave2Generator_.set_pitch_bend_lfo_mod(0);
-    wave2Generator_.set_pitch_bend_env1_mod(0);
+  if (AnyChanged(changes, {ParamId::kVcoModOsc1, ParamId::kVcoModLfoFreq,
+                           ParamId::kVcoModEnv1Freq})) {
+    if (params.GetBool(ParamId::kVcoModOsc1)) {
+      waveGenerator_.set_pitch_bend_lfo_mod(
+          params.Get(ParamId::kVcoModLfoFreq));
+      waveGenerator_.set_pitch_bend_env1_mod(
+          params.Get(ParamId::kVcoModEnv1Freq));
+    } else {
+      waveGenerator_.set_pitch_bend_lfo_mod(0);
+      waveGenerator_.set_pitch_bend_env1_mod(0);
+    }
   }
 
-  switch (static_cast<int>(apvts.getRawParameterValue("waveType")->load())) {
-    case 0:
-      waveGenerator_.set_wave_type(sine);
-      break;
-    case 1:
-      waveGenerator_.set_wave_type(sawFall);
-      break;
-    case 2:
-      waveGenerator_.set_wave_type(triangle);
-      break;
-    case 3:
-      waveGenerator_.set_wave_type(square);
-      break;
-    case 4:
-      waveGenerator_.set_wave_type(random);
-      break;
-    default:
-      break;
+  if (AnyChanged(changes, {ParamId::kVcoModOsc2, ParamId::kVcoModLfoFreq,
+                           ParamId::kVcoModEnv1Freq})) {
+    if (params.GetBool(ParamId::kVcoModOsc2)) {
+      wave2Generator_.set_pitch_bend_lfo_mod(
+          params.Get(ParamId::kVcoModLfoFreq));
+      wave2Generator_.set_pitch_bend_env1_mod(
+          params.Get(ParamId::kVcoModEnv1Freq));
+    } else {
+      wave2Generator_.set_pitch_bend_lfo_mod(0);
+      wave2Generator_.set_pitch_bend_env1_mod(0);
+    }
   }
 
-  switch (static_cast<int>(apvts.getRawParameterValue("wave2Type")->load())) {
-    case 0:
-      wave2Generator_.set_wave_type(sine);
-      break;
-    case 1:
-      wave2Generator_.set_wave_type(sawFall);
-      break;
-    case 2:
-      wave2Generator_.set_wave_type(triangle);
-      break;
-    case 3:
-      wave2Generator_.set_wave_type(square);
-      break;
-    case 4:
-      wave2Generator_.set_wave_type(random);
-      break;
-    default:
-      break;
+  if (changes[std::to_underlying(ParamId::kWaveType)]) {
+    waveGenerator_.set_wave_type(
+        ToWaveType(params.GetInt(ParamId::kWaveType)));
   }
-  const auto hard_sync = apvts.getRawParameterValue("vco2Sync")->load() > 0.5f;
-  const float fine_tune = apvts.getRawParameterValue("fineTune")->load();
-  const float crossMod = apvts.getRawParameterValue("crossMod")->load();
-  // cross mod and hard sync can't be used together - cross mod disables hard sync
-  if (hard_sync && crossMod <= 0.f) {
-    waveGenerator_.set_hard_sync_mode(PRIMARY);
-    wave2Generator_.set_hard_sync_mode(SECONDARY);
-  } else {
-    waveGenerator_.set_hard_sync_mode(DISABLED);
-    wave2Generator_.set_hard_sync_mode(DISABLED);
+  if (changes[std::to_underlying(ParamId::kWave2Type)]) {
+    wave2Generator_.set_wave_type(
+        ToWaveType(params.GetInt(ParamId::kWave2Type)));
   }
-  // todo: fine tune not working correctly when hardsync off
-  wave2Generator_.set_pitch_offset_semis(static_cast<double>(fine_tune));
 
-  const int pulseWidthSource =
-      static_cast<int>(apvts.getRawParameterValue("pulseWidthSource")->load());
-  switch (pulseWidthSource) {
-    case 0:
-      waveGenerator_.set_pulse_width_mod_type(env2Minus);
-      wave2Generator_.set_pulse_width_mod_type(env2Minus);
-      break;
-    case 1:
-      waveGenerator_.set_pulse_width_mod_type(env2Plus);
-      wave2Generator_.set_pulse_width_mod_type(env2Plus);
-      break;
-    case 2:
-      waveGenerator_.set_pulse_width_mod_type(env1Minus);
-      wave2Generator_.set_pulse_width_mod_type(env1Minus);
-      break;
-    case 3:
-      waveGenerator_.set_pulse_width_mod_type(env1Plus);
-      wave2Generator_.set_pulse_width_mod_type(env1Plus);
-      break;
-    case 4:
-      waveGenerator_.set_pulse_width_mod_type(lfo);
-      wave2Generator_.set_pulse_width_mod_type(lfo);
-      break;
-    case 5:
-      waveGenerator_.set_pulse_width_mod_type(manual);
-      wave2Generator_.set_pulse_width_mod_type(manual);
-      break;
+  const float crossMod = params.Get(ParamId::kCrossMod);
+  if (AnyChanged(changes, {ParamId::kVco2Sync, ParamId::kCrossMod})) {
+    // cross mod and hard sync can't be used together - cross mod disables
+    // hard sync
+    if (params.GetBool(ParamId::kVco2Sync) && crossMod <= 0.f) {
+      waveGenerator_.set_hard_sync_mode(PRIMARY);
+      wave2Generator_.set_hard_sync_mode(SECONDARY);
+    } else {
+      waveGenerator_.set_hard_sync_mode(DISABLED);
+      wave2Generator_.set_hard_sync_mode(DISABLED);
+    }
+  }
+  if (changes[std::to_underlying(ParamId::kFineTune)]) {
+    // todo: fine tune not working correctly when hardsync off
+    wave2Generator_.set_pitch_offset_semis(
+        static_cast<double>(params.Get(ParamId::kFineTune)));
   }
-  const double pulseWidth =
-      static_cast<double>(apvts.getRawParameterValue("pulseWidth")->load());
-  waveGenerator_.set_pulse_width_mod(pulseWidth);
-  wave2Generator_.set_pulse_width_mod(pulseWidth);
 
+  if (changes[std::to_underlying(ParamId::kPulseWidthSource)]) {
+    const auto pulse_width_mod_type =
+        ToPulseWidthModType(params.GetInt(ParamId::kPulseWidthSource));
+    waveGenerator_.set_pulse_width_mod_type(pulse_width_mod_type);
+    wave2Generator_.set_pulse_width_mod_type(pulse_width_mod_type);
+  }
+  if (changes[std::to_underlying(ParamId::kPulseWidth)]) {
+    const double pulseWidth =
+        static_cast<double>(params.Get(ParamId::kPulseWidth));
+    waveGenerator_.set_pulse_width_mod(pulseWidth);
+    wave2Generator_.set_pulse_width_mod(pulseWidth);
+  }
 
-  waveGenerator_.set_cross_mod(crossMod);
-  if (crossMod > 0.f) {
-    // todo: when turning crossmod back down the pitch mod gets "stuck"
-    // minblep AA is not compatible with FM
-    // todo: is this really true? I think there is some other issue...
-    waveGenerator_.set_mode(NO_ANTIALIAS);
-    wave2Generator_.set_mode(NO_ANTIALIAS);
-  } else {
-    waveGenerator_.set_mode(ANTIALIAS);
-    wave2Generator_.set_mode(ANTIALIAS);
+  if (changes[std::to_underlying(ParamId::kCrossMod)]) {
+    waveGenerator_.set_cross_mod(crossMod);
+    if (crossMod > 0.f) {
+      // todo: when turning crossmod back down the pitch mod gets "stuck"
+      // minblep AA is not compatible with FM
+      // todo: is this really true? I think there is some other issue...
+      // polyblep needs no residual, so it still works under FM
+      waveGenerator_.set_mode(POLYBLEP);
+      wave2Generator_.set_mode(POLYBLEP);
+    } else {
+      waveGenerator_.set_mode(ANTIALIAS);
+      wave2Generator_.set_mode(ANTIALIAS);
+    }
   }
 
-  const double vco1Level =
-      static_cast<double>(apvts.getRawParameterValue("vco1Level")->load());
-  waveGenerator_.set_gain(vco1Level);
-  const double vco2Level =
-      static_cast<double>(apvts.getRawParameterValue("vco2Level")->load());
-  wave2Generator_.set_gain(vco2Level);
+  if (changes[std::to_underlying(ParamId::kVco1Level)]) {
+    waveGenerator_.set_gain(static_cast<double>(params.Get(ParamId::kVco1Level)));
+  }
+  if (changes[std::to_underlying(ParamId::kVco2Level)]) {
+    wave2Generator_.set_gain(
+        static_cast<double>(params.Get(ParamId::kVco2Level)));
+  }
 
   // filter
-  const int filterEnvSource =
-      static_cast<int>(apvts.getRawParameterValue("filterEnvSource")->load());
-  if (filterEnvSource == 0) {
-    filter_env_buffer_ = &env1_buffer_;
-  } else {
-    filter_env_buffer_ = &env2_buffer_;
+  if (changes[std::to_underlying(ParamId::kFilterEnvSource)]) {
+    const auto env_source = params.GetInt(ParamId::kFilterEnvSource) == 0
+                                ? ModulationBus::kEnv1
+                                : ModulationBus::kEnv2;
+    filter_dfb_.set_env_source(env_source);
+    filter_tpt_.set_env_source(env_source);
+  }
+  if (changes[std::to_underlying(ParamId::kMathQuality)]) {
+    const auto math_quality = static_cast<MathQuality>(juce::jlimit(
+        0, kNumMathQualities - 1, params.GetInt(ParamId::kMathQuality)));
+    filter_dfb_.set_math_quality(math_quality);
+    filter_tpt_.set_math_quality(math_quality);
+  }
+
+  if (AnyChanged(changes, {ParamId::kWaveType, ParamId::kWave2Type,
+                           ParamId::kVco1Level, ParamId::kVco2Level,
+                           ParamId::kVco2Sync, ParamId::kCrossMod,
+                           ParamId::kVcfFilterType, ParamId::kFilterDrive,
+                           ParamId::kFilterResonance,
+                           ParamId::kFilterCutoffFreq, ParamId::kFilterEnvMod,
+                           ParamId::kFilterLfoMod})) {
+    const auto harmonic_rich = [&params](const ParamId wave_type,
+                                         const ParamId level) {
+      return ToWaveType(params.GetInt(wave_type)) != sine &&
+             params.Get(level) > 0.f;
+    };
+    oversample_settings_.harmonic_rich =
+        harmonic_rich(ParamId::kWaveType, ParamId::kVco1Level) ||
+        harmonic_rich(ParamId::kWave2Type, ParamId::kVco2Level);
+    oversample_settings_.spread_spectrum =
+        crossMod > 0.f || params.GetBool(ParamId::kVco2Sync);
+    UpdateOversampleFactor();
+  }
+}
+
+void OscillatorVoice::Prepare(const double sample_rate, const int blockSize) {
+  envelope_.Prepare(sample_rate);
+  envelope2_.Prepare(sample_rate);
+  oversample_buffer_.setSize(1, blockSize * kMaxOversample, false, true);
+  mod_bus_.Prepare(blockSize);
+  // sized for kMaxOversample, so switching factor only has to change rates
+  const auto oversample_rate = sample_rate * oversample_factor_;
+  const auto max_oversample_samples = blockSize * kMaxOversample;
+  waveGenerator_.PrepareToPlay(oversample_rate, max_oversample_samples);
+  wave2Generator_.PrepareToPlay(oversample_rate, max_oversample_samples);
+  crossfade_from_ = 0;
+  SetOversampleFactor(oversample_factor_);
+}
+
+void OscillatorVoice::set_max_oversample_factor(const int factor) {
+  jassert(factor <= kMaxOversample && juce::isPowerOfTwo(factor));
+  max_oversample_factor_ = factor;
+  UpdateOversampleFactor();
+}
+
+int OscillatorVoice::PickOversampleFactor(const int note) const {
+  return audio_plugin::PickOversampleFactor(
+      oversample_settings_, juce::MidiMessage::getMidiNoteInHertz(note),
+      getSampleRate(), max_oversample_factor_);
+}
+
+void OscillatorVoice::UpdateOversampleFactor() {
+  // idle voices pick when their next note starts
+  const auto note = getCurrentlyPlayingNote();
+  if (note < 0) return;
+  const auto factor = PickOversampleFactor(note);
+  if (factor == oversample_factor_) return;
+  if (crossfade_from_ == 0) {
+    crossfade_from_ = oversample_factor_;
+  } else if (crossfade_from_ == factor) {
+    // changed back before the next block was rendered
+    crossfade_from_ = 0;
+  }
+  SetOversampleFactor(factor);
+}
+
+void OscillatorVoice::SetOversampleFactor(const int factor) {
+  jassert(factor <= kMaxOversample && juce::isPowerOfTwo(factor));
+  oversample_factor_ = factor;
+  switch (factor) {
+    case 1:
+      render_oversampled_ = &OscillatorVoice::RenderOversampled<1>;
+      finish_oversampled_ = &OscillatorVoice::FinishOversampled<1>;
+      break;
+    case 4:
+      render_oversampled_ = &OscillatorVoice::RenderOversampled<4>;
+      finish_oversampled_ = &OscillatorVoice::FinishOversampled<4>;
+      break;
+    case 8:
+      render_oversampled_ = &OscillatorVoice::RenderOversampled<8>;
+      finish_oversampled_ = &OscillatorVoice::FinishOversampled<8>;
+      break;
+    default:
+      render_oversampled_ = &OscillatorVoice::RenderOversampled<2>;
+      finish_oversampled_ = &OscillatorVoice::FinishOversampled<2>;
+      break;
+  }
+
+  // set_sample_rate leaves the generators' and filters' state alone, so a
+  // playing note carries on where it was
+  const auto oversample_rate = getSampleRate() * factor;
+  waveGenerator_.set_sample_rate(oversample_rate);
+  wave2Generator_.set_sample_rate(oversample_rate);
+  filter_tpt_.set_sample_rate(oversample_rate);
+  filter_dfb_.set_sample_rate(oversample_rate);
+  // a note that's already playing keeps its pitch
+  if (const auto note = getCurrentlyPlayingNote(); note >= 0) {
+    waveGenerator_.set_pitch_semitone(note, PitchSampleRate());
+    wave2Generator_.set_pitch_semitone(note, PitchSampleRate());
   }
-  filter_dfb_.set_env_buffer(*filter_env_buffer_);
-  filter_tpt_.set_env_buffer(*filter_env_buffer_);
 }
 
-void OscillatorVoice::SetBlockSize(const int blockSize) {
-  downsampler_.prepare(blockSize, kOversample);
-  const auto oversample_samples = blockSize * kOversample;
-  oversample_buffer_.setSize(1, oversample_samples, false, true);
-  wave2_buffer_.setSize(1, oversample_samples, false, true);
-  env1_buffer_.setSize(1, blockSize, false, true);
-  env2_buffer_.setSize(1, blockSize, false, true);
+double OscillatorVoice::PitchSampleRate() const {
+  return getSampleRate() * oversample_factor_ / kDefaultOversample;
 }
 
 void OscillatorVoice::startNote(const int midiNoteNumber,
                                 [[maybe_unused]] const float velocity,
                                 [[maybe_unused]] juce::SynthesiserSound* sound,
                                 [[maybe_unused]] int pitchWheelPos) {
-  waveGenerator_.set_pitch_semitone(midiNoteNumber, getSampleRate());
-  wave2Generator_.set_pitch_semitone(midiNoteNumber, getSampleRate());
+  // a new note starts from silence, so there's nothing to crossfade from
+  crossfade_from_ = 0;
+  SetOversampleFactor(PickOversampleFactor(midiNoteNumber));
+  waveGenerator_.set_pitch_semitone(midiNoteNumber, PitchSampleRate());
+  wave2Generator_.set_pitch_semitone(midiNoteNumber, PitchSampleRate());
   envelope_.NoteOn();
   envelope2_.NoteOn();
 }
 
 void OscillatorVoice::stopNote([[maybe_unused]] float velocity,
-                               [[maybe_unused]] const bool allowTailOff) {
+                               const bool allowTailOff) {
+  if (!allowTailOff) {
+    // voice is being stolen (or all notes were killed) - stop right away
+    EndNote();
+    return;
+  }
   envelope_.NoteOff();
   envelope2_.NoteOff();
 }
 
+void OscillatorVoice::EndNote() {
+  envelope_.Reset();
+  envelope2_.Reset();
+  crossfade_from_ = 0;
+  clearCurrentNote();
+}
+
 void OscillatorVoice::pitchWheelMoved([[maybe_unused]] int newPitchWheelValue) {
 }
 
@@ -224,76 +409,184 @@ void OscillatorVoice::controllerMoved([[maybe_unused]] int controllerNumber,
                                       [[maybe_unused]] int newControllerValue) {
 }
 
-void OscillatorVoice::renderNextBlock(juce::AudioBuffer<float>& outputBuffer,
-                                      [[maybe_unused]] int startSample,
-                                      const int numSamples) {
-  const auto oversample_samples = numSamples * kOversample;
-  ;
-  const auto oversample_start_sample = startSample * kOversample;
+void OscillatorVoice::renderNextBlock(
+    [[maybe_unused]] juce::AudioBuffer<float>& outputBuffer,
+    const int startSample, const int numSamples) {
+  // the synth asks every voice to render, playing or not
+  if (!isVoiceActive()) return;
+  (this->*render_oversampled_)(startSample, numSamples);
+}
+
+void OscillatorVoice::FinishBlock() {
+  if (pending_num_samples_ == 0) return;
+  const auto num_samples = pending_num_samples_;
+  pending_num_samples_ = 0;
+  (this->*finish_oversampled_)(pending_start_sample_, num_samples);
+}
+
+template <int kFactor>
+void OscillatorVoice::RenderOversampled(const int startSample,
+                                        const int numSamples) {
+  const auto oversample_samples = numSamples * kFactor;
+  const auto oversample_start_sample = startSample * kFactor;
 
   // TODO: how does this interact with note on? Does this mean envelope always
   //  starts at start of a block even if it "should" start mid-block?
-  // fill envelope buffers
-  envelope_.WriteEnvelopeToBuffer(env1_buffer_, startSample, numSamples);
-  envelope2_.WriteEnvelopeToBuffer(env2_buffer_, startSample, numSamples);
+  // fill the modulation bus
+  auto& control_scratch = mod_bus_.control_scratch();
+  const auto* control_data = control_scratch.getReadPointer(0);
+  envelope_.WriteEnvelopeToBuffer(control_scratch, startSample, numSamples);
+  if (juce::FloatVectorOperations::findMaximum(control_data + startSample,
+                                               numSamples) < kSilenceLevel) {
+    // the VCA shuts out the whole block, so skip the oscillators and filter
+    // and leave the voice bus (and its downsampler) alone. envelope2_ only
+    // has to keep time.
+    envelope2_.WriteEnvelopeToBuffer(control_scratch, startSample, numSamples);
+    // nothing is left to click when it comes back
+    crossfade_from_ = 0;
+    if (envelope_.IsBelow(kSilenceLevel)) EndNote();
+    return;
+  }
+  mod_bus_.Upsample<kFactor>(ModulationBus::kEnv1, control_data,
+                             startSample, numSamples);
+  envelope2_.WriteEnvelopeToBuffer(control_scratch, startSample, numSamples);
+  mod_bus_.Upsample<kFactor>(ModulationBus::kEnv2, control_data,
+                             startSample, numSamples);
+  mod_bus_.Upsample<kFactor>(ModulationBus::kLfo,
+                             lfo_buffer_.getReadPointer(0), startSample,
+                             numSamples);
 
   // note this will fill and process only the left channel since we want to work
   // in mono until the last moment the wave generator and filter are already
-  // configured to generate at 2x oversampling..
+  // configured to generate at kFactor x oversampling..
   // we need wave2 first so we can use it for cross-mod (FM)
   // TODO: should the envelope actually affect the cross-mod behavior?
-  // todo: add ability to tell RenderNextBlock to OVERWRITE instead of add
-  //    I think we need this clear since wave generator will ADD so we can avoid
-  //    the clearing
 
   // todo: when cross mod, we should disable hard sync for now. When hard sync,
   //  we need to evaluate generator 1 first as gen2 depends on it (knowing the
   //  reset sample indices).
 
+  // the oscillators are mixed, gain staged, dc blocked and (with no filter
+  // in between) put through the VCA in one pass
+  const auto* oscillator_vca =
+      filter_type_ == 2
+          ? mod_bus_.Read(ModulationBus::kEnv1) + oversample_start_sample
+          : nullptr;
   if (waveGenerator_.cross_mod() > 0) {
     // cross mod - need to run vco2 first so it can modulate vco1
-    wave2_buffer_.clear(oversample_start_sample, oversample_samples);
-    wave2Generator_.RenderNextBlock(wave2_buffer_, oversample_start_sample,
+    auto& modulator = mod_bus_.buffer(ModulationBus::kModulator);
+    modulator.clear(oversample_start_sample, oversample_samples);
+    wave2Generator_.RenderNextBlock(modulator, oversample_start_sample,
                                     oversample_samples);
-    oversample_buffer_.clear(oversample_start_sample, oversample_samples);
-    // todo: Do we even need this intermediate wave2_buffer? What if we
+    // todo: Do we even need this intermediate modulator buffer? What if we
     //  cross-mod from the oversample_buffer_ directly? if we're doing FM, we
     //  only use wave 2 for FM, we don't output it directly
-    waveGenerator_.RenderNextBlock(oversample_buffer_, oversample_start_sample,
-                                   oversample_samples);
+    WaveGenerator<false>::RenderMixed({&waveGenerator_}, oversample_buffer_,
+                                      oversample_start_sample,
+                                      oversample_samples, oscillator_vca);
   } else {
     // no cross mod or hard sync, need to run generator 1 first as it
     // sets the reset points for generator 2
-    oversample_buffer_.clear(oversample_start_sample, oversample_samples);
-    waveGenerator_.RenderNextBlock(oversample_buffer_, oversample_start_sample,
-                                   oversample_samples);
-    wave2Generator_.RenderNextBlock(oversample_buffer_, oversample_start_sample,
-                                    oversample_samples);
+    WaveGenerator<false>::RenderMixed(
+        {&waveGenerator_, &wave2Generator_}, oversample_buffer_,
+        oversample_start_sample, oversample_samples, oscillator_vca);
   }
 
   if (filter_type_ == 0) {
     filter_dfb_.Process(oversample_buffer_, oversample_start_sample,
                         oversample_samples);
   } else if (filter_type_ == 1) {
+    if (filter_bank_ != nullptr) {
+      // the rest waits for FinishBlock
+      filter_bank_->Add(filter_tpt_, oversample_buffer_,
+                        oversample_start_sample, oversample_samples);
+      pending_start_sample_ = startSample;
+      pending_num_samples_ = numSamples;
+      return;
+    }
     filter_tpt_.Process(oversample_buffer_, oversample_start_sample,
                         oversample_samples);
   }
+  FinishOversampled<kFactor>(startSample, numSamples);
+}
+
+template <int kFactor>
+void OscillatorVoice::FinishOversampled(const int startSample,
+                                        const int numSamples) {
+  const auto oversample_samples = numSamples * kFactor;
+  const auto oversample_start_sample = startSample * kFactor;
+  const auto oversample_end_sample = oversample_start_sample + oversample_samples;
+  const auto* env1_data = mod_bus_.Read(ModulationBus::kEnv1);
+  const auto vca_with_oscillators = filter_type_ == 2;
+
+  // a release (or sustain) this quiet would otherwise keep the voice
+  // rendering silence until the envelope finishes
+  if (envelope_.IsBelow(kSilenceLevel)) {
+    EndNote();
+  }
 
-  // Apply ADSR envelope to the mono oversampled buffer (VCA)
   auto* data = oversample_buffer_.getWritePointer(0);
-  auto* env1_data = env1_buffer_.getReadPointer(0);
-  for (int i = oversample_start_sample; i < oversample_samples; ++i) {
-    data[i] *= env1_data[i / kOversample];
+  if (crossfade_from_ == 0) {
+    auto& bus = voice_bus_.buffer(kFactor);
+    if (vca_with_oscillators) {
+      bus.addFrom(0, oversample_start_sample, oversample_buffer_, 0,
+                  oversample_start_sample, oversample_samples);
+      return;
+    }
+    // VCA on the way into the bus
+    auto* bus_data = bus.getWritePointer(0);
+    for (int i = oversample_start_sample; i < oversample_end_sample; ++i) {
+      // on its own so it rounds the same as a separate VCA pass would
+      const auto amplified = data[i] * env1_data[i];
+      bus_data[i] += amplified;
+    }
+    return;
   }
 
-  if (!envelope_.IsActive()) {
-    // todo: might need this or no?
-    // waveGenerator_.set_volume(-120);
-    // wave2Generator_.set_volume(-120);
-    clearCurrentNote();
+  if (!vca_with_oscillators) {
+    for (int i = oversample_start_sample; i < oversample_end_sample; ++i) {
+      data[i] *= env1_data[i];
+    }
   }
 
-  downsampler_.process(oversample_buffer_, outputBuffer,
-                       oversample_start_sample, oversample_samples);
+  // The factor changed since the last block. Jumping from one bus (and
+  // downsampler, with its own delay) to the other would click, so fade in on
+  // the new one while fading out on the old one, fed from this block
+  // decimated / held to its rate.
+  const auto from = crossfade_from_;
+  crossfade_from_ = 0;
+  auto* to_data = voice_bus_.buffer(kFactor).getWritePointer(0);
+  auto* from_data = voice_bus_.buffer(from).getWritePointer(0);
+  const auto gain_step = 1.f / static_cast<float>(numSamples);
+  for (int i = startSample; i < startSample + numSamples; ++i) {
+    const auto gain = static_cast<float>(i - startSample + 1) * gain_step;
+    for (int j = i * kFactor; j < (i + 1) * kFactor; ++j) {
+      to_data[j] += data[j] * gain;
+    }
+    for (int j = 0; j < from; ++j) {
+      from_data[i * from + j] +=
+          data[i * kFactor + j * kFactor / from] * (1.f - gain);
+    }
+  }
+}
+
+OscillatorSynthesiser::OscillatorSynthesiser(OTAFilterBank& filter_bank)
+    : filter_bank_{filter_bank} {}
+
+void OscillatorSynthesiser::AddVoice(OscillatorVoice* voice) {
+  voice->set_filter_bank(&filter_bank_);
+  addVoice(voice);
+}
+
+void OscillatorSynthesiser::renderVoices(juce::AudioBuffer<float>& outputAudio,
+                                         const int startSample,
+                                         const int numSamples) {
+  juce::Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+  filter_bank_.Process();
+  for (auto* voice : voices) {
+    if (auto* oscillator_voice = dynamic_cast<OscillatorVoice*>(voice)) {
+      oscillator_voice->FinishBlock();
+    }
+  }
 }
-}  // namespace audio_plugin
\ No newline at end of file
+}  // namespace audio_plugin
@@ -2,9 +2,13 @@
 import JuceImports;
 import std;
 
+#include "../Constants.h"
+#include "../Parameters.h"
 #include "../filter/OTAFilterDelayedFeedback.h"
 #include "../dsp/AnalogADSR.h"
-#include "../dsp/Downsampler.h"
+#include "../dsp/ModulationBus.h"
+#include "../dsp/VoiceBus.h"
+#include "../filter/OTAFilterBank.h"
 #include "../filter/OTAFilterTPTNewtonRaphson.h"
 #include "WaveGenerator.h"
 
@@ -16,22 +20,68 @@ struct OscillatorSound : juce::SynthesiserSound {
   bool appliesToChannel([[maybe_unused]] int midiChannelNumber) override;
 };
 
+/**
+ * The settings a voice's oversampling factor is picked from, kept by each
+ * voice from Configure.
+ */
+struct OversampleSettings {
+  int filter_type = 1;  // 0: DFB, 1: TPT, 2: Disabled
+  // either VCO is audible with more than a sine
+  bool harmonic_rich = true;
+  // cross mod or hard sync is on
+  bool spread_spectrum = false;
+  float filter_drive = kMinDrive;
+  float filter_resonance = 0;
+  // the highest the envelope and LFO can take the cutoff to
+  float max_cutoff = kMaxCutoff;
+};
+
+/**
+ * The lowest factor (a power of 2, up to max_factor) that keeps aliasing out
+ * of the way for a note_hz note with these settings, with the host running
+ * at sample_rate.
+ */
+int PickOversampleFactor(const OversampleSettings& settings, double note_hz,
+                         double sample_rate, int max_factor);
+
 struct OscillatorVoice : juce::SynthesiserVoice {
-  OscillatorVoice(const juce::AudioBuffer<float>& lfo_buffer);
+  /**
+   * @param voice_bus oversampled mono buses shared by all voices. Each voice
+   * adds its output into the one for the factor it's running at.
+   */
+  OscillatorVoice(const juce::AudioBuffer<float>& lfo_buffer,
+                  VoiceBus& voice_bus);
   bool canPlaySound(juce::SynthesiserSound* sound) override;
 
   /**
-   * Update parameters based on current state.
-   * Typically should be called at start of each block.
+   * Update the parts of the voice affected by the changed parameters.
+   * Should be called at the start of a block, only when something changed.
+   * Pass every parameter after Prepare.
+   */
+  void Configure(const ParameterTable& params, const ParameterChanges& changes);
+
+  /**
+   * @param sample_rate host sample rate
+   * @param blockSize Number of samples to expect per buffer
+   */
+  void Prepare(double sample_rate, int blockSize);
+
+  /**
+   * The most the voice runs at (a power of 2 up to kMaxOversample). Each note
+   * runs at the lowest factor that keeps it clean (see PickOversampleFactor),
+   * up to this. Doesn't allocate, so it can change between blocks.
    */
-  void Configure(const juce::AudioProcessorValueTreeState& apvts);
+  void set_max_oversample_factor(int factor);
 
   /**
-   *
-   * @param blockSize Number of samples to expect per buffer (needed for
-   * oversampler)
+   * Filter in filter_bank along with the other voices, rather than on its
+   * own. Then each renderNextBlock only gets as far as adding the block to
+   * the bank, and FinishBlock does the rest once the bank has processed it.
+   * nullptr (the default) filters on its own.
    */
-  void SetBlockSize(int blockSize);
+  void set_filter_bank(OTAFilterBank* filter_bank) {
+    filter_bank_ = filter_bank;
+  }
 
   void startNote(int midiNoteNumber, float velocity,
                  [[maybe_unused]] juce::SynthesiserSound* sound,
@@ -43,18 +93,84 @@ struct OscillatorVoice : juce::SynthesiserVoice {
   void controllerMoved([[maybe_unused]] int controllerNumber,
                        [[maybe_unused]] int newControllerValue) override;
 
+  /**
+   * Renders into the shared voice bus (at the oversampled rate) rather than
+   * outputBuffer.
+   */
   void renderNextBlock(juce::AudioBuffer<float>& outputBuffer, int startSample,
                        int numSamples) override;
 
+  /**
+   * The rest of the last renderNextBlock, after the filter bank has
+   * processed it. Does nothing if it didn't go through the bank.
+   */
+  void FinishBlock();
+
   // Test-only accessor to inspect internal generator state
   // todo below comment needed?
   // NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
   WaveGenerator<false>& getWaveGeneratorForTest() { return waveGenerator_; }
 
  private:
-  juce::AudioBuffer<float> env1_buffer_;
-  juce::AudioBuffer<float> env2_buffer_;
+  /**
+   * renderNextBlock at kFactor times the host rate.
+   */
+  template <int kFactor>
+  void RenderOversampled(int startSample, int numSamples);
+  /**
+   * The part of RenderOversampled after the filter: the VCA, and adding into
+   * the voice bus.
+   */
+  template <int kFactor>
+  void FinishOversampled(int startSample, int numSamples);
+  /**
+   * Free the voice straight away.
+   */
+  void EndNote();
+  /**
+   * PickOversampleFactor for note with the voice's settings, up to
+   * max_oversample_factor_.
+   */
+  int PickOversampleFactor(int note) const;
+  /**
+   * Switch the playing note to the factor PickOversampleFactor picks for it
+   * now, crossfading over the next block.
+   */
+  void UpdateOversampleFactor();
+  /**
+   * Run the voice at factor times the host rate (a power of 2 up to
+   * kMaxOversample), straight away.
+   */
+  void SetOversampleFactor(int factor);
+  /**
+   * The rate the generators' pitch is set from. It has always been the host
+   * rate at kDefaultOversample, so it scales to keep the same tuning at
+   * every factor.
+   */
+  double PitchSampleRate() const;
+
+  int max_oversample_factor_ = kDefaultOversample;
+  int oversample_factor_ = kDefaultOversample;
+  // the factor the last block was rendered at when it has changed since, so
+  // the next block crossfades from its bus. 0 when it hasn't.
+  int crossfade_from_ = 0;
+  // RenderOversampled for oversample_factor_
+  void (OscillatorVoice::*render_oversampled_)(int, int) =
+      &OscillatorVoice::RenderOversampled<kDefaultOversample>;
+  // FinishOversampled for oversample_factor_
+  void (OscillatorVoice::*finish_oversampled_)(int, int) =
+      &OscillatorVoice::FinishOversampled<kDefaultOversample>;
+  // see set_filter_bank
+  OTAFilterBank* filter_bank_ = nullptr;
+  // the block waiting in filter_bank_ for FinishBlock. 0 samples when none
+  // is.
+  int pending_start_sample_ = 0;
+  int pending_num_samples_ = 0;
+  // the envelopes, the LFO and the modulator (VCO 2 when cross modding) at
+  // the oversampled rate, for the generators, filters and VCA
+  ModulationBus mod_bus_;
   const juce::AudioBuffer<float>& lfo_buffer_;
+  VoiceBus& voice_bus_;
   // sub-sample accurate sample indices for the current block of when the
   // secondary's resets should occur.
   // Be warned - This can contain a negative value
@@ -63,18 +179,39 @@ struct OscillatorVoice : juce::SynthesiserVoice {
   // todo: do we actually need CriticalSection?
   //   I don't think it's written concurrently...
   juce::Array<float> hard_sync_reset_sample_indices_;
-  // modulator buffer
-  // todo do we actually need this if we already hae oversample buffer?
-  juce::AudioBuffer<float> wave2_buffer_;
   juce::AudioBuffer<float> oversample_buffer_;
   WaveGenerator<false> waveGenerator_;
   WaveGenerator<false> wave2Generator_;
   OTAFilterTPTNewtonRaphson filter_tpt_;
   OTAFilterDelayedFeedback filter_dfb_;
   int filter_type_ = 1;  // 0: DFB, 1: TPT, 2: Disabled
-  const juce::AudioBuffer<float>* filter_env_buffer_ = nullptr;
-  Downsampler downsampler_;
+  OversampleSettings oversample_settings_;
   AnalogADSR envelope_;
   AnalogADSR envelope2_;
 };
+
+/**
+ * Renders its OscillatorVoices in two passes, so their TPT filters can run
+ * together in an OTAFilterBank: every voice renders up to its filter, the
+ * bank filters them all, then every voice finishes its block.
+ */
+struct OscillatorSynthesiser : juce::Synthesiser {
+  /**
+   * @param filter_bank given to the voices as they're added
+   */
+  explicit OscillatorSynthesiser(OTAFilterBank& filter_bank);
+
+  /**
+   * Add an OscillatorVoice, which filters in the bank from then on.
+   */
+  void AddVoice(OscillatorVoice* voice);
+
+ protected:
+  using juce::Synthesiser::renderVoices;
+  void renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample,
+                    int numSamples) override;
+
+ private:
+  OTAFilterBank& filter_bank_;
+};
 }  // namespace audio_plugin
\ No newline at end of file
@@ -10,7 +10,7 @@ https://forum.juce.com/t/open-source-square-waves-for-the-juceplugin/19915/8
 
 #include "WaveGenerator.h"
 
-#include "../Constants.h"
+#include "../dsp/FastMath.h"
 
 namespace audio_plugin {
 constexpr double DELTA{.0000001};
@@ -61,6 +61,93 @@ inline double GetTriangle(double angle) {
   return sample;
 }
 
+// the same waves over a phase accumulator period (0 to 2^32 for 0 to 4PI),
+// in float. Reading the phase as signed shifts it by half a period for free,
+// and int32 (unlike uint32) converts in SIMD.
+template <WaveType kWave>
+float WaveAtPhase(const uint32_t phase, const uint32_t pulse_width_phase) {
+  if constexpr (kWave == sawFall || kWave == sawRise) {
+    const auto saw = static_cast<float>(static_cast<int32_t>(phase)) *
+                     (1.f / 2147483648.f);
+    if constexpr (kWave == sawRise) return -saw;
+    return saw;
+  } else if constexpr (kWave == triangle) {
+    // distance from the trough at 3PI, scaled to -1 .. 1
+    const auto from_trough = static_cast<int32_t>(phase + 0xC0000000u);
+    return 1 - std::abs(static_cast<float>(from_trough)) *
+                   (1.f / 1073741824.f);
+  } else if constexpr (kWave == square) {
+    return phase >= pulse_width_phase ? -1.f : 1.f;
+  } else {
+    const auto angle =
+        static_cast<float>(phase) *
+        static_cast<float>(2 * juce::MathConstants<double>::twoPi /
+                           4294967296.);
+    // unlike sinf this inlines and vectorises
+    return Sin<MathQuality::kHigh>(angle);
+  }
+}
+
+// phase increment for an angle delta. It's well under half a period so it
+// fits an int32. Negative when through-zero cross mod takes the pitch below
+// zero, so the wave runs backwards. Worked out in double: float would round
+// off the low bits, and the phase would drift from the angle.
+inline int32_t PhaseIncrement(const double radians) {
+  constexpr auto kPhasePerRadian =
+      4294967296. / (2 * juce::MathConstants<double>::twoPi);
+  constexpr auto kLimit = 2147483647.;
+  return static_cast<int32_t>(
+      std::clamp(radians * kPhasePerRadian, -kLimit, kLimit));
+}
+
+// BuildWaveKernel dispatch: kernels are indexed by
+// wave type + 6 * (mode + 4 * (sync primary + 2 * (pwm + 2 * pitch mod)))
+constexpr std::size_t kNumWaveTypes = 6;
+constexpr std::size_t kNumWaveModes = 4;
+constexpr std::size_t kNumPhaseKernels = kNumWaveTypes * kNumWaveModes * 8;
+
+constexpr std::size_t PhaseKernelIndex(const WaveType wave,
+                                       const WaveMode mode,
+                                       const bool sync_primary,
+                                       const bool pulse_width_modulated,
+                                       const bool pitch_modulated) {
+  return static_cast<std::size_t>(wave) +
+         kNumWaveTypes *
+             (static_cast<std::size_t>(mode) +
+              kNumWaveModes * (static_cast<std::size_t>(sync_primary) +
+                               2 * (static_cast<std::size_t>(
+                                        pulse_width_modulated) +
+                                    2 * static_cast<std::size_t>(
+                                            pitch_modulated))));
+}
+
+constexpr WaveType KernelWaveType(const std::size_t index) {
+  return static_cast<WaveType>(index % kNumWaveTypes);
+}
+
+// several indices share a kernel where the setting makes no difference, so
+// fewer get compiled
+constexpr WaveMode KernelWaveMode(const std::size_t index) {
+  // no discontinuities to find
+  if (KernelWaveType(index) == sine || KernelWaveType(index) == random) {
+    return NO_ANTIALIAS;
+  }
+  return static_cast<WaveMode>(index / kNumWaveTypes % kNumWaveModes);
+}
+
+constexpr bool KernelSyncPrimary(const std::size_t index) {
+  return index / (kNumWaveTypes * kNumWaveModes) % 2 == 1;
+}
+
+constexpr bool KernelPulseWidthModulated(const std::size_t index) {
+  return KernelWaveType(index) == square &&
+         index / (kNumWaveTypes * kNumWaveModes * 2) % 2 == 1;
+}
+
+constexpr bool KernelPitchModulated(const std::size_t index) {
+  return index / (kNumWaveTypes * kNumWaveModes * 4) % 2 == 1;
+}
+
 inline double GetSquare(const double angle, const double pulse_width) {
   if (angle >= juce::MathConstants<double>::twoPi * pulse_width) return -1;
   return 1;
@@ -68,15 +155,10 @@ inline double GetSquare(const double angle, const double pulse_width) {
 
 template <bool IsLFO>
 WaveGenerator<IsLFO>::WaveGenerator(
-    const juce::AudioBuffer<float>& lfo_buffer, const juce::AudioBuffer<float>& env1_buffer,
-    const juce::AudioBuffer<float>& env2_buffer,
-    const juce::AudioBuffer<float>& modulator_buffer,
+    const ModulationBus& mod_bus,
     juce::Array<float>& hard_sync_reset_sample_indices)
   requires(!IsLFO)
-    : lfo_buffer_{lfo_buffer},
-      env1_buffer_(env1_buffer),
-      env2_buffer_(env2_buffer),
-      modulator_buffer_{modulator_buffer},
+    : mod_bus_{mod_bus},
       hard_sync_reset_sample_indices_{hard_sync_reset_sample_indices} {
   history_length_ = 500;
   sample_rate_ = 0;
@@ -152,13 +234,30 @@ void WaveGenerator<IsLFO>::set_wave_type(const WaveType wave_type) {
     blep_generator_.set_return_derivative(false);
 }
 
+template <bool IsLFO>
+void WaveGenerator<IsLFO>::set_phase_accumulator_enabled(const bool enabled) {
+  phase_accumulator_enabled_ = enabled;
+}
+
 template <bool IsLFO>
 void WaveGenerator<IsLFO>::set_mode(const WaveMode mode) {
+  if (mode == mode_) return;
+  // the last sample, before gain: POLYBLEP's is still held back (or waiting
+  // to be flushed), the other modes' was the end of the last block
+  const auto held_back = mode_ == POLYBLEP || poly_blep_flush_;
+  const auto held = held_back ? poly_blep_held_sample_ : wave.getLast();
+  const auto old_gain = gain_stage();
   mode_ = mode;
-  // BUILD the appropriate BLEP step ....
-  if (mode_ == ANTIALIAS) {
-    blep_generator_.BuildBlep();
+  if (mode_ != ANTIALIAS) {
+    // don't leave corrections behind to pop out if AA is turned back on
+    blep_generator_.Clear();
   }
+  // carried over at the new gain. Going into POLYBLEP, the first block
+  // starts by repeating it rather than with a stale held sample. Coming out,
+  // it hasn't been output yet, so the next block flushes it.
+  poly_blep_held_sample_ = held * old_gain / gain_stage();
+  poly_blep_current_ = 0;
+  poly_blep_flush_ = held_back && mode_ != POLYBLEP;
 }
 
 template <bool IsLFO>
@@ -166,6 +265,57 @@ MinBlepGenerator* WaveGenerator<IsLFO>::blep_generator() {
   return &blep_generator_;
 }
 
+template <bool IsLFO>
+const juce::Array<MinBlepGenerator::BlepOffset>&
+WaveGenerator<IsLFO>::detected_bleps() const {
+  return detected_bleps_;
+}
+
+template <bool IsLFO>
+void WaveGenerator<IsLFO>::clear_detected_bleps() {
+  detected_bleps_.clearQuick();
+}
+
+template <bool IsLFO>
+void WaveGenerator<IsLFO>::AddBlep(const MinBlepGenerator::BlepOffset& blep) {
+  switch (mode_) {
+    case ANTIALIAS:
+      blep_generator_.AddBlep(blep);
+      break;
+    case BUILD_AA:
+      detected_bleps_.add(blep);
+      break;
+    case POLYBLEP:
+      AddPolyBlep(blep);
+      break;
+    case NO_ANTIALIAS:
+      break;
+  }
+}
+
+template <bool IsLFO>
+void WaveGenerator<IsLFO>::AddPolyBlep(
+    const MinBlepGenerator::BlepOffset& blep) {
+  // how far past the discontinuity the sample being built is, in samples
+  const auto after = blep.offset + build_sample_ + 1;
+  jassert(after >= 0 && after <= 1 + DELTA);
+  const auto before = 1 - after;
+
+  // 2 sample polynomial approximations of the bandlimited step's and ramp's
+  // residuals (polyBLEP and polyBLAMP). pos_change_magnitude is the value
+  // before the step minus the value after it.
+  poly_blep_current_ += blep.pos_change_magnitude * before * before / 2 +
+                        blep.vel_change_magnitude * before * before * before / 6;
+  const auto previous_correction = static_cast<float>(
+      -blep.pos_change_magnitude * after * after / 2 +
+      blep.vel_change_magnitude * after * after * after / 6);
+  if (build_sample_ > 0) {
+    wave.getRawDataPointer()[build_sample_ - 1] += previous_correction;
+  } else {
+    poly_blep_held_sample_ += previous_correction;
+  }
+}
+
 template <bool IsLFO>
 void WaveGenerator<IsLFO>::set_pulse_width_mod_type(
     const PulseWidthModType type) {
@@ -288,11 +438,21 @@ juce::Array<float> WaveGenerator<IsLFO>::history() {
 }
 
 template <bool IsLFO>
-void WaveGenerator<IsLFO>::PrepareToPlay(double new_sample_rate) {
+void WaveGenerator<IsLFO>::PrepareToPlay(const double new_sample_rate,
+                                         const int max_block_size) {
   sample_rate_ = new_sample_rate;
 
-  // BUILD the appropriate BLEP step ....
-  blep_generator_.BuildBlep();
+  // LFO doesn't do blepping
+  if constexpr (!IsLFO) {
+    blep_generator_.Prepare(max_block_size);
+  } else {
+    juce::ignoreUnused(max_block_size);
+  }
+}
+
+template <bool IsLFO>
+void WaveGenerator<IsLFO>::set_sample_rate(const double new_sample_rate) {
+  sample_rate_ = new_sample_rate;
 }
 template <bool IsLFO>
 double WaveGenerator<IsLFO>::cross_mod() const {
@@ -318,15 +478,147 @@ template <bool IsLFO>
 void WaveGenerator<IsLFO>::RenderNextBlock(
     juce::AudioBuffer<float>& outputBuffer, const int startSample,
     const int numSamples) {
+  if (!BuildBlock(startSample, numSamples)) return;
+
+  // dc blocker (1st-order high-pass)
+  // this is needed because (afaict) a properly-implemented minblep adds
+  // a DC offset due to the effect of multiple bleps (which themselves
+  // have a positive bias) adding together, which gets worse as the note
+  // gets higher.
+  if (dc_blocking()) {
+    const auto samples = wave.getRawDataPointer();
+    // keep the state in a local for the loop
+    auto dc_blocker = dc_blocker_;
+    for (int i = 0; i < numSamples; ++i) {
+      samples[i] = dc_blocker.Process(samples[i]);
+    }
+    dc_blocker_ = dc_blocker;
+  }
+
+  // COPY it to the outputbuffer ....
+  // todo do the gain staging more intelligently - I think one reason we need it
+  //  is because the minblep can cause overshoots.
+  //  but we shouldn't apply it to the lfo...
+  //  athis is not really efficient way to do this.
+  const auto gain = gain_stage();
+  if (mode_ == POLYBLEP) {
+    // a sample late - see poly_blep_held_sample_
+    outputBuffer.addSample(0, startSample, poly_blep_held_sample_ * gain);
+    outputBuffer.addFrom(0, startSample + 1, wave.getRawDataPointer(),
+                         numSamples - 1, gain);
+    poly_blep_held_sample_ = wave.getLast();
+  } else {
+    outputBuffer.addFromWithRamp(0, startSample, wave.getRawDataPointer(),
+                                 numSamples, gain, gain);
+  }
+
+  FinishBlock(numSamples);
+
+#if JUCE_DEBUG
+
+  // Using dB -12 to +3 ... normalized to 0..1 for indicator
+  float RMS = outputBuffer.getRMSLevel(0, 0, outputBuffer.getNumSamples());
+
+  // Aaron - wtf?  How do we get NaN .. but we do .... hmmmm
+  if (isnanf(RMS)) {
+    DBG("NaN " + juce::String(outputBuffer.getNumSamples()) + " " +
+        juce::String(*outputBuffer.getReadPointer(0, 0)));
+  }
+
+  if (RMS > 5 || RMS < 0) {
+    DBG("WOAH! " + juce::String(RMS) + " " +
+        juce::String(*outputBuffer.getReadPointer(0, 0)));
+  }
+
+#endif
+}
+
+template <bool IsLFO>
+void WaveGenerator<IsLFO>::RenderMixed(
+    const std::initializer_list<WaveGenerator*> generators,
+    juce::AudioBuffer<float>& outputBuffer, const int startSample,
+    const int numSamples, const float* vca)
+  requires(!IsLFO)
+{
+  // what RenderNextBlock would copy out of each generator
+  struct Source {
+    WaveGenerator* generator;
+    float* samples;
+    float gain;
+    bool dc_blocking;
+    // POLYBLEP is output a sample late
+    bool delayed;
+    DcBlocker dc_blocker;
+    float held_sample;
+  };
+  constexpr auto kMaxSources = 2;
+  jassert(generators.size() <= kMaxSources);
+  std::array<Source, kMaxSources> sources{};
+  int num_sources = 0;
+  for (auto* generator : generators) {
+    if (!generator->BuildBlock(startSample, numSamples)) continue;
+    sources[static_cast<std::size_t>(num_sources++)] = {
+        .generator = generator,
+        .samples = generator->wave.getRawDataPointer(),
+        .gain = generator->gain_stage(),
+        .dc_blocking = generator->dc_blocking(),
+        .delayed = generator->mode_ == POLYBLEP,
+        .dc_blocker = generator->dc_blocker_,
+        .held_sample = generator->poly_blep_held_sample_};
+  }
+
+  // The arithmetic is the same as the separate passes', in the same order.
+  // The products get their own statements so they're rounded on their own,
+  // like juce's addFrom does, rather than contracted into a multiply-add.
+  auto* output = outputBuffer.getWritePointer(0, startSample);
+  for (int i = 0; i < numSamples; ++i) {
+    auto sum = 0.f;
+    for (int s = 0; s < num_sources; ++s) {
+      auto& source = sources[static_cast<std::size_t>(s)];
+      auto sample = source.samples[i];
+      if (source.dc_blocking) {
+        sample = source.dc_blocker.Process(sample);
+        // the wave is left dc blocked, same as RenderNextBlock leaves it
+        source.samples[i] = sample;
+      }
+      if (source.delayed) {
+        std::swap(sample, source.held_sample);
+      }
+      const auto scaled = sample * source.gain;
+      sum += scaled;
+    }
+    if (vca != nullptr) {
+      sum *= vca[i];
+    }
+    output[i] = sum;
+  }
+
+  for (int s = 0; s < num_sources; ++s) {
+    auto& source = sources[static_cast<std::size_t>(s)];
+    source.generator->dc_blocker_ = source.dc_blocker;
+    source.generator->poly_blep_held_sample_ = source.held_sample;
+    source.generator->FinishBlock(numSamples);
+  }
+}
+
+template <bool IsLFO>
+bool WaveGenerator<IsLFO>::BuildBlock(const int startSample,
+                                      const int numSamples) {
   jassert(sample_rate_ != 0.);
 
-  if (delta_base_ == 0.0) return;
+  if (delta_base_ == 0.0) return false;
 
   // todo FIX !!!!
   if (volume_ == 0. && gain_last_[0] == 0. && gain_last_[1] == 0. &&
       blep_generator_.IsClear())
-    return;
+    return false;
 
+  if constexpr (!IsLFO) {
+    // the modulation sources line up with the output buffer
+    mod_bus_start_ = startSample;
+  } else {
+    juce::ignoreUnused(startSample);
+  }
   BuildWave(numSamples);
 
   // ADD BAND-LIMITED (minBLEP) transitions :::
@@ -334,92 +626,52 @@ void WaveGenerator<IsLFO>::RenderNextBlock(
   if constexpr (!IsLFO) {
     if (mode_ == ANTIALIAS) {
       // Since we KNOW the intended F ... relative to F(sampling)
-      // We can tweak the minBLEP to limit any harmonic above 4*(desired F)
-
-      // TUNE the blep ....
-      double freq = current_pitch_hz();               // Current, playing, Freq
-      double relativeFreq = 2 * freq / sample_rate_;  // 2 for Nyquist ...
-      relativeFreq *= kBlepOvertoneDepth;  // ie - up to the 3nd harmonic (2*2*2
-      // -> 8x fundamental)
-
-      blep_generator_.set_limiting_freq(
-          static_cast<float>(relativeFreq));  // up to the 2nd harmonic ..
+      // we can pick the shortest kernel that still keeps its aliasing
+      // inaudible. Bleps use the table current when they're added, so this
+      // applies to the ones found in the next block.
+      blep_generator_.SelectTable(current_pitch_hz() / sample_rate_);
       blep_generator_.ProcessBlock(wave.getRawDataPointer(), numSamples);
-
-      // dc blocker (1st-order high-pass): y[n] = x[n] - x[n-1] + R*y[n-1]
-      // this is needed because (afaict) a properly-implemented minblep adds
-      // a DC offset due to the effect of multiple bleps (which themselves
-      // have a positive bias) adding together, which gets worse as the note
-      // gets higher.
-      if (dc_blocker_enabled_) {
-        const auto samples = wave.getRawDataPointer();
-
-        // Preserve last raw input of this block (before we overwrite samples)
-        const float lastInputRaw = samples[numSamples - 1];
-
-        // Use persistent states from previous block
-        auto xPrev = static_cast<float>(prev_buffer_last_sample_raw_);
-        auto yPrev = static_cast<float>(prev_buffer_last_sample_filtered_);
-
-        for (int i = 0; i < numSamples; ++i) {
-          constexpr float r = 0.995f;
-          const float x = samples[i];
-          const float y = (x - xPrev) + r * yPrev;
-          samples[i] = y;
-          xPrev = x;
-          yPrev = y;
-        }
-
-        // Update states for next block
-        prev_buffer_last_sample_raw_ = static_cast<double>(lastInputRaw);
-        prev_buffer_last_sample_filtered_ = static_cast<double>(yPrev);
-      }
+    }
+    if (poly_blep_flush_) {
+      // the sample POLYBLEP held back is a sample behind this block's first
+      // one. Dropping it would skip a sample, so it's averaged in instead.
+      auto& first = wave.getReference(0);
+      first = (poly_blep_held_sample_ + first) / 2;
+      poly_blep_flush_ = false;
     }
   }
+  return true;
+}
 
-  // BUILD ::::
-  for (int i = 0; i < numSamples; i = i + 20) {
-    // just adding a sample every 20 or so to the history
-    history_.add(wave.getUnchecked(i));
-
-    if (history_.size() > history_length_) history_.remove(0);
-  }
+template <bool IsLFO>
+bool WaveGenerator<IsLFO>::dc_blocking() const {
+  // only minBLEP needs it
+  return !IsLFO && mode_ == ANTIALIAS && dc_blocker_enabled_;
+}
 
-  // COPY it to the outputbuffer ....
-  // todo do the gain staging more intelligently - I think one reason we need it
-  //  is because the minblep can cause overshoots.
-  //  but we shouldn't apply it to the lfo...
-  //  athis is not really efficient way to do this.
+template <bool IsLFO>
+float WaveGenerator<IsLFO>::gain_stage() const {
   // this fixed amount helps to prevent clipping at this stage caused by
   // minblep-induced overshoots
   // + the combination of the 2 oscillators.
   // It is quite a large attenuation because the worst case is about a F0 saw
   // note,
   //  which produces a very loud blep
-  const auto gain_stage = mode_ == ANTIALIAS ? .2f : 1.f;
-  outputBuffer.addFromWithRamp(0, startSample, wave.getRawDataPointer(),
-                               numSamples, gain_stage, gain_stage);
-
-  // todo: we aren't using gain_last_ / volume right now
-  gain_last_[0] = volume_;
-
-#if JUCE_DEBUG
-
-  // Using dB -12 to +3 ... normalized to 0..1 for indicator
-  float RMS = outputBuffer.getRMSLevel(0, 0, outputBuffer.getNumSamples());
+  return mode_ == ANTIALIAS ? .2f : 1.f;
+}
 
-  // Aaron - wtf?  How do we get NaN .. but we do .... hmmmm
-  if (isnanf(RMS)) {
-    DBG("NaN " + juce::String(outputBuffer.getNumSamples()) + " " +
-        juce::String(*outputBuffer.getReadPointer(0, 0)));
-  }
+template <bool IsLFO>
+void WaveGenerator<IsLFO>::FinishBlock(const int numSamples) {
+  // BUILD ::::
+  for (int i = 0; i < numSamples; i = i + 20) {
+    // just adding a sample every 20 or so to the history
+    history_.add(wave.getUnchecked(i));
 
-  if (RMS > 5 || RMS < 0) {
-    DBG("WOAH! " + juce::String(RMS) + " " +
-        juce::String(*outputBuffer.getReadPointer(0, 0)));
+    if (history_.size() > history_length_) history_.remove(0);
   }
 
-#endif
+  // todo: we aren't using gain_last_ / volume right now
+  gain_last_[0] = volume_;
 }
 
 template <bool IsLFO>
@@ -465,18 +717,27 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
     }
   }
 
+  if constexpr (!IsLFO) {
+    if (phase_accumulator_enabled_ && hard_sync_mode_ != SECONDARY) {
+      BuildWaveFromPhase(numSamples, phaseShiftPerSample);
+      return;
+    }
+  }
+
   std::conditional_t<IsLFO, std::monostate, const float*> lfo_data{};
   std::conditional_t<IsLFO, std::monostate, const float*> env1_data{};
   std::conditional_t<IsLFO, std::monostate, const float*> env2_data{};
   std::conditional_t<IsLFO, std::monostate, const float*> modulator_data{};
   if constexpr (!IsLFO) {
-    lfo_data = lfo_buffer_.getReadPointer(0);
-    env1_data = env1_buffer_.getReadPointer(0);
-    env2_data = env1_buffer_.getReadPointer(0);
-    modulator_data = modulator_buffer_.getReadPointer(0);
+    lfo_data = mod_bus_.Read(ModulationBus::kLfo) + mod_bus_start_;
+    env1_data = mod_bus_.Read(ModulationBus::kEnv1) + mod_bus_start_;
+    // todo: env2 reads env1, as it always has
+    env2_data = mod_bus_.Read(ModulationBus::kEnv1) + mod_bus_start_;
+    modulator_data = mod_bus_.Read(ModulationBus::kModulator) + mod_bus_start_;
   }
 
   for (int i = 0; i < numSamples; i++) {
+    build_sample_ = i;
     // this seems to be used to prevent adding 2 bleps for one sample
     bool hard_sync_blep_occurred = false;
 
@@ -485,27 +746,7 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
     // pitch_bend_actual_ += freqDelta;
     // TODO: account better for oversampling - this hardcoded amount isn't good
     if constexpr (!IsLFO) {
-      double mod = 0;
-      if (pitch_bend_lfo_mod_ != 0.) {
-        mod = static_cast<double>(lfo_data[i / kOversample]) *
-              pitch_bend_lfo_mod_;
-      } else {
-        mod = 0;
-      }
-      if (pitch_bend_env1_mod_ != 0.) {
-        mod += static_cast<double>(env1_data[i / kOversample]) *
-               pitch_bend_env1_mod_;
-      }
-      if (cross_mod_ > 0.001) {
-        // unlike the other modulation buffers, the modulator is oversampled.
-        // note blepping has already been applied to the modulator signal
-        // so the carrier only needs to deal with its own discontinuities like
-        // normal todo: is this reasoning actually correct for what blepping is
-        // needed?
-        // todo: this is not producing the expected sound...
-        mod += static_cast<double>(modulator_data[i]) * cross_mod_;
-      }
-      pitch_bend_actual_ = 1 + mod;
+      pitch_bend_actual_ = PitchBendAt(i, lfo_data, env1_data, modulator_data);
     }
 
     if (fabs(pitch_bend_actual_ - 1) < .00001) pitch_bend_actual_ = 1;
@@ -571,16 +812,25 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
           const double change_in_delta =
               (angle_delta_after_roll - angle_delta_before_roll) *
               (1 / (2 * delta));
-          const double depth_limited = blep_generator_.proportional_blep_freq_;
 
-          // actualCurrentAngleDelta below is added to compensate for higher
-          // order nonlinearities 66 here was experimentally determined ...
-          blep.vel_change_magnitude = 66 * change_in_delta *
-                                      (1 / depth_limited) *
-                                      actual_current_angle_delta_;
+          if (mode_ == POLYBLEP) {
+            // this sample is (1 - perc_before_roll) samples past the reset
+            // (see below)
+            blep.offset = -perc_before_roll - i;
+            // change in slope per sample
+            blep.vel_change_magnitude =
+                2 * change_in_delta * actual_current_angle_delta_;
+          } else {
+            // actualCurrentAngleDelta below is added to compensate for
+            // higher order nonlinearities 66 here was experimentally
+            // determined ...
+            blep.vel_change_magnitude = 66 * change_in_delta *
+                                        blep_generator_.blamp_scale() *
+                                        actual_current_angle_delta_;
+          }
 
           // ADD
-          blep_generator_.AddBlep(blep);
+          AddBlep(blep);
 
           // MOVE the UNSKEWED ANGLE
           // so that it will actually roll over at this sub-sample ...
@@ -617,20 +867,34 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
 
     // LFO does not hard sync or anti-alias
     if constexpr (!IsLFO) {
+      // Crossings are looked for going forwards. When through-zero cross mod
+      // runs the wave backwards, they're looked for in the period mirrored
+      // about 0, where a backward crossing is a forward one. The saw and
+      // triangle's thresholds are their own mirror images; the square's pulse
+      // width isn't, so it's mirrored below.
+      const bool backward = actual_current_angle_delta_ < 0;
+      const auto mirror = [&](const double angle) {
+        return backward && angle > 0
+                   ? 2 * juce::MathConstants<double>::twoPi - angle
+                   : angle;
+      };
+      const double now = mirror(current_angle_skewed_);
+      const double before = mirror(last_angle_skewed_);
+      // and the steps go the other way
+      const double direction = backward ? -1 : 1;
+
       if (hard_sync_mode_ == PRIMARY) {
         // if we rolled over, write the subsample-accurate index of when that
         // happened
-        if (current_angle_skewed_ < last_angle_skewed_) {
+        if (now < before) {
           // we rolled over - what's the exact sub-sample?
           // todo: probably a more efficient way to calculate this
-          const auto actual_current_angle_delta_skewed =
-              current_angle_skewed_ - last_angle_skewed_;
+          const auto actual_current_angle_delta_skewed = now - before;
           // this will be a value between 0 and
           // actual_current_angle_delta_skewed, telling us at how many radians
           // into the sample the reset occurred todo: maybe we should stick with
           // floats here instead of doubles
-          const auto reset_radians =
-              actual_current_angle_delta_skewed - current_angle_skewed_;
+          const auto reset_radians = actual_current_angle_delta_skewed - now;
           // scaling above value to 0 - 1 tells us exactly where in the
           // subsample the reset occurred in terms of samples rather than
           // radians
@@ -648,91 +912,51 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
       if (mode_ != NO_ANTIALIAS && hard_sync_blep_occurred == false &&
           wave_type_ != sine) {
         double actualCurrentAngleDeltaSkewed =
-            current_angle_skewed_ - last_angle_skewed_;
+            now - before;
         if (actualCurrentAngleDeltaSkewed < 0)
           actualCurrentAngleDeltaSkewed +=
               2 * juce::MathConstants<double>::twoPi;
 
         // ROLLED through 2*PI
         if (wave_type_ == square) {
-          if (pulse_width_mod_ != 0.) {
-            switch (pulse_width_mod_type_) {
-              case env2Plus:
-                pulse_width_actual_ =
-                    static_cast<double>(env2_data[i / kOversample]) *
-                    pulse_width_mod_;
-                break;
-              case env2Minus:
-                pulse_width_actual_ =
-                    static_cast<double>(env2_data[i / kOversample]) *
-                    -pulse_width_mod_;
-                break;
-              case env1Plus:
-                pulse_width_actual_ =
-                    static_cast<double>(env1_data[i / kOversample]) *
-                    pulse_width_mod_;
-                break;
-              case env1Minus:
-                pulse_width_actual_ =
-                    static_cast<double>(env1_data[i / kOversample]) *
-                    -pulse_width_mod_;
-                break;
-              case lfo:
-                pulse_width_actual_ =
-                    (static_cast<double>(lfo_data[i / kOversample]) / 2 + 1) *
-                    pulse_width_mod_;
-                break;
-              case manual:
-                pulse_width_actual_ = pulse_width_mod_;
-                break;
-            }
-          } else {
-            pulse_width_actual_ = 0.5;
-          }
+          pulse_width_actual_ = PulseWidthAt(i, lfo_data, env1_data, env2_data);
           // :: SQUARE rolls twice - at pulse_width and 1 ::::
-          const double threshold1 =
-              juce::MathConstants<double>::twoPi * pulse_width_actual_;
+          const double threshold1 = mirror(
+              juce::MathConstants<double>::twoPi * pulse_width_actual_);
           constexpr double threshold2 = 2 * juce::MathConstants<double>::twoPi;
 
           auto check_rollover = [&](const double threshold,
                                     const double magnitude) {
-            // adjust for wrapping if needed, but current_angle_skewed_ and
-            // last_angle_skewed_ should be in the same period usually unless
-            // freq is very high. Actually, current_angle_skewed_ is fmodded to
-            // [0, 2pi].
+            // adjust for wrapping if needed, but now and before should be in
+            // the same period usually unless freq is very high. Actually, now
+            // is fmodded to [0, 2pi].
 
             bool crossed = false;
             double percAfterRoll = 0;
 
-            if (last_angle_skewed_ < threshold &&
-                current_angle_skewed_ >= threshold) {
+            if (before < threshold && now >= threshold) {
               crossed = true;
-              percAfterRoll = (current_angle_skewed_ - threshold) /
-                              actualCurrentAngleDeltaSkewed;
-            } else if (current_angle_skewed_ < last_angle_skewed_) {
+              percAfterRoll = (now - threshold) / actualCurrentAngleDeltaSkewed;
+            } else if (now < before) {
               // Wrapped around 2PI
               if (threshold >= threshold2 - 1e-9) {
                 crossed = true;
-                percAfterRoll =
-                    current_angle_skewed_ / actualCurrentAngleDeltaSkewed;
-              } else if (last_angle_skewed_ < threshold ||
-                         current_angle_skewed_ >= threshold) {
+                percAfterRoll = now / actualCurrentAngleDeltaSkewed;
+              } else if (before < threshold || now >= threshold) {
                 // This case is trickier if it wraps and crosses threshold1 in
                 // one sample. For now assume freq < sample_rate.
-                if (last_angle_skewed_ < threshold) {
+                if (before < threshold) {
                   crossed = true;
-                  percAfterRoll = (current_angle_skewed_ +
-                                   (threshold2 - last_angle_skewed_) -
-                                   (threshold - last_angle_skewed_)) /
+                  percAfterRoll = (now + (threshold2 - before) -
+                                   (threshold - before)) /
                                   actualCurrentAngleDeltaSkewed;
                   // Simplify:
-                  percAfterRoll =
-                      (current_angle_skewed_ + threshold2 - threshold) /
-                      actualCurrentAngleDeltaSkewed;
-                } else if (current_angle_skewed_ >= threshold) {
-                  crossed = true;
-                  percAfterRoll = (current_angle_skewed_ - threshold) /
+                  percAfterRoll = (now + threshold2 - threshold) /
                                   actualCurrentAngleDeltaSkewed;
+                } else if (now >= threshold) {
+                  crossed = true;
+                  percAfterRoll =
+                      (now - threshold) / actualCurrentAngleDeltaSkewed;
                 }
               }
             }
@@ -742,19 +966,19 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
               blep.offset = percAfterRoll - static_cast<double>(i + 1);
               blep.pos_change_magnitude = magnitude;
               blep.vel_change_magnitude = 0;
-              blep_generator_.AddBlep(blep);
+              AddBlep(blep);
             }
           };
 
-          check_rollover(threshold1, -2);
-          check_rollover(threshold2, 2);
+          // falls at pulse_width, rises at the end of the period
+          check_rollover(threshold1, direction * 2);
+          check_rollover(threshold2, direction * -2);
         } else if (wave_type_ == sawRise || wave_type_ == sawFall)  // SAW
         {
           // SAW ROLLs only at PI
-          if (fmod(current_angle_skewed_,
-                   2 * juce::MathConstants<double>::twoPi) >
+          if (fmod(now, 2 * juce::MathConstants<double>::twoPi) >
                   actualCurrentAngleDeltaSkewed &&
-              fmod(current_angle_skewed_, juce::MathConstants<double>::twoPi) <
+              fmod(now, juce::MathConstants<double>::twoPi) <
                   actualCurrentAngleDeltaSkewed) {
             /*
             percAfterRoll is the fractional position (WITHING a single sample -
@@ -764,8 +988,7 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
             the roll.”
             */
             double percAfterRoll =
-                fmod(current_angle_skewed_,
-                     juce::MathConstants<double>::twoPi) /
+                fmod(now, juce::MathConstants<double>::twoPi) /
                 actualCurrentAngleDeltaSkewed;  // LINEAR interpolation
 
             // CALCULATE the OFFSET
@@ -780,42 +1003,37 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
 
             // MAGNITUDE of 1st order nonlinearity is 2 or -2 :::
             if (wave_type_ == sawRise)
-              blep.pos_change_magnitude = -2;
+              blep.pos_change_magnitude = direction * -2;
             else
-              blep.pos_change_magnitude = 2;
+              blep.pos_change_magnitude = direction * 2;
 
             // NO CHANGE to slope - 0
             blep.vel_change_magnitude = 0;
 
             // ADD
-            blep_generator_.AddBlep(blep);
+            AddBlep(blep);
           }
         } else if (wave_type_ == triangle) {
-          if (fmod(current_angle_skewed_ +
-                       juce::MathConstants<double>::twoPi / 2,
+          if (fmod(now + juce::MathConstants<double>::twoPi / 2,
                    2 * juce::MathConstants<double>::twoPi) <
                   actualCurrentAngleDeltaSkewed ||
-              fmod(current_angle_skewed_ +
-                       3 * juce::MathConstants<double>::twoPi / 2,
+              fmod(now + 3 * juce::MathConstants<double>::twoPi / 2,
                    2 * juce::MathConstants<double>::twoPi) <
                   actualCurrentAngleDeltaSkewed) {
             double aboveNonlinearity = 0;
             double percAfterRoll = 0;
 
-            if (fmod(current_angle_skewed_ +
-                         3 * juce::MathConstants<double>::twoPi / 2,
+            if (fmod(now + 3 * juce::MathConstants<double>::twoPi / 2,
                      2 * juce::MathConstants<double>::twoPi) <
                 actualCurrentAngleDeltaSkewed) {
               aboveNonlinearity =
-                  fmod(current_angle_skewed_ +
-                           3 * juce::MathConstants<double>::twoPi / 2,
+                  fmod(now + 3 * juce::MathConstants<double>::twoPi / 2,
                        2 * juce::MathConstants<double>::twoPi);
               percAfterRoll = aboveNonlinearity / actualCurrentAngleDeltaSkewed;
             } else  // 3*double_Pi/2
             {
               aboveNonlinearity =
-                  fmod(current_angle_skewed_ +
-                           juce::MathConstants<double>::twoPi / 2,
+                  fmod(now + juce::MathConstants<double>::twoPi / 2,
                        2 * juce::MathConstants<double>::twoPi);
               percAfterRoll = aboveNonlinearity / actualCurrentAngleDeltaSkewed;
             }
@@ -839,31 +1057,37 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
 
             blep.pos_change_magnitude = 0;
 
-            // SCALE the vel magnitude inversely with play speed
-            double depthLimited =
-                blep_generator_
-                    .proportional_blep_freq_;  // jlimit<double>(.1, .5,
-            // myBlepGenerator.proportionalBlepFreq);
-
-            // Assume nominal delta for all waves ... so ...
-            blep.vel_change_magnitude = sign * 121 * slope * (1 / depthLimited);
+            if (mode_ == POLYBLEP) {
+              // the triangle's slope is +-1/pi per radian, so it changes by
+              // 2/pi per radian at the corners
+              blep.vel_change_magnitude =
+                  sign * 2 / juce::MathConstants<double>::pi *
+                  actualCurrentAngleDeltaSkewed;
+            } else {
+              // Assume nominal delta for all waves ... so ...
+              blep.vel_change_magnitude =
+                  sign * 121 * slope * blep_generator_.blamp_scale();
+            }
 
             // ADD
-            blep_generator_.AddBlep(blep);
+            AddBlep(blep);
           }
         }
       }
     }
 
-    *waveData = static_cast<float>(GetValueAt(current_angle_skewed_));
+    const auto value = static_cast<float>(GetValueAt(current_angle_skewed_));
+    // the POLYBLEP correction is only ever non-zero in that mode
+    *waveData = value + static_cast<float>(poly_blep_current_);
+    poly_blep_current_ = 0;
 
     // UPDATE the tracking variables ...
     // Used or computing exact values at rolls, etc.
     last_angle_skewed_ =
         current_angle_skewed_;  // NOTE the previous angle, for calculations
-    last_sample_delta_ = static_cast<double>(*waveData) - last_sample_;
+    last_sample_delta_ = static_cast<double>(value) - last_sample_;
     last_sample_ = static_cast<double>(
-        *waveData);  // NOTE* the most recent sample, for computation purposes
+        value);  // NOTE* the most recent sample, for computation purposes
 
     waveData++;
 
@@ -871,6 +1095,346 @@ void WaveGenerator<IsLFO>::BuildWave(const int numSamples) {
   }
 }
 
+template <bool IsLFO>
+void WaveGenerator<IsLFO>::BuildWaveFromPhase(const int numSamples,
+                                              const double phaseShiftPerSample)
+  requires(!IsLFO)
+{
+  PhaseKernelInputs in;
+  in.lfo_data = mod_bus_.Read(ModulationBus::kLfo) + mod_bus_start_;
+  in.env1_data = mod_bus_.Read(ModulationBus::kEnv1) + mod_bus_start_;
+  in.modulator_data =
+      mod_bus_.Read(ModulationBus::kModulator) + mod_bus_start_;
+  in.phase_shift_per_sample = phaseShiftPerSample;
+
+  // the same pulse widths as PulseWidthAt, as data * scale + offset
+  // (env2 reads env1, same as BuildWave)
+  const float* env2_data =
+      mod_bus_.Read(ModulationBus::kEnv1) + mod_bus_start_;
+  in.pulse_width_offset = pulse_width_mod_;
+  if (pulse_width_mod_ == 0.) {
+    in.pulse_width_offset = 0.5;
+  } else {
+    switch (pulse_width_mod_type_) {
+      case env2Plus:
+        in.pulse_width_data = env2_data;
+        in.pulse_width_scale = pulse_width_mod_;
+        in.pulse_width_offset = 0;
+        break;
+      case env2Minus:
+        in.pulse_width_data = env2_data;
+        in.pulse_width_scale = -pulse_width_mod_;
+        in.pulse_width_offset = 0;
+        break;
+      case env1Plus:
+        in.pulse_width_data = in.env1_data;
+        in.pulse_width_scale = pulse_width_mod_;
+        in.pulse_width_offset = 0;
+        break;
+      case env1Minus:
+        in.pulse_width_data = in.env1_data;
+        in.pulse_width_scale = -pulse_width_mod_;
+        in.pulse_width_offset = 0;
+        break;
+      case lfo:
+        in.pulse_width_data = in.lfo_data;
+        in.pulse_width_scale = pulse_width_mod_ / 2;
+        break;
+      case manual:
+        break;
+    }
+  }
+
+  const bool pitch_modulated = pitch_bend_lfo_mod_ != 0. ||
+                               pitch_bend_env1_mod_ != 0. || cross_mod_ > 0.001;
+  const bool pulse_width_modulated =
+      wave_type_ == square && in.pulse_width_data != nullptr;
+
+  // one kernel per combination, picked once per block
+  using Kernel = void (WaveGenerator::*)(int, const PhaseKernelInputs&);
+  static constexpr auto kKernels =
+      []<std::size_t... I>(std::index_sequence<I...>) {
+        return std::array<Kernel, sizeof...(I)>{
+            &WaveGenerator::BuildWaveKernel<
+                KernelWaveType(I), KernelWaveMode(I), KernelSyncPrimary(I),
+                KernelPulseWidthModulated(I), KernelPitchModulated(I)>...};
+      }(std::make_index_sequence<kNumPhaseKernels>{});
+
+  const auto kernel =
+      kKernels[PhaseKernelIndex(wave_type_, mode_, hard_sync_mode_ == PRIMARY,
+                                pulse_width_modulated, pitch_modulated)];
+  (this->*kernel)(numSamples, in);
+}
+
+template <bool IsLFO>
+template <WaveType kWave, WaveMode kMode, bool kSyncPrimary,
+          bool kPulseWidthModulated, bool kPitchModulated>
+void WaveGenerator<IsLFO>::BuildWaveKernel(const int numSamples,
+                                           const PhaseKernelInputs& in)
+  requires(!IsLFO)
+{
+  constexpr bool kDetectBleps = kMode != NO_ANTIALIAS;
+  // everything but the bleps is worked out this many samples at a time. The
+  // phase and its increments are exact (or double), the wave values are
+  // float: 8 of them fill an AVX register.
+  constexpr std::size_t kLanes = 8;
+
+  float* waveData = wave.getRawDataPointer();
+  uint32_t phase = RadiansToPhase(current_angle_);
+  auto last_value = static_cast<float>(last_sample_);
+  auto last_value_delta = static_cast<float>(last_sample_delta_);
+
+  const auto cross_mod = cross_mod_ > 0.001 ? cross_mod_ : 0.;
+  const auto pulse_width_scale = static_cast<float>(in.pulse_width_scale);
+  const auto pulse_width_offset = static_cast<float>(in.pulse_width_offset);
+
+  std::array<double, kLanes> angle_deltas;
+  std::array<int32_t, kLanes> increments;
+  angle_deltas.fill(delta_base_ + in.phase_shift_per_sample);
+  increments.fill(PhaseIncrement(angle_deltas[0]));
+  std::array<uint32_t, kLanes> pulse_width_phases;
+  pulse_width_phases.fill(PulseWidthToPhase(in.pulse_width_offset));
+  std::array<uint32_t, kLanes> phases;
+  std::array<float, kLanes> values;
+
+  for (int start = 0; start < numSamples; start += static_cast<int>(kLanes)) {
+    const auto lanes = std::min(kLanes, static_cast<std::size_t>(numSamples - start));
+
+    if constexpr (kPitchModulated) {
+      for (std::size_t k = 0; k < kLanes; k++) {
+        // lanes past the end of the block repeat the last sample
+        const int i = start + static_cast<int>(std::min(k, lanes - 1));
+        auto pitch_bend =
+            1 + static_cast<double>(in.lfo_data[i]) * pitch_bend_lfo_mod_ +
+            static_cast<double>(in.env1_data[i]) * pitch_bend_env1_mod_ +
+            static_cast<double>(in.modulator_data[i]) * cross_mod;
+        if (std::abs(pitch_bend - 1) < .00001) {
+          pitch_bend = 1;
+        }
+        angle_deltas[k] = delta_base_ * pitch_bend + in.phase_shift_per_sample;
+        increments[k] = PhaseIncrement(angle_deltas[k]);
+      }
+    }
+    if constexpr (kPulseWidthModulated) {
+      for (std::size_t k = 0; k < kLanes; k++) {
+        const int i = start + static_cast<int>(std::min(k, lanes - 1));
+        pulse_width_phases[k] = PulseWidthToPhase(static_cast<double>(
+            in.pulse_width_data[i] * pulse_width_scale + pulse_width_offset));
+      }
+    }
+
+    // MOVE the PHASE - the accumulator wraps at the end of the period by
+    // itself, so there's no drift to correct
+    if constexpr (kPitchModulated) {
+      for (std::size_t k = 0; k < kLanes; k++) {
+        phase += static_cast<uint32_t>(increments[k]);
+        phases[k] = phase;
+      }
+    } else {
+      for (std::size_t k = 0; k < kLanes; k++) {
+        phases[k] = phase + static_cast<uint32_t>(increments[0]) *
+                                static_cast<uint32_t>(k + 1);
+      }
+    }
+    phase = phases[lanes - 1];
+
+    if constexpr (kWave == random) {
+      // each sample depends on the last one
+      for (std::size_t k = 0; k < lanes; k++) {
+        values[k] = static_cast<float>(GetRandom(0));
+      }
+    } else {
+      for (std::size_t k = 0; k < kLanes; k++) {
+        values[k] = WaveAtPhase<kWave>(phases[k], pulse_width_phases[k]);
+      }
+    }
+    for (std::size_t k = 0; k < lanes; k++) {
+      waveData[static_cast<std::size_t>(start) + k] = values[k];
+    }
+
+    // the phase crossed threshold during sample k if it's now less than one
+    // increment past it (modulo the period), in the direction it's moving.
+    // What's left over says where in the sample it was crossed.
+    auto crossed = [&](const std::size_t k, const uint32_t threshold) {
+      return increments[k] < 0
+                 ? threshold - phases[k] - 1 <
+                       static_cast<uint32_t>(-increments[k])
+                 : phases[k] - threshold <
+                       static_cast<uint32_t>(increments[k]);
+    };
+    auto perc_after = [&](const std::size_t k, const uint32_t threshold) {
+      return static_cast<double>(static_cast<int32_t>(phases[k] - threshold)) /
+             static_cast<double>(increments[k]);
+    };
+
+    if constexpr (kDetectBleps || kSyncPrimary) {
+      // most chunks don't have any
+      bool any = false;
+      for (std::size_t k = 0; k < kLanes; k++) {
+        if constexpr (kSyncPrimary) {
+          any |= crossed(k, 0);
+        }
+        if constexpr (kDetectBleps && kWave == square) {
+          any |= crossed(k, pulse_width_phases[k]) || crossed(k, 0);
+        } else if constexpr (kDetectBleps &&
+                             (kWave == sawRise || kWave == sawFall)) {
+          any |= crossed(k, kHalfPhase);
+        } else if constexpr (kDetectBleps && kWave == triangle) {
+          any |= crossed(k, kHalfPhase / 2) || crossed(k, 3 * (kHalfPhase / 2));
+        }
+      }
+
+      for (std::size_t k = 0; any && k < lanes; k++) {
+        const int i = start + static_cast<int>(k);
+
+        if constexpr (kSyncPrimary) {
+          // the carry - write the subsample-accurate index of the rollover
+          if (crossed(k, 0)) {
+            hard_sync_reset_sample_indices_.add(
+                static_cast<float>(i - perc_after(k, 0)));
+          }
+        }
+
+        if constexpr (kDetectBleps && kWave != sine && kWave != random) {
+          if constexpr (kMode == POLYBLEP) {
+            build_sample_ = i;
+          }
+          // running backwards, the steps go the other way
+          const double direction = increments[k] < 0 ? -1 : 1;
+          auto add_blep = [&](const double perc_after_roll,
+                              const double pos_change,
+                              const double vel_change) {
+            MinBlepGenerator::BlepOffset blep;
+            blep.offset = perc_after_roll - static_cast<double>(i + 1);
+            blep.pos_change_magnitude = pos_change;
+            blep.vel_change_magnitude = vel_change;
+            if constexpr (kMode == ANTIALIAS) {
+              blep_generator_.AddBlep(blep);
+            } else if constexpr (kMode == BUILD_AA) {
+              detected_bleps_.add(blep);
+            } else {
+              AddPolyBlep(blep);
+            }
+          };
+
+          if constexpr (kWave == square) {
+            // falls at 2PI * pulse width, rises at the end of the period
+            if (crossed(k, pulse_width_phases[k])) {
+              add_blep(perc_after(k, pulse_width_phases[k]), direction * 2, 0);
+            }
+            if (crossed(k, 0)) {
+              add_blep(perc_after(k, 0), direction * -2, 0);
+            }
+          } else if constexpr (kWave == sawRise || kWave == sawFall) {
+            // SAW ROLLs only at 2PI
+            if (crossed(k, kHalfPhase)) {
+              add_blep(perc_after(k, kHalfPhase),
+                       direction * (kWave == sawRise ? -2 : 2), 0);
+            }
+          } else if constexpr (kWave == triangle) {
+            // corners at PI and 3PI
+            const uint32_t corner = crossed(k, kHalfPhase / 2)
+                                        ? kHalfPhase / 2
+                                        : 3 * (kHalfPhase / 2);
+            if (crossed(k, corner)) {
+              // same slope estimate as BuildWave
+              const auto previous = k > 0 ? values[k - 1] : last_value;
+              const double averageValue =
+                  static_cast<double>(previous + values[k]) / 2;
+              const double sign = averageValue > 0 ? -1 : 1;
+              if constexpr (kMode == POLYBLEP) {
+                // 2/pi per radian, as in BuildWave. A corner is a corner
+                // whichever way it's passed through.
+                add_blep(perc_after(k, corner), 0,
+                         sign * 2 / juce::MathConstants<double>::pi *
+                             std::abs(angle_deltas[k]));
+              } else {
+                const double slope = 1 - fabs(averageValue);
+                add_blep(perc_after(k, corner), 0,
+                         sign * 121 * slope * blep_generator_.blamp_scale());
+              }
+            }
+          }
+
+          if constexpr (kMode == POLYBLEP) {
+            waveData[i] += static_cast<float>(poly_blep_current_);
+            poly_blep_current_ = 0;
+          }
+        }
+      }
+    }
+
+    const auto last = lanes - 1;
+    last_value_delta = values[last] - (last > 0 ? values[last - 1] : last_value);
+    last_value = values[last];
+  }
+
+  const auto last = static_cast<std::size_t>(numSamples - 1) % kLanes;
+  if constexpr (kPitchModulated) {
+    pitch_bend_actual_ =
+        PitchBendAt(numSamples - 1, in.lfo_data, in.env1_data,
+                    in.modulator_data);
+  } else {
+    pitch_bend_actual_ = 1;
+  }
+  actual_current_angle_delta_ = angle_deltas[last];
+  if constexpr (kWave == square) {
+    pulse_width_actual_ =
+        static_cast<double>(pulse_width_phases[last]) / kHalfPhase;
+  }
+  last_sample_ = static_cast<double>(last_value);
+  last_sample_delta_ = static_cast<double>(last_value_delta);
+
+  // so the angle based code carries on from here
+  current_angle_ = static_cast<double>(phase) / kPhasePerRadian;
+  current_angle_skewed_ = skew_angle(current_angle_);
+  last_angle_skewed_ = current_angle_skewed_;
+}
+
+template <bool IsLFO>
+double WaveGenerator<IsLFO>::PitchBendAt(const int i, const float* lfo_data,
+                                         const float* env1_data,
+                                         const float* modulator_data) const {
+  double mod = 0;
+  if (pitch_bend_lfo_mod_ != 0.) {
+    mod = static_cast<double>(lfo_data[i]) * pitch_bend_lfo_mod_;
+  }
+  if (pitch_bend_env1_mod_ != 0.) {
+    mod += static_cast<double>(env1_data[i]) * pitch_bend_env1_mod_;
+  }
+  if (cross_mod_ > 0.001) {
+    // note blepping has already been applied to the modulator signal
+    // so the carrier only needs to deal with its own discontinuities like
+    // normal todo: is this reasoning actually correct for what blepping is
+    // needed?
+    // todo: this is not producing the expected sound...
+    mod += static_cast<double>(modulator_data[i]) * cross_mod_;
+  }
+  return 1 + mod;
+}
+
+template <bool IsLFO>
+double WaveGenerator<IsLFO>::PulseWidthAt(const int i, const float* lfo_data,
+                                          const float* env1_data,
+                                          const float* env2_data) const {
+  if (pulse_width_mod_ == 0.) return 0.5;
+  switch (pulse_width_mod_type_) {
+    case env2Plus:
+      return static_cast<double>(env2_data[i]) * pulse_width_mod_;
+    case env2Minus:
+      return static_cast<double>(env2_data[i]) * -pulse_width_mod_;
+    case env1Plus:
+      return static_cast<double>(env1_data[i]) * pulse_width_mod_;
+    case env1Minus:
+      return static_cast<double>(env1_data[i]) * -pulse_width_mod_;
+    case lfo:
+      return (static_cast<double>(lfo_data[i]) / 2 + 1) * pulse_width_mod_;
+    case manual:
+    default:
+      return pulse_width_mod_;
+  }
+}
+
 // todo: use this for PWM instead of the other stuff I used...or remove this
 template <bool IsLFO>
 double WaveGenerator<IsLFO>::skew_angle(const double angle) const {
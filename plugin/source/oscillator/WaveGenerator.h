@@ -9,6 +9,7 @@ https://forum.juce.com/t/open-source-square-waves-for-the-juceplugin/19915/8
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_core/juce_core.h>
 
+#include "../dsp/ModulationBus.h"
 #include "MinBlepGenerator.h"
 
 namespace audio_plugin {
@@ -28,15 +29,6 @@ enum PulseWidthModType {
   manual = 5
 };
 
-/**
-*  SET the allowed depth of overtones
-   ** NOTE **
-   this is relative to the fundamental F
-   so each factor of 2 is an octave.
-   This default of 128 seems fairly high.
- */
-constexpr auto kBlepOvertoneDepth = 128;
-
 enum WaveType {
   sine = 0,
   sawRise = 1,
@@ -47,21 +39,38 @@ enum WaveType {
 };
 enum HardSyncMode { PRIMARY = 0, SECONDARY = 1, DISABLED = 2 };
 
-enum WaveMode { ANTIALIAS, BUILD_AA, NO_ANTIALIAS };
+// BUILD_AA detects the discontinuities and records them (see detected_bleps)
+// without applying any correction.
+// POLYBLEP corrects the 2 samples around each discontinuity with a polynomial
+// (polyBLEP / polyBLAMP) as the wave is built. It aliases more than ANTIALIAS
+// (minBLEP), but has no residual to carry between blocks, so it's much
+// cheaper, and it still works when the pitch is modulated at audio rate
+// (cross mod). Its output is one sample late.
+enum WaveMode { ANTIALIAS, BUILD_AA, NO_ANTIALIAS, POLYBLEP };
 
 template <bool IsLFO>
 class WaveGenerator {
 
   public:
-  WaveGenerator(const juce::AudioBuffer<float>& lfo_buffer,
-                const juce::AudioBuffer<float>& env1_buffer,
-                const juce::AudioBuffer<float>& env2_buffer,
-                const juce::AudioBuffer<float>& modulator_buffer,
+  /**
+   * @param mod_bus the voice's modulation sources (LFO, envelopes and the
+   * cross mod modulator), read at the oversampled rate
+   */
+  WaveGenerator(const ModulationBus& mod_bus,
                 juce::Array<float>& hard_sync_reset_sample_indices) requires (!IsLFO);
 
   WaveGenerator() requires IsLFO;
 
-  void PrepareToPlay(double new_sample_rate);
+  /**
+   * @param max_block_size most samples RenderNextBlock will be asked for at
+   * once
+   */
+  void PrepareToPlay(double new_sample_rate, int max_block_size);
+  /**
+   * Change the rate without clearing anything, so a playing note carries on.
+   * Doesn't allocate. The pitch has to be set again afterwards.
+   */
+  void set_sample_rate(double new_sample_rate);
 
   double cross_mod() const;
   void set_hard_sync_mode(HardSyncMode mode);
@@ -70,7 +79,23 @@ class WaveGenerator {
   void set_dc_blocker_enabled(bool enabled);
   void set_wave_type(WaveType wave_type);
   void set_mode(WaveMode mode);
+  /**
+   * Build the wave from a 32 bit fixed point phase accumulator instead of
+   * the angle in radians. Wrapping is free and rollovers are a carry, so it
+   * skips the fmods on every sample. Not used by the LFO, or when the
+   * oscillator is hard synced to the other one (SECONDARY). Off by default.
+   * The phase is exact, but the increments and the wave values are worked
+   * out in float, 8 samples at a time; the generator's state and the bleps'
+   * offsets stay double.
+   */
+  void set_phase_accumulator_enabled(bool enabled);
   MinBlepGenerator* blep_generator();
+  /**
+   * Bleps detected in BUILD_AA mode since the last clear_detected_bleps, in
+   * the order they were detected.
+   */
+  const juce::Array<MinBlepGenerator::BlepOffset>& detected_bleps() const;
+  void clear_detected_bleps();
   void set_pulse_width_mod_type(PulseWidthModType type);
   void set_pulse_width_mod(double pulse_width);
 
@@ -106,6 +131,18 @@ class WaveGenerator {
   // todo: passing LFO like this is stupid, let's find a better way
   void RenderNextBlock(juce::AudioBuffer<float>& outputBuffer, int startSample,
                        int numSamples);
+  /**
+   * RenderNextBlock for each of generators (in order, so a hard sync primary
+   * has to come before its secondary) into a cleared outputBuffer, then
+   * multiplied by vca if it isn't null - but mixed in a single pass, rather
+   * than one per generator plus one for the VCA. Writes over outputBuffer
+   * and comes out bit for bit the same as the separate passes.
+   * @param vca numSamples of gain, from startSample
+   */
+  static void RenderMixed(std::initializer_list<WaveGenerator*> generators,
+                          juce::AudioBuffer<float>& outputBuffer,
+                          int startSample, int numSamples, const float* vca)
+    requires(!IsLFO);
   void BuildWave(int numSamples);
 
   void MoveAngleForward(int numSamples);
@@ -119,7 +156,94 @@ class WaveGenerator {
   double GetRandom([[maybe_unused]] double angle);
 
 private:
+  // 1st-order high-pass: y[n] = x[n] - x[n-1] + R*y[n-1]
+  struct DcBlocker {
+    float Process(const float x) {
+      constexpr float r = 0.995f;
+      const float y = (x - x_prev) + r * y_prev;
+      x_prev = x;
+      y_prev = y;
+      return y;
+    }
+
+    float x_prev = 0;
+    float y_prev = 0;
+  };
+
+  /**
+   * The first half of RenderNextBlock: builds the block into wave, with the
+   * bleps mixed in. False if there's nothing to output.
+   */
+  bool BuildBlock(int startSample, int numSamples);
+  // whether the block built goes through dc_blocker_
+  bool dc_blocking() const;
+  // the fixed attenuation the block is output with
+  float gain_stage() const;
+  // the last half of RenderNextBlock, after the block has been output
+  void FinishBlock(int numSamples);
+  /**
+   * Applies (or records, depending on the mode) a discontinuity detected
+   * while building the wave.
+   */
+  void AddBlep(const MinBlepGenerator::BlepOffset& blep);
+  /**
+   * POLYBLEP: adds the correction for the blep to the sample being built and
+   * the one before it.
+   * @param blep offset is relative to the sample being built in the same way
+   * as for the MinBlepGenerator. vel_change_magnitude is the change in slope,
+   * in value per sample.
+   */
+  void AddPolyBlep(const MinBlepGenerator::BlepOffset& blep);
+
+  // PHASE ACCUMULATOR ::::
+  // one period (4PI) of the wave is 2^32
+  static constexpr double kPhasePerRadian =
+      4294967296. / (2 * juce::MathConstants<double>::twoPi);
+  static constexpr uint32_t kHalfPhase = 1u << 31;  // 2PI
+  static constexpr double kMaxPhase = 4294967295.;
+
+  static uint32_t RadiansToPhase(const double radians) {
+    // through int64 so negative angles (through zero FM) wrap too
+    return static_cast<uint32_t>(std::llround(radians * kPhasePerRadian));
+  }
+  // the square falls at 2PI * pulse width
+  static uint32_t PulseWidthToPhase(const double pulse_width) {
+    return static_cast<uint32_t>(
+        juce::jlimit(0., kMaxPhase, pulse_width * kHalfPhase));
+  }
+  // what the kernels need that stays the same for the whole block
+  struct PhaseKernelInputs {
+    const float* lfo_data = nullptr;
+    const float* env1_data = nullptr;
+    const float* modulator_data = nullptr;
+    double phase_shift_per_sample = 0;
+    // pulse width = pulse_width_data[i] * pulse_width_scale +
+    // pulse_width_offset (no data: pulse_width_offset)
+    const float* pulse_width_data = nullptr;
+    double pulse_width_scale = 0;
+    double pulse_width_offset = 0.5;
+  };
+  /**
+   * Picks the kernel for the block's settings and runs it.
+   */
+  void BuildWaveFromPhase(int numSamples, double phaseShiftPerSample)
+    requires(!IsLFO);
+  /**
+   * BuildWave over the phase accumulator for one combination of settings,
+   * so the loop only does what that combination needs.
+   */
+  template <WaveType kWave, WaveMode kMode, bool kSyncPrimary,
+            bool kPulseWidthModulated, bool kPitchModulated>
+  void BuildWaveKernel(int numSamples, const PhaseKernelInputs& in)
+    requires(!IsLFO);
+  // pitch multiplier (1 is unmodulated) for sample i of the block
+  double PitchBendAt(int i, const float* lfo_data, const float* env1_data,
+                     const float* modulator_data) const;
+  double PulseWidthAt(int i, const float* lfo_data, const float* env1_data,
+                      const float* env2_data) const;
+
   MinBlepGenerator blep_generator_;
+  juce::Array<MinBlepGenerator::BlepOffset> detected_bleps_;
 
   /**
    * Base phase increment (radians per sample) for this oscillator.
@@ -151,9 +275,8 @@ private:
   double last_sample_ = 0;
   double last_sample_delta_ = 0;
 
-  // post-AA output (not defined unless AA enabled)
-  double prev_buffer_last_sample_filtered_ = 0;
-  double prev_buffer_last_sample_raw_ = 0;
+  // post-AA output (not used unless AA enabled)
+  DcBlocker dc_blocker_;
   bool dc_blocker_enabled_ = true;
 
   // PITCH BEND
@@ -186,10 +309,10 @@ private:
   double phase_angle_actual_ =
       0;  // the target angle to get to (used for phase shifting)
 
-  [[no_unique_address]] std::conditional_t<IsLFO, std::monostate,const juce::AudioBuffer<float>&> lfo_buffer_;
-  [[no_unique_address]] std::conditional_t<IsLFO, std::monostate,const juce::AudioBuffer<float>&> env1_buffer_;
-  [[no_unique_address]] std::conditional_t<IsLFO, std::monostate,const juce::AudioBuffer<float>&> env2_buffer_;
-  [[no_unique_address]] std::conditional_t<IsLFO, std::monostate,const juce::AudioBuffer<float>&> modulator_buffer_;
+  [[no_unique_address]] std::conditional_t<IsLFO, std::monostate,const ModulationBus&> mod_bus_;
+  // oversampled index of the block being rendered, where BuildWave starts
+  // reading mod_bus_
+  int mod_bus_start_ = 0;
   // see same field name on Oscillator
   [[no_unique_address]] std::conditional_t<IsLFO, std::monostate,juce::Array<float>&> hard_sync_reset_sample_indices_;
 
@@ -198,6 +321,20 @@ private:
 
   WaveType wave_type_;
   WaveMode mode_;
+  bool phase_accumulator_enabled_ = false;
+
+  // POLYBLEP ::::
+  // index into wave of the sample BuildWave is on
+  int build_sample_ = 0;
+  // correction for that sample, added when it's written
+  double poly_blep_current_ = 0;
+  // the last sample of the previous block. It's output at the start of the
+  // next block so that a blep on the first sample of a block can still
+  // correct the sample before it.
+  float poly_blep_held_sample_ = 0;
+  // left POLYBLEP with poly_blep_held_sample_ not output yet. The next block
+  // averages it into its first sample.
+  bool poly_blep_flush_ = false;
 
 
 };
@@ -9,7 +9,7 @@ namespace audio_plugin {
 AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
     AudioPluginAudioProcessor& p)
     : AudioProcessorEditor{&p},
-      keyboard_component_{keyboard_state_,
+      keyboard_component_{p.keyboard_state_,
                           juce::MidiKeyboardComponent::horizontalKeyboard},
       processor_ref_(p),
       lfo_section_{p},
@@ -20,7 +20,8 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
       vcf_drive_scaling_section_{p},
       vca_section_{p},
       env1_section_{p},
-      env2_section_{p} {
+      env2_section_{p},
+      spectrum_analyzer_{p.output_tap_} {
   juce::ignoreUnused(processor_ref_);
 
   addAndMakeVisible(lfo_section_);
@@ -37,11 +38,6 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
   centreWithSize(1600, 900);
 }
 
-void AudioPluginAudioProcessorEditor::GetNextAudioBlock(
-    juce::AudioBuffer<float>& buffer) {
-  spectrum_analyzer_.getNextAudioBlock(buffer);
-}
-
 AudioPluginAudioProcessorEditor::~AudioPluginAudioProcessorEditor() = default;
 
 void AudioPluginAudioProcessorEditor::paint(juce::Graphics& g) {
@@ -20,17 +20,11 @@ namespace audio_plugin {
 class AudioPluginAudioProcessorEditor : public juce::AudioProcessorEditor {
  public:
   explicit AudioPluginAudioProcessorEditor(AudioPluginAudioProcessor&);
-  /**
-   * must be called by root component to update audio-reactive components
-   */
-  void GetNextAudioBlock(juce::AudioBuffer<float>& buffer);
   ~AudioPluginAudioProcessorEditor() override;
 
   void paint(juce::Graphics&) override;
   juce::Grid LayoutMainGrid();
   void resized() override;
-  // todo refactor so this can be private
-  juce::MidiKeyboardState keyboard_state_;
 
  private:
   static juce::Grid MakeMainGrid();
@@ -5,26 +5,16 @@ import std;
 
 namespace audio_plugin {
 
-SpectrumAnalyzerComponent::SpectrumAnalyzerComponent()
-    : forwardFFT{fftOrder},
+SpectrumAnalyzerComponent::SpectrumAnalyzerComponent(AudioTap& tap)
+    : tap_{tap},
+      forwardFFT{fftOrder},
       window{fftSize, juce::dsp::WindowingFunction<float>::hann} {
   setOpaque(true);
+  tap_.Attach();
   startTimerHz(30);
 }
 
-SpectrumAnalyzerComponent::~SpectrumAnalyzerComponent() {}
-
-void SpectrumAnalyzerComponent::getNextAudioBlock(
-    const juce::AudioBuffer<float>& buffer) {
-  if (buffer.getNumChannels() > 0) {
-    // todo is 0 correct for sampleidx?
-    auto* channelData =
-        buffer.getReadPointer(0, 0);
-
-    for (auto i = 0; i < buffer.getNumSamples(); ++i)
-      pushNextSampleIntoFifo(channelData[i]);
-  }
-}
+SpectrumAnalyzerComponent::~SpectrumAnalyzerComponent() { tap_.Detach(); }
 
 //==============================================================================
 void SpectrumAnalyzerComponent::paint(juce::Graphics& g) {
@@ -36,29 +26,24 @@ void SpectrumAnalyzerComponent::paint(juce::Graphics& g) {
 }
 
 void SpectrumAnalyzerComponent::timerCallback() {
-  if (nextFFTBlockReady) {
-    drawNextFrameOfSpectrum();
-    nextFFTBlockReady = false;
-    repaint();
-  }
-}
-
-void SpectrumAnalyzerComponent::pushNextSampleIntoFifo(float sample) noexcept {
-  // if the fifo contains enough data, set a flag to say
-  // that the next frame should now be rendered..
-  if (fifoIndex == fftSize)  // [11]
-  {
-    if (!nextFFTBlockReady)  // [12]
-    {
+  // drain everything published since the last tick, keeping only the most
+  // recent full block for display
+  auto next_fft_block_ready = false;
+  while (const auto num_pulled =
+             tap_.Pull(fifo + fifoIndex, fftSize - fifoIndex)) {
+    fifoIndex += num_pulled;
+    if (fifoIndex == fftSize) {
       juce::zeromem(fftData, sizeof(fftData));
-      memcpy(fftData, fifo, sizeof(fifo));
-      nextFFTBlockReady = true;
+      std::memcpy(fftData, fifo, sizeof(fifo));
+      next_fft_block_ready = true;
+      fifoIndex = 0;
     }
-
-    fifoIndex = 0;
   }
 
-  fifo[fifoIndex++] = sample;  // [12]
+  if (next_fft_block_ready) {
+    drawNextFrameOfSpectrum();
+    repaint();
+  }
 }
 
 void SpectrumAnalyzerComponent::drawNextFrameOfSpectrum() {
@@ -2,7 +2,7 @@
 import JuceImports;
 import std;
 
-#include "../PluginProcessor.h"
+#include "../dsp/AudioTap.h"
 
 namespace audio_plugin {
 
@@ -10,17 +10,18 @@ namespace audio_plugin {
  * A custom component for displaying a spectrum.
  * Based on AudioVisualizerComponent.
  * Only the left channel is visualized.
+ * Audio is pulled from the tap on the message thread, the audio thread only
+ * publishes to it.
  */
 class SpectrumAnalyzerComponent : public juce::Component, juce::Timer {
 public:
-  SpectrumAnalyzerComponent();
-  /** Destructor. */
-  ~SpectrumAnalyzerComponent() override;
-
   /**
-   * must be called by root component and pass the current buffer
+   * @param tap tap to read audio from. Attached for the lifetime of this
+   * component.
    */
-  void getNextAudioBlock(const juce::AudioBuffer<float>& buffer);
+  explicit SpectrumAnalyzerComponent(AudioTap& tap);
+  /** Destructor. */
+  ~SpectrumAnalyzerComponent() override;
 
   //==============================================================================
   /** @internal */
@@ -34,10 +35,10 @@ public:
   };
 private:
   void timerCallback() override;
-  void pushNextSampleIntoFifo(float sample) noexcept;
   void drawNextFrameOfSpectrum();
   void drawFrame(juce::Graphics& g);
 
+  AudioTap& tap_;
   juce::dsp::FFT forwardFFT;                   // [4]
   juce::dsp::WindowingFunction<float> window;  // [5]
 
@@ -45,7 +46,6 @@ private:
   float fifo[fftSize];             // [6]
   float fftData[2 * fftSize];      // [7]
   int fifoIndex = 0;               // [8]
-  bool nextFFTBlockReady = false;  // [9]
   float scopeData[scopeSize];      // [10]
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrumAnalyzerComponent)
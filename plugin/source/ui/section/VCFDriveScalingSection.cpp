@@ -14,14 +14,14 @@ VCFDriveScalingSection::VCFDriveScalingSection(
   vcf_drive_scaling_label_.setJustificationType(juce::Justification::centred);
   addAndMakeVisible(vcf_drive_scaling_label_);
 
-  for (int i = 0; i < 4; ++i) {
+  for (int i = 0; i < kNumDriveScaleStages; ++i) {
     auto& inSlider = filter_input_drive_scale_sliders_[static_cast<size_t>(i)];
     inSlider.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
     inSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 50, 20);
     addAndMakeVisible(inSlider);
     filter_input_drive_scale_attachments_[static_cast<size_t>(i)] =
         std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
-            processor_.apvts_, "filterInputDriveScale" + juce::String(i + 1),
+            processor_.apvts_, ToString(FilterInputDriveScaleId(i)),
             inSlider);
 
     auto& stateSlider =
@@ -31,7 +31,7 @@ VCFDriveScalingSection::VCFDriveScalingSection(
     addAndMakeVisible(stateSlider);
     filter_state_drive_scale_attachments_[static_cast<size_t>(i)] =
         std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
-            processor_.apvts_, "filterStateDriveScale" + juce::String(i + 1),
+            processor_.apvts_, ToString(FilterStateDriveScaleId(i)),
             stateSlider);
 
     auto& stageLabel = filter_stage_header_labels_[static_cast<size_t>(i)];
@@ -0,0 +1,293 @@
+// Build-time generator for the minBLEP / BLAMP lookup tables used by
+// MinBlepGenerator. Writes a header holding them as constexpr arrays, so the
+// plugin doesn't have to compute them (an O(N^2) DFT) when it's loaded.
+// There's one pair of tables per entry of kZeroCrossings - MinBlepGenerator
+// picks which to use depending on the pitch.
+//
+// MinBlepTableGenerator <output header>
+//
+// The math was originally in MinBlepGenerator::BuildBlep, itself adapted from
+// https://github.com/aaronleese/JucePlugin-Synth-with-AntiAliasing
+// (used with permission, see MinBlepGenerator.h).
+// SEE ....
+// http://www.kvraudio.com/forum/viewtopic.php?t=364256
+// http://www.cs.cmu.edu/~eli/papers/icmc01-hardsync.pdf
+// http://stackoverflow.com/questions/175312/bandlimited-waveform-generation
+//
+// This is a host tool with no JUCE dependency, so it sticks to plain
+// standard library includes.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numbers>
+#include <string_view>
+#include <vector>
+
+namespace {
+// table samples per output sample. Bleps are placed to the nearest 1 /
+// kOverSamplingRatio of a sample.
+constexpr auto kOverSamplingRatio = 16;
+// zero crossings of the windowed sinc on each side, for each table. More
+// zero crossings give a steeper cutoff but a longer kernel. Shortest first.
+constexpr std::array kZeroCrossings{4, 8, 16, 32};
+
+constexpr auto kPi = std::numbers::pi;
+
+// SINC Function
+double Sinc(const double x) {
+  if (std::fpclassify(x) == FP_ZERO) {
+    return 1.0;
+  }
+  const double pix = kPi * x;
+  return std::sin(pix) / pix;
+}
+
+// Blackman-Harris window at p in [0, 1]
+double BlackmanHarris(const double p) {
+  return 0.35875 - 0.48829 * std::cos(2 * kPi * p) +
+         0.14128 * std::cos(4 * kPi * p) - 0.01168 * std::cos(6 * kPi * p);
+}
+
+struct Spectrum {
+  std::vector<double> real;
+  std::vector<double> imag;
+};
+
+// Discrete Fourier Transform. Only run once per build, so the plain O(N^2)
+// version is fine.
+Spectrum DFT(const Spectrum& time) {
+  const auto n = time.real.size();
+  Spectrum freq{std::vector<double>(n), std::vector<double>(n)};
+  for (std::size_t k = 0; k < n; ++k) {
+    double real_sum = 0.0;
+    double imag_sum = 0.0;
+    for (std::size_t t = 0; t < n; ++t) {
+      const double angle = -2.0 * kPi * static_cast<double>(k) *
+                           static_cast<double>(t) / static_cast<double>(n);
+      real_sum += time.real[t] * std::cos(angle) - time.imag[t] * std::sin(angle);
+      imag_sum += time.real[t] * std::sin(angle) + time.imag[t] * std::cos(angle);
+    }
+    freq.real[k] = real_sum;
+    freq.imag[k] = imag_sum;
+  }
+  return freq;
+}
+
+// Inverse Discrete Fourier Transform.
+// Note the result is scaled by 1/n, which assumes the DFT was NOT scaled.
+Spectrum InverseDFT(const Spectrum& freq) {
+  const auto n = freq.real.size();
+  Spectrum time{std::vector<double>(n), std::vector<double>(n)};
+  for (std::size_t t = 0; t < n; ++t) {
+    double real_sum = 0.0;
+    double imag_sum = 0.0;
+    for (std::size_t k = 0; k < n; ++k) {
+      const double angle = 2.0 * kPi * static_cast<double>(k) *
+                           static_cast<double>(t) / static_cast<double>(n);
+      real_sum += freq.real[k] * std::cos(angle) - freq.imag[k] * std::sin(angle);
+      imag_sum += freq.real[k] * std::sin(angle) + freq.imag[k] * std::cos(angle);
+    }
+    time.real[t] = real_sum / static_cast<double>(n);
+    time.imag[t] = imag_sum / static_cast<double>(n);
+  }
+  return time;
+}
+
+// Compute Real Cepstrum Of x (in place)
+void RealCepstrum(std::vector<double>& x) {
+  const auto n = x.size();
+  auto freq = DFT({x, std::vector<double>(n)});
+
+  // Note: For real cepstrum, we only return the real part
+  for (std::size_t i = 0; i < n; ++i) {
+    const double magnitude = std::sqrt(freq.real[i] * freq.real[i] +
+                                       freq.imag[i] * freq.imag[i]);
+    // small epsilon to avoid log(0)
+    constexpr double kEpsilon = 1e-10;
+    freq.real[i] = std::log(magnitude + kEpsilon);
+    freq.imag[i] = 0;
+  }
+
+  x = InverseDFT(freq).real;
+}
+
+// Compute Minimum Phase Reconstruction Of x (in place), x being a real
+// cepstrum
+void MinimumPhase(std::vector<double>& x) {
+  const auto n = x.size();
+  Spectrum time{x, std::vector<double>(n)};
+
+  // double the positive freqs (causal part)
+  // todo this doubles the DC component too, which the textbook version
+  //  doesn't - kExpectedMinBlepTable was generated this way though
+  for (std::size_t i = 0; i < n / 2; ++i) {
+    time.real[i] *= 2;
+  }
+  // zero out negative freqs (anti-causal part), leaving the nyquist bin (for
+  // even n) as is
+  for (std::size_t i = n / 2 + 1; i < n; ++i) {
+    time.real[i] = 0;
+  }
+
+  auto freq = DFT(time);
+
+  // exponentiate to get complex spectrum
+  for (std::size_t k = 0; k < n; ++k) {
+    const double magnitude = std::exp(freq.real[k]);
+    const double phase = freq.imag[k];
+    freq.real[k] = magnitude * std::cos(phase);
+    freq.imag[k] = magnitude * std::sin(phase);
+  }
+
+  x = InverseDFT(freq).real;
+}
+
+struct Tables {
+  // step (0th order / position) correction, going 1 -> 0
+  std::vector<float> min_blep;
+  // ramp (1st order / velocity) correction - the second integral of the
+  // minimum-phase impulse, i.e. effectively a BLAMP
+  std::vector<float> min_blep_deriv;
+};
+
+int TableSize(const int zero_crossings) {
+  return zero_crossings * 2 * kOverSamplingRatio;
+}
+
+Tables BuildTables(const int zero_crossings) {
+  const auto table_size = TableSize(zero_crossings);
+
+  // Generate symmetric sinc array with the specified number of zero crossings
+  // on each side
+  std::vector<double> impulse(static_cast<std::size_t>(table_size));
+  for (auto i = 0; i < table_size; ++i) {
+    // rescale from 0 - n-1 to -zeroCrossing to zeroCrossing
+    const auto p = static_cast<float>(i) / static_cast<float>(table_size - 1) *
+                       static_cast<float>(zero_crossings * 2) -
+                   static_cast<float>(zero_crossings);
+    impulse[static_cast<std::size_t>(i)] = Sinc(static_cast<double>(p));
+  }
+
+  // Window Sinc
+  for (auto i = 0; i < table_size; ++i) {
+    impulse[static_cast<std::size_t>(i)] *=
+        BlackmanHarris(static_cast<double>(i) / (table_size - 1));
+  }
+
+  // Minimum Phase Reconstruction
+  RealCepstrum(impulse);
+  MinimumPhase(impulse);
+
+  // Integrate Into MinBLEP and BLAMP lookups
+  Tables tables;
+  double first_integral = 0;
+  double second_integral = 0;
+  for (const auto sample : impulse) {
+    first_integral += sample;
+    tables.min_blep.push_back(static_cast<float>(first_integral));
+    second_integral += first_integral;
+    tables.min_blep_deriv.push_back(static_cast<float>(second_integral));
+  }
+
+  // Normalize (make area = 1)
+  const auto blep_scale = static_cast<float>(
+      1.0 / static_cast<double>(tables.min_blep.back()));
+  for (auto& value : tables.min_blep) {
+    value *= blep_scale;
+  }
+  const auto deriv_scale =
+      1.0f / *std::ranges::max_element(tables.min_blep_deriv);
+  for (auto& value : tables.min_blep_deriv) {
+    value *= deriv_scale;
+  }
+
+  // 2ND ORDER :::: remove the ramp so the correction goes back to 0
+  for (auto i = 0; i < table_size; ++i) {
+    tables.min_blep_deriv[static_cast<std::size_t>(i)] -=
+        static_cast<float>(static_cast<double>(i) / (table_size - 1));
+  }
+
+  // SUBTRACT 1 and invert the step (so it goes 1->0)
+  for (auto& value : tables.min_blep) {
+    value = -(value - 1.f);
+  }
+
+  return tables;
+}
+
+void WriteTable(std::ostream& out, const std::string_view name,
+                const int zero_crossings, const std::vector<float>& table) {
+  out << "inline constexpr std::array<float, " << table.size() << "> " << name
+      << zero_crossings << "{\n";
+  for (std::size_t i = 0; i < table.size(); ++i) {
+    out << (i % 4 == 0 ? "    " : " ") << table[i] << "f,"
+        << (i % 4 == 3 ? "\n" : "");
+  }
+  out << "};\n\n";
+}
+}  // namespace
+
+int main(const int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <output header>\n";
+    return 1;
+  }
+
+  std::ofstream out{argv[1], std::ios::out | std::ios::trunc};
+  if (!out) {
+    std::cerr << "could not open " << argv[1] << " for writing\n";
+    return 1;
+  }
+  // enough digits to round trip a float
+  out << std::scientific << std::setprecision(9);
+  out << "// Generated by MinBlepTableGenerator (plugin/tools) - do not edit.\n"
+         "#pragma once\n"
+         "import std;\n\n"
+         "namespace audio_plugin {\n\n";
+  out << "// table samples per output sample\n"
+         "inline constexpr auto kMinBlepOverSamplingRatio = "
+      << kOverSamplingRatio << ";\n\n";
+
+  for (const auto zero_crossings : kZeroCrossings) {
+    const auto tables = BuildTables(zero_crossings);
+    out << "// " << zero_crossings
+        << " zero crossings\n"
+           "// used for POSITION discontinuities - 0th order - i.e. step "
+           "response\n";
+    WriteTable(out, "kMinBlepTable", zero_crossings, tables.min_blep);
+    out << "// used for VELOCITY discontinuities - 1st order (effectively, "
+           "BLAMP) i.e.\n// ramp response. Note that \"deriv\" refers to the "
+           "fact that it CORRECTS the\n// derivative.\n";
+    WriteTable(out, "kMinBlepDerivTable", zero_crossings,
+               tables.min_blep_deriv);
+  }
+
+  out << "/**\n"
+         " * A step (minBLEP) and ramp (BLAMP) correction made from the same\n"
+         " * minimum-phase windowed sinc.\n"
+         " */\n"
+         "struct MinBlepTable {\n"
+         "  // of the windowed sinc, on each side\n"
+         "  int zero_crossings;\n"
+         "  // kernel length in output samples\n"
+         "  int length;\n"
+         "  std::span<const float> step;\n"
+         "  std::span<const float> ramp;\n"
+         "};\n\n";
+  out << "// shortest kernel first\n"
+         "inline constexpr std::array kMinBlepTables{\n";
+  for (const auto zero_crossings : kZeroCrossings) {
+    out << "    MinBlepTable{" << zero_crossings << ", "
+        << TableSize(zero_crossings) / kOverSamplingRatio << ", kMinBlepTable"
+        << zero_crossings << ", kMinBlepDerivTable" << zero_crossings
+        << "},\n";
+  }
+  out << "};\n\n";
+  out << "}  // namespace audio_plugin\n";
+
+  return out ? 0 : 1;
+}
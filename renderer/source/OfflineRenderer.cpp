@@ -0,0 +1,241 @@
+// Command-line renderer: runs a MIDI file through the synth without an editor
+// and writes the result to a WAV file, then reports how fast it rendered.
+//
+// BBSynthRenderer --midi=<in.mid> --out=<out.wav> [--state=<patch.xml>]
+//                 [--sample-rate=48000] [--block-size=512] [--tail=2]
+//                 [--write-state=<patch.xml>] [--oversampling=<1|2|4|8>]
+//
+// --state loads a patch in the XML format of the plugin state (see
+// getStateInformation). --write-state saves the patch used for the render,
+// which is the easiest way to get a file to start editing from.
+// --oversampling overrides the patch's Offline Oversampling.
+import JuceImports;
+import std;
+
+#include <../../plugin/source/PluginProcessor.h>
+
+namespace audio_plugin {
+namespace {
+constexpr auto kDefaultSampleRate = 48000.0;
+constexpr auto kDefaultBlockSize = 512;
+// seconds rendered after the last MIDI event so releases can ring out
+constexpr auto kDefaultTailSeconds = 2.0;
+constexpr auto kNumOutputChannels = 2;
+constexpr auto kBitsPerSample = 24;
+
+juce::MidiMessageSequence ReadMidiFile(const juce::File& file) {
+  juce::FileInputStream stream{file};
+  if (!stream.openedOk()) {
+    juce::ConsoleApplication::fail("Could not open " + file.getFullPathName());
+  }
+  juce::MidiFile midi_file;
+  if (!midi_file.readFrom(stream)) {
+    juce::ConsoleApplication::fail("Not a MIDI file: " +
+                                   file.getFullPathName());
+  }
+  midi_file.convertTimestampTicksToSeconds();
+
+  // the synth doesn't care about tracks, so merge them all into one sequence
+  juce::MidiMessageSequence sequence;
+  for (auto i = 0; i < midi_file.getNumTracks(); ++i) {
+    sequence.addSequence(*midi_file.getTrack(i), 0.0);
+  }
+  return sequence;
+}
+
+void LoadState(AudioPluginAudioProcessor& processor, const juce::File& file) {
+  const auto xml = juce::parseXML(file);
+  if (xml == nullptr) {
+    juce::ConsoleApplication::fail("Could not parse state XML " +
+                                   file.getFullPathName());
+  }
+  // go through the same path a host would when restoring a session
+  juce::MemoryBlock state;
+  juce::AudioProcessor::copyXmlToBinary(*xml, state);
+  processor.setStateInformation(state.getData(),
+                                static_cast<int>(state.getSize()));
+}
+
+void WriteState(AudioPluginAudioProcessor& processor, const juce::File& file) {
+  const auto xml = processor.apvts_.copyState().createXml();
+  if (xml == nullptr || !xml->writeTo(file)) {
+    juce::ConsoleApplication::fail("Could not write state to " +
+                                   file.getFullPathName());
+  }
+}
+
+std::unique_ptr<juce::AudioFormatWriter> CreateWavWriter(
+    const juce::File& file, const double sample_rate) {
+  file.deleteFile();
+  auto stream = std::make_unique<juce::FileOutputStream>(file);
+  if (!stream->openedOk()) {
+    juce::ConsoleApplication::fail("Could not open " + file.getFullPathName() +
+                                   " for writing");
+  }
+  juce::WavAudioFormat format;
+  std::unique_ptr<juce::AudioFormatWriter> writer{format.createWriterFor(
+      stream.get(), sample_rate, static_cast<unsigned int>(kNumOutputChannels),
+      kBitsPerSample, {}, 0)};
+  if (writer == nullptr) {
+    juce::ConsoleApplication::fail("Could not create WAV writer");
+  }
+  // the writer owns the stream now
+  stream.release();
+  return writer;
+}
+
+/**
+ * Prints the real-time factor and the distribution of per-block render times.
+ * @param block_micros time spent in processBlock for each block. Sorted in
+ * place.
+ */
+void ReportTimings(std::vector<double>& block_micros, const double audio_seconds,
+                   const double sample_rate, const int block_size) {
+  std::ranges::sort(block_micros);
+  const auto render_micros =
+      std::accumulate(block_micros.begin(), block_micros.end(), 0.0);
+  const auto render_seconds = render_micros / 1e6;
+  const auto percentile = [&block_micros](const double p) {
+    const auto index = static_cast<std::size_t>(
+        std::round(p * static_cast<double>(block_micros.size() - 1)));
+    return block_micros[index];
+  };
+  // how long a block may take before a real-time host would glitch
+  const auto block_budget_micros =
+      static_cast<double>(block_size) / sample_rate * 1e6;
+  const auto blocks_over_budget = std::ranges::count_if(
+      block_micros,
+      [block_budget_micros](const double t) { return t > block_budget_micros; });
+
+  std::cout << std::format(
+      "rendered {:.2f} s of audio in {:.3f} s ({} blocks of {} @ {} Hz)\n",
+      audio_seconds, render_seconds, block_micros.size(), block_size,
+      sample_rate);
+  std::cout << std::format(
+      "real-time factor: {:.4f} ({:.1f}x faster than real time)\n",
+      render_seconds / audio_seconds, audio_seconds / render_seconds);
+  std::cout << std::format(
+      "per-block time (us): min {:.1f}  mean {:.1f}  p50 {:.1f}  p90 {:.1f}  "
+      "p99 {:.1f}  max {:.1f}\n",
+      block_micros.front(),
+      render_micros / static_cast<double>(block_micros.size()),
+      percentile(.5), percentile(.9), percentile(.99), block_micros.back());
+  std::cout << std::format("block budget: {:.1f} us, {} blocks over budget\n",
+                           block_budget_micros, blocks_over_budget);
+}
+
+void SetOfflineOversampling(AudioPluginAudioProcessor& processor,
+                            const int factor) {
+  if (factor < 1 || factor > kMaxOversample || !juce::isPowerOfTwo(factor)) {
+    juce::ConsoleApplication::fail("oversampling must be 1, 2, 4 or 8");
+  }
+  // the choices are the factors 1 << choice
+  auto* parameter = processor.apvts_.getParameter(
+      ToString(ParamId::kOfflineOversampling));
+  parameter->setValueNotifyingHost(parameter->convertTo0to1(
+      static_cast<float>(std::countr_zero(static_cast<unsigned>(factor)))));
+}
+
+int Run(const juce::ArgumentList& args) {
+  if (args.size() == 0 || args.containsOption("--help|-h")) {
+    std::cout << "usage: " << args.executableName
+              << " --midi=<in.mid> --out=<out.wav> [--state=<patch.xml>]\n"
+                 "    [--sample-rate=48000] [--block-size=512] [--tail=2]\n"
+                 "    [--write-state=<patch.xml>]\n"
+                 "    [--oversampling=<1|2|4|8>]\n";
+    return 0;
+  }
+
+  const auto midi_file = args.getExistingFileForOption("--midi");
+  const auto out_file = args.getFileForOption("--out");
+  const auto sample_rate =
+      args.containsOption("--sample-rate")
+          ? args.getValueForOption("--sample-rate").getDoubleValue()
+          : kDefaultSampleRate;
+  const auto block_size =
+      args.containsOption("--block-size")
+          ? args.getValueForOption("--block-size").getIntValue()
+          : kDefaultBlockSize;
+  const auto tail_seconds =
+      args.containsOption("--tail")
+          ? args.getValueForOption("--tail").getDoubleValue()
+          : kDefaultTailSeconds;
+  if (sample_rate <= 0 || block_size <= 0 || tail_seconds < 0) {
+    juce::ConsoleApplication::fail(
+        "sample rate and block size must be positive, tail can't be negative");
+  }
+
+  const auto sequence = ReadMidiFile(midi_file);
+
+  // no editor is ever created, processBlock must work without one
+  AudioPluginAudioProcessor processor;
+  if (args.containsOption("--state")) {
+    LoadState(processor, args.getExistingFileForOption("--state"));
+  }
+  if (args.containsOption("--oversampling")) {
+    SetOfflineOversampling(
+        processor, args.getValueForOption("--oversampling").getIntValue());
+  }
+  if (args.containsOption("--write-state")) {
+    WriteState(processor, args.getFileForOption("--write-state"));
+  }
+  processor.setNonRealtime(true);
+  processor.setPlayConfigDetails(0, kNumOutputChannels, sample_rate,
+                                 block_size);
+  processor.prepareToPlay(sample_rate, block_size);
+
+  const auto total_samples = static_cast<juce::int64>(
+      std::ceil((sequence.getEndTime() + tail_seconds) * sample_rate));
+  const auto writer = CreateWavWriter(out_file, sample_rate);
+
+  juce::AudioBuffer<float> buffer{kNumOutputChannels, block_size};
+  juce::MidiBuffer midi;
+  std::vector<double> block_micros;
+  block_micros.reserve(static_cast<std::size_t>(total_samples / block_size + 1));
+  auto next_event = 0;
+  for (juce::int64 block_start = 0; block_start < total_samples;
+       block_start += block_size) {
+    const auto num_samples = static_cast<int>(
+        std::min<juce::int64>(block_size, total_samples - block_start));
+    const auto block_end = block_start + num_samples;
+
+    midi.clear();
+    for (; next_event < sequence.getNumEvents(); ++next_event) {
+      const auto& message = sequence.getEventPointer(next_event)->message;
+      const auto event_sample =
+          static_cast<juce::int64>(message.getTimeStamp() * sample_rate);
+      if (event_sample >= block_end) {
+        break;
+      }
+      if (!message.isMetaEvent()) {
+        midi.addEvent(message, static_cast<int>(event_sample - block_start));
+      }
+    }
+
+    buffer.setSize(kNumOutputChannels, num_samples, false, false, true);
+    buffer.clear();
+    const auto start = std::chrono::steady_clock::now();
+    processor.processBlock(buffer, midi);
+    const auto end = std::chrono::steady_clock::now();
+    block_micros.push_back(
+        std::chrono::duration<double, std::micro>(end - start).count());
+
+    writer->writeFromAudioSampleBuffer(buffer, 0, num_samples);
+  }
+  processor.releaseResources();
+
+  ReportTimings(block_micros,
+                static_cast<double>(total_samples) / sample_rate, sample_rate,
+                block_size);
+  std::cout << "wrote " << out_file.getFullPathName() << "\n";
+  return 0;
+}
+}  // namespace
+}  // namespace audio_plugin
+
+int main(int argc, char* argv[]) {
+  // the apvts and the processor expect the message manager to exist
+  const juce::ScopedJuceInitialiser_GUI juce_initialiser;
+  return juce::ConsoleApplication::invokeCatchingFailures(
+      [argc, argv] { return audio_plugin::Run(juce::ArgumentList{argc, argv}); });
+}
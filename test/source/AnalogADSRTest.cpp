@@ -0,0 +1,121 @@
+// Unit test for AnalogADSR curve shapes
+#include <../../plugin/source/dsp/AnalogADSR.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+using audio_plugin::AnalogADSR;
+
+namespace audio_plugin_test {
+constexpr double kSampleRate = 48000.0;
+constexpr float kAttackSeconds = .05f;
+constexpr float kDecaySeconds = .1f;
+constexpr float kSustainLevel = .5f;
+constexpr float kReleaseSeconds = .2f;
+// the note is held this long, released and rendered this long again
+constexpr int kHeldSamples = 15000;
+constexpr int kReleasedSamples = 12000;
+
+// n samples into a stage of length samples, evaluated directly
+float CurveAt(const float curve, const int n, const int length,
+              const float start, const float target) {
+  const auto progress = static_cast<float>(n) / static_cast<float>(length);
+  const auto unscaled =
+      (std::pow(2, curve * progress) - 1) / (std::pow(2, curve) - 1);
+  return start + (target - start) * static_cast<float>(unscaled);
+}
+
+// stage length in samples, rounded the same way as AnalogADSR
+int StageSamples(const float seconds) {
+  return static_cast<int>(seconds * static_cast<float>(kSampleRate));
+}
+
+// the envelope for the held / released note above, one sample at a time
+std::vector<float> ExpectedEnvelope() {
+  const auto attack = StageSamples(kAttackSeconds);
+  const auto decay = StageSamples(kDecaySeconds);
+  const auto release = StageSamples(kReleaseSeconds);
+  std::vector<float> expected;
+  for (int n = 0; n < attack; ++n) {
+    expected.push_back(CurveAt(-.4f, n, attack, 0.f, 1.f));
+  }
+  for (int n = 0; n < decay; ++n) {
+    expected.push_back(CurveAt(.4f, n, decay, 1.f, kSustainLevel));
+  }
+  while (expected.size() < static_cast<std::size_t>(kHeldSamples)) {
+    expected.push_back(kSustainLevel);
+  }
+  const auto released_level = expected.back();
+  for (int n = 0; n < release; ++n) {
+    expected.push_back(CurveAt(.4f, n, release, released_level, 0.f));
+  }
+  expected.resize(static_cast<std::size_t>(kHeldSamples + kReleasedSamples),
+                  0.f);
+  return expected;
+}
+
+class AnalogADSRTest : public ::testing::TestWithParam<int> {};
+
+// the recurrence matches the curves evaluated directly, however the
+// blocks split the stages
+TEST_P(AnalogADSRTest, MatchesCurveShapes) {
+  const auto block_size = GetParam();
+  AnalogADSR envelope;
+  envelope.Prepare(kSampleRate);
+  envelope.Configure(kAttackSeconds, kDecaySeconds, kSustainLevel,
+                     kReleaseSeconds);
+
+  juce::AudioBuffer<float> buffer{1, kHeldSamples + kReleasedSamples};
+  envelope.NoteOn();
+  for (int start = 0; start < kHeldSamples; start += block_size) {
+    envelope.WriteEnvelopeToBuffer(buffer, start,
+                                   std::min(block_size, kHeldSamples - start));
+  }
+  envelope.NoteOff();
+  for (int start = kHeldSamples; start < buffer.getNumSamples();
+       start += block_size) {
+    envelope.WriteEnvelopeToBuffer(
+        buffer, start, std::min(block_size, buffer.getNumSamples() - start));
+  }
+  EXPECT_FALSE(envelope.IsActive());
+
+  const auto expected = ExpectedEnvelope();
+  const auto* data = buffer.getReadPointer(0);
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_NEAR(data[i], expected[i], 1e-5f) << "sample " << i;
+  }
+}
+
+// the voice frees itself on IsBelow, so it mustn't be true while the
+// envelope can still rise
+TEST(AnalogADSRIsBelowTest, OnlyOnceSettledUnderLevel) {
+  constexpr auto kLevel = 1e-3f;
+  AnalogADSR envelope;
+  envelope.Prepare(kSampleRate);
+  envelope.Configure(kAttackSeconds, kDecaySeconds, kSustainLevel,
+                     kReleaseSeconds);
+  EXPECT_TRUE(envelope.IsBelow(kLevel));
+
+  juce::AudioBuffer<float> buffer{1, 1};
+  envelope.NoteOn();
+  // the attack starts from 0
+  envelope.WriteEnvelopeToBuffer(buffer, 0, 1);
+  EXPECT_FALSE(envelope.IsBelow(kLevel));
+  for (int i = 0; i < kHeldSamples; ++i) {
+    envelope.WriteEnvelopeToBuffer(buffer, 0, 1);
+  }
+  EXPECT_FALSE(envelope.IsBelow(kLevel));
+
+  envelope.NoteOff();
+  const auto* data = buffer.getReadPointer(0);
+  do {
+    envelope.WriteEnvelopeToBuffer(buffer, 0, 1);
+    ASSERT_EQ(envelope.IsBelow(kLevel), data[0] < kLevel);
+  } while (data[0] >= kLevel);
+  EXPECT_TRUE(envelope.IsActive());
+}
+
+INSTANTIATE_TEST_SUITE_P(AnalogADSR, AnalogADSRTest,
+                         ::testing::Values(1, 64, 480, 1000));
+}  // namespace audio_plugin_test
@@ -0,0 +1,157 @@
+// Unit test for the FastMath approximations, against libm
+#include <../../plugin/source/dsp/FastMath.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+using audio_plugin::MathQuality;
+
+namespace audio_plugin_test {
+constexpr int kNumPoints = 1 << 20;
+
+// evenly spaced inputs from lo to hi
+std::vector<float> Inputs(const double lo, const double hi) {
+  std::vector<float> inputs;
+  for (int i = 0; i < kNumPoints; ++i) {
+    inputs.push_back(
+        static_cast<float>(lo + (hi - lo) * i / (kNumPoints - 1)));
+  }
+  return inputs;
+}
+
+// the scalar and array forms
+using Scalar = float (*)(float);
+using Array = void (*)(const float*, float*, int);
+
+// largest error of approximate against exact over the inputs. Where exact's
+// magnitude is above relative_above, the error is relative to it.
+double MaxError(const std::vector<float>& inputs, const Scalar approximate,
+                double (*exact)(double),
+                const double relative_above =
+                    std::numeric_limits<double>::infinity()) {
+  double max_error = 0;
+  for (const auto x : inputs) {
+    const auto expected = exact(static_cast<double>(x));
+    const auto magnitude = std::abs(expected);
+    const auto error =
+        std::abs(static_cast<double>(approximate(x)) - expected) /
+        (magnitude > relative_above ? magnitude : 1);
+    max_error = std::max(max_error, error);
+  }
+  return max_error;
+}
+
+// the array form gives the scalar form's results exactly
+void ExpectArrayMatchesScalar(const std::vector<float>& inputs,
+                              const Scalar scalar, const Array array) {
+  std::vector<float> outputs(inputs.size());
+  array(inputs.data(), outputs.data(), static_cast<int>(inputs.size()));
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_EQ(std::bit_cast<uint32_t>(outputs[i]),
+              std::bit_cast<uint32_t>(scalar(inputs[i])))
+        << "input " << inputs[i];
+  }
+}
+
+double Tanh(const double x) { return std::tanh(x); }
+double Tan(const double x) { return std::tan(x); }
+double Exp2(const double x) { return std::exp2(x); }
+double LogCosh(const double x) { return std::log(std::cosh(x)); }
+double Sin(const double x) { return std::sin(x); }
+
+TEST(FastMathTest, Tanh) {
+  const auto inputs = Inputs(-20, 20);
+  EXPECT_LT(MaxError(inputs, audio_plugin::Tanh<MathQuality::kFast>, Tanh),
+            1.5e-3);
+  EXPECT_LT(MaxError(inputs, audio_plugin::Tanh<MathQuality::kHigh>, Tanh),
+            1e-5);
+  ExpectArrayMatchesScalar(inputs, audio_plugin::Tanh<MathQuality::kHigh>,
+                           audio_plugin::Tanh<MathQuality::kHigh>);
+}
+
+// x itself, up to kTanhLinearLimit, is within each tier's tanh error
+TEST(FastMathTest, TanhLinearLimit) {
+  const auto linear = [](const float x) { return x; };
+  EXPECT_LT(MaxError(Inputs(-audio_plugin::kTanhLinearLimit<MathQuality::kFast>,
+                            audio_plugin::kTanhLinearLimit<MathQuality::kFast>),
+                     linear, Tanh),
+            1.5e-3);
+  EXPECT_LT(MaxError(Inputs(-audio_plugin::kTanhLinearLimit<MathQuality::kHigh>,
+                            audio_plugin::kTanhLinearLimit<MathQuality::kHigh>),
+                     linear, Tanh),
+            1e-5);
+  // relative to tanh, as libm is
+  EXPECT_LT(
+      MaxError(Inputs(-audio_plugin::kTanhLinearLimit<MathQuality::kExact>,
+                      audio_plugin::kTanhLinearLimit<MathQuality::kExact>),
+               linear, Tanh, 0),
+      std::numeric_limits<float>::epsilon() / 2);
+}
+
+TEST(FastMathTest, Tan) {
+  // right up to the pole, where the relative error matters for the prewarp
+  const auto inputs = Inputs(-1.5707, 1.5707);
+  EXPECT_LT(MaxError(inputs, audio_plugin::Tan<MathQuality::kFast>, Tan, 0),
+            3e-4);
+  EXPECT_LT(MaxError(inputs, audio_plugin::Tan<MathQuality::kHigh>, Tan, 0),
+            5e-7);
+  ExpectArrayMatchesScalar(inputs, audio_plugin::Tan<MathQuality::kHigh>,
+                           audio_plugin::Tan<MathQuality::kHigh>);
+}
+
+TEST(FastMathTest, Exp2) {
+  const auto inputs = Inputs(-126, 127);
+  EXPECT_LT(MaxError(inputs, audio_plugin::Exp2<MathQuality::kFast>, Exp2, 0),
+            1.5e-4);
+  EXPECT_LT(MaxError(inputs, audio_plugin::Exp2<MathQuality::kHigh>, Exp2, 0),
+            5e-7);
+  ExpectArrayMatchesScalar(inputs, audio_plugin::Exp2<MathQuality::kHigh>,
+                           audio_plugin::Exp2<MathQuality::kHigh>);
+}
+
+TEST(FastMathTest, LogCosh) {
+  // relative above 1, where float can't resolve 1e-6 absolute any more
+  const auto inputs = Inputs(-80, 80);
+  EXPECT_LT(
+      MaxError(inputs, audio_plugin::LogCosh<MathQuality::kFast>, LogCosh, 1),
+      1e-4);
+  EXPECT_LT(
+      MaxError(inputs, audio_plugin::LogCosh<MathQuality::kHigh>, LogCosh, 1),
+      1e-6);
+  ExpectArrayMatchesScalar(inputs, audio_plugin::LogCosh<MathQuality::kHigh>,
+                           audio_plugin::LogCosh<MathQuality::kHigh>);
+}
+
+TEST(FastMathTest, Sin) {
+  for (const auto range : {10.0, 4096.0}) {
+    const auto inputs = Inputs(-range, range);
+    EXPECT_LT(MaxError(inputs, audio_plugin::Sin<MathQuality::kFast>, Sin),
+              1.5e-4)
+        << "range " << range;
+    EXPECT_LT(MaxError(inputs, audio_plugin::Sin<MathQuality::kHigh>, Sin),
+              5e-7)
+        << "range " << range;
+    ExpectArrayMatchesScalar(inputs, audio_plugin::Sin<MathQuality::kHigh>,
+                             audio_plugin::Sin<MathQuality::kHigh>);
+  }
+}
+
+// large inputs saturate rather than overflowing to inf / nan
+TEST(FastMathTest, SaturatesOutOfRange) {
+  for (const auto x : {-1e30f, -1e4f, 1e4f, 1e30f}) {
+    const auto limit = std::bit_cast<uint32_t>(std::copysign(1.f, x));
+    EXPECT_EQ(std::bit_cast<uint32_t>(audio_plugin::Tanh<MathQuality::kFast>(x)),
+              limit);
+    EXPECT_EQ(std::bit_cast<uint32_t>(audio_plugin::Tanh<MathQuality::kHigh>(x)),
+              limit);
+    EXPECT_TRUE(std::isfinite(audio_plugin::Exp2<MathQuality::kFast>(x)));
+    EXPECT_TRUE(std::isfinite(audio_plugin::Exp2<MathQuality::kHigh>(x)));
+    EXPECT_TRUE(std::isfinite(audio_plugin::LogCosh<MathQuality::kHigh>(x)));
+  }
+}
+}  // namespace audio_plugin_test
@@ -96,18 +96,12 @@ constexpr auto kExpectedMinBlepTable = std::to_array({
     0.000533164, 0.000426829, 0.000324965, 0.000231385, 0.000149667,
     0.0000824928, 0.0000321865, 0.0000000596046});
 
-TEST(MinBlepGenerator, BuildBlep_MatchesExpectedTable) {
-  // Arrange
-  audio_plugin::MinBlepGenerator gen;
-
-  // Act: explicitly build the BLEP table
-  gen.BuildBlep();
-
-  // assert table within expected values
-  const auto arr = audio_plugin::MinBlepGenerator::min_blep_array();
-  ASSERT_EQ(arr.size(), 512);
-  for (unsigned long i = 0; i < 512; i++) {
-    EXPECT_NEAR(arr[static_cast<int>(i)], kExpectedMinBlepTable[i], 1.0e-3f);
+TEST(MinBlepGenerator, MinBlepTable_MatchesExpectedTable) {
+  // the table is generated at build time
+  const auto& arr = audio_plugin::kMinBlepTable16;
+  ASSERT_EQ(arr.size(), kExpectedMinBlepTable.size());
+  for (std::size_t i = 0; i < arr.size(); i++) {
+    EXPECT_NEAR(arr[i], kExpectedMinBlepTable[i], 1.0e-3f);
   }
 }
 
@@ -121,18 +115,13 @@ TEST(MinBlepGenerator, ProcessBlock_Applies0ThOrderBlep) {
   // and only has a 0th-order (position) discontinuity.
   audio_plugin::MinBlepGenerator::BlepOffset blep;
   blep.offset = -32.0; // happened about halfway through the current buffer
-  blep.freqMultiple = 8.0;
-  // sensible value: 16x oversample * 0.5 proportional freq = 8
   blep.pos_change_magnitude = 2.0; // apply a noticeable correction
   blep.vel_change_magnitude = 0.0; // ensure we're only testing 0th-order BLEP
 
-  // Add directly to the active BLEPs for this block
-  gen.currentActiveBlepOffsets.add(blep);
-
-  const auto blepTable = audio_plugin::MinBlepGenerator::min_blep_array();
-  const float expectedFirst = static_cast<float>(blep.pos_change_magnitude) *
-                              blepTable.getUnchecked(0);
+  gen.Prepare(kNumSamples);
+  gen.AddBlep(blep);
 
+  const auto& table = gen.table();
   gen.ProcessBlock(buffer, kNumSamples);
 
   // all samples should stay 0 (unmodified) until the blep
@@ -140,32 +129,16 @@ TEST(MinBlepGenerator, ProcessBlock_Applies0ThOrderBlep) {
     ASSERT_EQ(buffer[i], 0.0f);
   }
 
-  // Assert: the BLEP should be applied to the buffer
-  // Check the very first sample matches the expected scaled BLEP start value
-  EXPECT_NEAR(buffer[31], expectedFirst, 1.0e-5f);
-
-  // blep should be added to the signal for the remaining samples
-  for (int i = 32; i < kNumSamples; ++i) {
-    // Mirror the production stepping logic:
-    // sampleExact = freqMultiple * (offset + i + 1)
-    const double outputSamplesSinceBlep =
-        static_cast<double>(blep.offset) + static_cast<double>(i) + 1.0;
-    const double sampleExact = static_cast<double>(blep.freqMultiple) *
-                               outputSamplesSinceBlep;
-
-    float expected = 0.0f;
-    double sampleIndexDouble = 0.0;
-    const double frac = std::modf(sampleExact, &sampleIndexDouble);
-    const int sampleIndex = static_cast<int>(sampleIndexDouble);
-
-    const float before = blepTable.getUnchecked(sampleIndex);
-    const float after = (sampleIndex + 1 < blepTable.size())
-                          ? blepTable.getUnchecked(sampleIndex + 1)
-                          : before;
-    const float interp = before + static_cast<float>(frac) * (after - before);
-    expected = static_cast<float>(blep.pos_change_magnitude) * interp;
-
-    EXPECT_NEAR(buffer[i], expected, 1.0e-5f);
+  // the blep lands exactly on a sample, so each output sample takes every
+  // kMinBlepOverSamplingRatio'th table sample from the start of the table
+  for (int i = 31; i < kNumSamples; ++i) {
+    const auto index = (i - 31) * audio_plugin::kMinBlepOverSamplingRatio;
+    const float expected =
+        index < static_cast<int>(table.step.size())
+            ? static_cast<float>(blep.pos_change_magnitude) *
+                  table.step[static_cast<std::size_t>(index)]
+            : 0.0f;
+    EXPECT_NEAR(buffer[i], expected, 1.0e-5f) << "sample " << i;
   }
 }
 
@@ -179,17 +152,13 @@ TEST(MinBlepGenerator, ProcessBlock_Applies1StOrderBlep) {
   // and only has a 1st-order (velocity) discontinuity.
   audio_plugin::MinBlepGenerator::BlepOffset blep;
   blep.offset = -32.0; // happened about halfway through the current buffer
-  blep.freqMultiple = 8.0; // used for initial gating in process_currentBleps
   blep.pos_change_magnitude = 0.0; // ensure we're only testing 1st-order BLEP
   blep.vel_change_magnitude = 2.0; // apply a noticeable correction
 
-  // Add directly to the active BLEPs for this block
-  gen.currentActiveBlepOffsets.add(blep);
-
-  const auto blampTable = audio_plugin::MinBlepGenerator::min_blep_deriv_array();
-  const float expectedFirst = static_cast<float>(blep.vel_change_magnitude) *
-                              blampTable.getUnchecked(0);
+  gen.Prepare(kNumSamples);
+  gen.AddBlep(blep);
 
+  const auto& table = gen.table();
   gen.ProcessBlock(buffer, kNumSamples);
 
   // all samples should stay 0 (unmodified) until the blep
@@ -197,38 +166,89 @@ TEST(MinBlepGenerator, ProcessBlock_Applies1StOrderBlep) {
     ASSERT_EQ(buffer[i], 0.0f);
   }
 
-  // The very first affected sample should match the scaled BLAMP start value
-  EXPECT_NEAR(buffer[31], expectedFirst, 1.0e-5f);
-
-  // For the rest, mirror the production stepping and interpolation logic for 1st-order correction
-  for (int i = 32; i < kNumSamples; ++i) {
-    // Gating uses the position branch stepping based on freqMultiple
-    const double outputSamplesSinceBlep = static_cast<double>(blep.offset) + static_cast<double>(i) + 1.0;
-    const double sampleExactGate = static_cast<double>(blep.freqMultiple) * outputSamplesSinceBlep;
-
-    float expected = 0.0f;
-    if (sampleExactGate >= 0.0) {
-      // Derivative table stepping is depth-limited to proportionalBlepFreq
-      const double derivExact = static_cast<double>(gen.proportional_blep_freq_) *
-                                static_cast<double>(gen.over_sampling_ratio_) *
-                                outputSamplesSinceBlep;
-      double derivIdxD = 0.0;
-      const double derivFrac = std::modf(derivExact, &derivIdxD);
-      const int derivIdx = static_cast<int>(derivIdxD);
-
-      if (derivIdx < blampTable.size()) {
-        const float before = blampTable.getUnchecked(derivIdx);
-        const float after = (derivIdx + 1 < blampTable.size())
-                                ? blampTable.getUnchecked(derivIdx + 1)
-                                : before;
-        const float interp = before + static_cast<float>(derivFrac) * (after - before);
-        expected = static_cast<float>(blep.vel_change_magnitude) * interp;
-      } else {
-        expected = 0.0f; // past end of table
-      }
-    }
-
-    EXPECT_NEAR(buffer[i], expected, 1.0e-5f);
+  for (int i = 31; i < kNumSamples; ++i) {
+    const auto index = (i - 31) * audio_plugin::kMinBlepOverSamplingRatio;
+    const float expected =
+        index < static_cast<int>(table.ramp.size())
+            ? static_cast<float>(blep.vel_change_magnitude) *
+                  table.ramp[static_cast<std::size_t>(index)]
+            : 0.0f;
+    EXPECT_NEAR(buffer[i], expected, 1.0e-5f) << "sample " << i;
   }
 }
-}
\ No newline at end of file
+
+TEST(MinBlepGenerator, AddBlep_PlacesSubsampleBlepAtNearestPhase) {
+  audio_plugin::MinBlepGenerator gen;
+
+  constexpr int kNumSamples = 64;
+  float buffer[kNumSamples] = {};
+
+  // a quarter of a sample after sample 10, so sample 10 is the first affected
+  // and it's a quarter of the way into the blep
+  audio_plugin::MinBlepGenerator::BlepOffset blep;
+  blep.offset = -10.75;
+  blep.pos_change_magnitude = 1.0;
+
+  gen.Prepare(kNumSamples);
+  gen.AddBlep(blep);
+  const auto& table = gen.table();
+  gen.ProcessBlock(buffer, kNumSamples);
+
+  EXPECT_EQ(buffer[9], 0.0f);
+  constexpr auto kFirstIndex = audio_plugin::kMinBlepOverSamplingRatio / 4;
+  for (int i = 10; i < 10 + table.length; ++i) {
+    const auto index =
+        kFirstIndex + (i - 10) * audio_plugin::kMinBlepOverSamplingRatio;
+    EXPECT_FLOAT_EQ(buffer[i], table.step[static_cast<std::size_t>(index)])
+        << "sample " << i;
+  }
+}
+
+TEST(MinBlepGenerator, SelectTable_HigherNotesGetLongerKernels) {
+  audio_plugin::MinBlepGenerator gen;
+  auto last_length = 0;
+  for (const double freq_ratio : {0.0, 1.0 / 1024, 1.0 / 256, 1.0 / 64,
+                                  1.0 / 16, 0.5}) {
+    gen.SelectTable(freq_ratio);
+    EXPECT_GE(gen.table().length, last_length) << "freq ratio " << freq_ratio;
+    last_length = gen.table().length;
+  }
+  EXPECT_EQ(last_length, audio_plugin::kMinBlepTables.back().length);
+  gen.SelectTable(0.0);
+  EXPECT_EQ(gen.table().length, audio_plugin::kMinBlepTables.front().length);
+}
+
+TEST(MinBlepGenerator, ProcessBlock_CarriesBlepTailIntoLaterBlocks) {
+  constexpr int kBlockSize = 16;
+  constexpr int kNumBlocks = 8;
+  constexpr int kTotalSamples = kBlockSize * kNumBlocks;
+
+  audio_plugin::MinBlepGenerator::BlepOffset blep;
+  blep.offset = -10.25; // near the end of the first block, so the blep spans
+                        // several more
+  blep.pos_change_magnitude = 2.0;
+  blep.vel_change_magnitude = 1.0;
+
+  // everything in one block
+  audio_plugin::MinBlepGenerator whole;
+  whole.Prepare(kTotalSamples);
+  whole.AddBlep(blep);
+  float expected[kTotalSamples] = {};
+  whole.ProcessBlock(expected, kTotalSamples);
+  EXPECT_TRUE(whole.IsClear());
+
+  // same blep, output a block at a time
+  audio_plugin::MinBlepGenerator split;
+  split.Prepare(kBlockSize);
+  split.AddBlep(blep);
+  float actual[kTotalSamples] = {};
+  for (int block = 0; block < kNumBlocks; ++block) {
+    split.ProcessBlock(actual + block * kBlockSize, kBlockSize);
+  }
+  EXPECT_TRUE(split.IsClear());
+
+  for (int i = 0; i < kTotalSamples; ++i) {
+    EXPECT_FLOAT_EQ(actual[i], expected[i]) << "sample " << i;
+  }
+}
+}
@@ -0,0 +1,137 @@
+// Unit test for OTAFilterBank, against the filters run on their own
+#include <../../plugin/source/filter/OTAFilterBank.h>
+#include <gtest/gtest.h>
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using audio_plugin::MathQuality;
+using audio_plugin::ModulationBus;
+using audio_plugin::OTAFilterBank;
+using audio_plugin::OTAFilterTPTNewtonRaphson;
+
+namespace audio_plugin_test {
+constexpr double kSampleRate = 96000.0;
+constexpr int kBlockSize = 256;
+constexpr int kNumBlocks = 4;
+// more than fit in the lanes, so the bank runs them in a few goes
+constexpr int kNumFilters = 11;
+
+class OTAFilterBankTest : public testing::TestWithParam<MathQuality> {
+ protected:
+  void SetUp() override {
+    mod_bus_.Prepare(kBlockSize);
+    for (const auto source :
+         {ModulationBus::kLfo, ModulationBus::kEnv1, ModulationBus::kEnv2}) {
+      auto* data = mod_bus_.buffer(source).getWritePointer(0);
+      for (int i = 0; i < kBlockSize; ++i) {
+        data[i] = std::sin(static_cast<float>(i * (source + 1)) * .01f);
+      }
+    }
+    for (int f = 0; f < kNumFilters; ++f) {
+      for (auto* filters : {&banked_, &alone_}) {
+        auto& filter = filters->emplace_back(
+            std::make_unique<OTAFilterTPTNewtonRaphson>(mod_bus_));
+        Configure(*filter, f);
+      }
+    }
+  }
+
+  // different settings for every filter
+  void Configure(OTAFilterTPTNewtonRaphson& filter, const int f) const {
+    filter.set_sample_rate(kSampleRate);
+    filter.set_math_quality(GetParam());
+    filter.set_env_source(f % 2 == 0 ? ModulationBus::kEnv1
+                                     : ModulationBus::kEnv2);
+    filter.cutoff_freq_ = 200.f + 900.f * static_cast<float>(f);
+    filter.resonance_ = .1f * static_cast<float>(f % 10);
+    filter.drive_ = .2f + .3f * static_cast<float>(f);
+    filter.env_mod_ = .05f * static_cast<float>(f % 4);
+    filter.lfo_mod_ = .02f * static_cast<float>(f % 3);
+    filter.set_num_stages(2 + f % 3);
+    filter.input_drive_scales_ = {1.f, .9f, .8f, .7f};
+    filter.state_drive_scales_ = {1.f, 1.1f, 1.2f, 1.3f};
+  }
+
+  ModulationBus mod_bus_;
+  std::vector<std::unique_ptr<OTAFilterTPTNewtonRaphson>> banked_;
+  std::vector<std::unique_ptr<OTAFilterTPTNewtonRaphson>> alone_;
+};
+
+// a saw at a different pitch for each filter, loud enough to drive them in
+// some blocks and quiet enough for them to be linear in others
+float Input(const int f, const int block, const int i) {
+  const auto phase = static_cast<float>((block * kBlockSize + i) * (f + 3)) /
+                     300.f;
+  const auto level = (f + block) % 3 == 0 ? 1.f
+                     : (f + block) % 3 == 1 ? 1e-3f
+                                            : 1e-6f;
+  return level * (2.f * (phase - std::floor(phase)) - 1.f);
+}
+
+TEST_P(OTAFilterBankTest, MatchesFiltersAlone) {
+  OTAFilterBank bank;
+  std::vector<juce::AudioBuffer<float>> banked_buffers;
+  std::vector<juce::AudioBuffer<float>> alone_buffers;
+  for (int f = 0; f < kNumFilters; ++f) {
+    banked_buffers.emplace_back(1, kBlockSize);
+    alone_buffers.emplace_back(1, kBlockSize);
+  }
+
+  for (int block = 0; block < kNumBlocks; ++block) {
+    for (int f = 0; f < kNumFilters; ++f) {
+      const auto index = static_cast<std::size_t>(f);
+      // blocks of a few lengths (so some filters share the lanes and some
+      // don't), at different offsets, some left out entirely
+      const auto start_sample = f % 2 * 32;
+      const auto num_samples = (block + f) % 5 == 0  ? 0
+                               : f == kNumFilters - 1 ? 64
+                               : f % 3 == 0           ? 96
+                                                      : 192;
+      for (auto* buffers : {&banked_buffers, &alone_buffers}) {
+        auto* data = (*buffers)[index].getWritePointer(0);
+        for (int i = 0; i < kBlockSize; ++i) {
+          data[i] = Input(f, block, i);
+        }
+      }
+      bank.Add(*banked_[index], banked_buffers[index], start_sample,
+               num_samples);
+      alone_[index]->Process(alone_buffers[index], start_sample, num_samples);
+    }
+    bank.Process();
+
+    for (int f = 0; f < kNumFilters; ++f) {
+      const auto index = static_cast<std::size_t>(f);
+      const auto* banked = banked_buffers[index].getReadPointer(0);
+      const auto* alone = alone_buffers[index].getReadPointer(0);
+      for (int i = 0; i < kBlockSize; ++i) {
+        ASSERT_EQ(std::bit_cast<uint32_t>(banked[i]),
+                  std::bit_cast<uint32_t>(alone[i]))
+            << "filter " << f << ", block " << block << ", sample " << i;
+      }
+    }
+  }
+
+  std::uint64_t linear_samples = 0;
+  for (int f = 0; f < kNumFilters; ++f) {
+    const auto index = static_cast<std::size_t>(f);
+    const auto& banked = banked_[index]->solver_stats();
+    const auto& alone = alone_[index]->solver_stats();
+    EXPECT_EQ(banked.samples, alone.samples) << "filter " << f;
+    EXPECT_EQ(banked.iterations, alone.iterations) << "filter " << f;
+    EXPECT_EQ(banked.linear_samples, alone.linear_samples) << "filter " << f;
+    linear_samples += alone.linear_samples;
+  }
+  // both ways of solving were tested
+  EXPECT_GT(linear_samples, 0u);
+  EXPECT_LT(linear_samples, kNumFilters * kBlockSize * kNumBlocks);
+}
+
+INSTANTIATE_TEST_SUITE_P(MathQualities, OTAFilterBankTest,
+                         testing::Values(MathQuality::kFast,
+                                         MathQuality::kHigh,
+                                         MathQuality::kExact));
+}  // namespace audio_plugin_test
@@ -0,0 +1,109 @@
+// Unit test for the oscillator voice's choice of oversampling factor
+#include <../../plugin/source/oscillator/Oscillator.h>
+#include <gtest/gtest.h>
+
+#include <utility>
+
+using audio_plugin::kDefaultOversample;
+using audio_plugin::kMaxCutoff;
+using audio_plugin::kMaxOversample;
+using audio_plugin::kMinDrive;
+using audio_plugin::kParamSpecs;
+using audio_plugin::ModulationBus;
+using audio_plugin::OTAFilterTPTNewtonRaphson;
+using audio_plugin::OversampleSettings;
+using audio_plugin::ParamId;
+using audio_plugin::PickOversampleFactor;
+
+namespace audio_plugin_test {
+constexpr double kSampleRate = 48000.0;
+// middle C, and a note high enough to alias at 1x
+constexpr double kLowNoteHz = 261.63;
+constexpr double kHighNoteHz = 2093.0;
+
+float Default(const ParamId id) {
+  return kParamSpecs[std::to_underlying(id)].default_value;
+}
+
+// A clean patch: sine into the TPT filter at a low cutoff, driven hard
+// enough to stay linear
+OversampleSettings Clean() {
+  OversampleSettings settings;
+  settings.filter_type = 1;
+  settings.harmonic_rich = false;
+  settings.filter_drive = 10.f;
+  settings.max_cutoff = 1000.f;
+  return settings;
+}
+
+TEST(OscillatorOversampleTest, DefaultPatchKeepsDefaultFactor) {
+  // the default patch: a saw into the TPT filter, fully open
+  ModulationBus mod_bus;
+  OTAFilterTPTNewtonRaphson filter{mod_bus};
+  filter.cutoff_freq_ = Default(ParamId::kFilterCutoffFreq);
+  filter.env_mod_ = Default(ParamId::kFilterEnvMod);
+  filter.lfo_mod_ = Default(ParamId::kFilterLfoMod);
+  OversampleSettings settings;
+  settings.filter_type = static_cast<int>(Default(ParamId::kVcfFilterType));
+  settings.harmonic_rich = Default(ParamId::kWaveType) > 0.f &&
+                           Default(ParamId::kVco1Level) > 0.f;
+  settings.spread_spectrum = Default(ParamId::kCrossMod) > 0.f ||
+                             Default(ParamId::kVco2Sync) > .5f;
+  settings.filter_drive = Default(ParamId::kFilterDrive);
+  settings.filter_resonance = Default(ParamId::kFilterResonance);
+  settings.max_cutoff = filter.max_modulated_cutoff();
+  EXPECT_FLOAT_EQ(settings.max_cutoff, kMaxCutoff);
+
+  // it has always run at kDefaultOversample
+  for (const auto note_hz : {kLowNoteHz, kHighNoteHz}) {
+    for (const auto sample_rate : {44100.0, kSampleRate}) {
+      EXPECT_EQ(PickOversampleFactor(settings, note_hz, sample_rate,
+                                     kDefaultOversample),
+                kDefaultOversample);
+    }
+  }
+  // and there its cutoff gets all the way up
+  const auto oversampled_rate = kSampleRate * kDefaultOversample;
+  EXPECT_GE(OTAFilterTPTNewtonRaphson::HighestCutoff(oversampled_rate),
+            static_cast<double>(kMaxCutoff));
+}
+
+TEST(OscillatorOversampleTest, LowerDriveSaturatesMore) {
+  auto settings = Clean();
+  EXPECT_EQ(PickOversampleFactor(settings, kLowNoteHz, kSampleRate,
+                                 kMaxOversample),
+            1);
+  settings.filter_drive = 2.f;
+  EXPECT_EQ(PickOversampleFactor(settings, kLowNoteHz, kSampleRate,
+                                 kMaxOversample),
+            2);
+  settings.filter_drive = kMinDrive;
+  settings.harmonic_rich = true;
+  EXPECT_EQ(PickOversampleFactor(settings, kLowNoteHz, kSampleRate,
+                                 kMaxOversample),
+            4);
+  EXPECT_EQ(PickOversampleFactor(settings, kHighNoteHz, kSampleRate,
+                                 kMaxOversample),
+            8);
+  // and no more than the ceiling
+  EXPECT_EQ(PickOversampleFactor(settings, kHighNoteHz, kSampleRate, 2), 2);
+}
+
+TEST(OscillatorOversampleTest, TPTRunsFastEnoughForItsCutoff) {
+  auto settings = Clean();
+  // g's clamp holds the cutoff to about 11 kHz at 48 kHz
+  settings.max_cutoff = 15000.f;
+  EXPECT_EQ(PickOversampleFactor(settings, kLowNoteHz, kSampleRate,
+                                 kMaxOversample),
+            2);
+  // about 20.6 kHz at 88.2 kHz
+  settings.max_cutoff = kMaxCutoff;
+  EXPECT_EQ(
+      PickOversampleFactor(settings, kLowNoteHz, 44100.0, kMaxOversample), 4);
+  // the other filters don't clamp
+  settings.filter_type = 2;
+  EXPECT_EQ(PickOversampleFactor(settings, kLowNoteHz, kSampleRate,
+                                 kMaxOversample),
+            1);
+}
+}  // namespace audio_plugin_test
@@ -0,0 +1,61 @@
+// Unit test for VoiceBus, against a downsampler that never stops
+#include <../../plugin/source/dsp/VoiceBus.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+using audio_plugin::Downsampler;
+using audio_plugin::VoiceBus;
+
+namespace audio_plugin_test {
+// small host blocks, so the downsampler's tail lasts many of them
+constexpr int kBlockSize = 32;
+constexpr int kFactor = 4;
+// a note, a gap long enough for the bus to stop downsampling, then another
+// note
+constexpr int kNoteBlocks = 8;
+constexpr int kGapBlocks = 400;
+constexpr int kNumBlocks = kNoteBlocks + kGapBlocks + kNoteBlocks;
+
+bool Playing(const int block) {
+  return block < kNoteBlocks || block >= kNoteBlocks + kGapBlocks;
+}
+
+// a loud square wave at the oversampled rate, which leaves the filters
+// ringing when it stops
+float Input(const int block, const int i) {
+  return ((block * kBlockSize * kFactor + i) / 50) % 2 == 0 ? 1.f : -1.f;
+}
+
+// The bus only runs a downsampler while something is added to it and for
+// its tail after, so across the gap it has to match one that runs all
+// along, to well below hearing: a tail cut short would drop out, and the
+// stale state left over would click when the second note starts.
+TEST(VoiceBusTest, RingsOutBetweenNotes) {
+  VoiceBus bus;
+  bus.Prepare(kBlockSize);
+  Downsampler reference;
+  reference.prepare(kBlockSize, kFactor);
+  juce::AudioBuffer<float> input{1, kBlockSize * kFactor};
+  juce::AudioBuffer<float> expected{1, kBlockSize};
+  juce::AudioBuffer<float> output{1, kBlockSize};
+
+  for (int block = 0; block < kNumBlocks; ++block) {
+    bus.Clear(kBlockSize);
+    auto* data = input.getWritePointer(0);
+    for (int i = 0; i < kBlockSize * kFactor; ++i) {
+      data[i] = Playing(block) ? Input(block, i) : 0.f;
+    }
+    if (Playing(block)) {
+      bus.buffer(kFactor).addFrom(0, 0, input, 0, 0, kBlockSize * kFactor);
+    }
+    bus.Downsample(output, kBlockSize);
+    reference.process(input, expected, 0, kBlockSize * kFactor);
+
+    for (int i = 0; i < kBlockSize; ++i) {
+      ASSERT_NEAR(output.getSample(0, i), expected.getSample(0, i), 1e-5f)
+          << "block " << block << ", sample " << i;
+    }
+  }
+}
+}  // namespace audio_plugin_test
@@ -2,7 +2,11 @@
 #include <../../plugin/source/oscillator/WaveGenerator.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <bit>
 #include <cmath>
+#include <cstdint>
+#include <vector>
 
 using audio_plugin::WaveGenerator;
 using audio_plugin::WaveType;
@@ -15,22 +19,23 @@ constexpr int kNumSamples = 1024;
 
 inline void PrepareAndRender(WaveGenerator<false>& gen,
                              juce::AudioSampleBuffer& raw_buf,
-                             const WaveType type) {
-  gen.PrepareToPlay(kSampleRate);
+                             const WaveType type,
+                             const WaveMode mode = audio_plugin::BUILD_AA) {
+  gen.PrepareToPlay(kSampleRate, kNumSamples);
   gen.set_wave_type(type);
   gen.set_pitch_hz(kFreq);
   // for more predictable results, we disable the dc blocker so there isn't
   // any filtering going on
   gen.set_dc_blocker_enabled(false);
-  // build with BUILD_AA to populate BLEP offsets without consuming them
-  // (so no AA filtering is going on)
-  gen.set_mode(audio_plugin::BUILD_AA);
+  // build with BUILD_AA (by default) to populate BLEP offsets without
+  // consuming them (so no AA filtering is going on)
+  gen.set_mode(mode);
 
   raw_buf.clear();
   // Warm up gain ramp so second call uses constant gain
   gen.RenderNextBlock(raw_buf, 0, kNumSamples);
   raw_buf.clear();
-  gen.blep_generator()->currentActiveBlepOffsets.clear();
+  gen.clear_detected_bleps();
   gen.RenderNextBlock(raw_buf, 0, kNumSamples);
 }
 
@@ -47,15 +52,14 @@ class WaveGeneratorSawTest : public ::testing::TestWithParam<SawCase> {
 TEST_P(WaveGeneratorSawTest, RendersAndReportsBleps) {
   const auto [type, expected_pos_change, ramp_up, reset_level] = GetParam();
 
-  juce::AudioBuffer<float> dummy;
+  audio_plugin::ModulationBus mod_bus;
   juce::Array<float> dummy_indices;
-  WaveGenerator<false> gen(dummy, dummy, dummy, dummy, dummy_indices);
+  WaveGenerator<false> gen(mod_bus, dummy_indices);
   juce::AudioSampleBuffer raw_buf(2, kNumSamples);
   PrepareAndRender(gen, raw_buf, type);
 
   // Validate BLEPs were detected at expected rate (one per period)
-  auto* blep_gen = gen.blep_generator();
-  const auto& bleps = blep_gen->currentActiveBlepOffsets;
+  const auto& bleps = gen.detected_bleps();
 
   ASSERT_EQ(bleps.size(), 10);
 
@@ -100,15 +104,14 @@ INSTANTIATE_TEST_SUITE_P(
 
 
 TEST(WaveGeneratorTriangleTest, RendersAndReportsTriangleBleps) {
-  juce::AudioBuffer<float> dummy;
+  audio_plugin::ModulationBus mod_bus;
   juce::Array<float> dummy_indices;
-  WaveGenerator<false> gen(dummy, dummy, dummy, dummy, dummy_indices);
+  WaveGenerator<false> gen(mod_bus, dummy_indices);
   juce::AudioSampleBuffer raw_buf(2, kNumSamples);
   PrepareAndRender(gen, raw_buf, audio_plugin::triangle);
 
   // Validate BLEPs: triangle has first-derivative discontinuities twice per period
-  auto* blep_gen = gen.blep_generator();
-  const auto& bleps = blep_gen->currentActiveBlepOffsets;
+  const auto& bleps = gen.detected_bleps();
 
   EXPECT_EQ(bleps.size(), 19);
 
@@ -158,15 +161,14 @@ TEST(WaveGeneratorTriangleTest, RendersAndReportsTriangleBleps) {
 }
 
 TEST(WaveGeneratorSquareTest, RendersAndReportsSquareBleps) {
-  juce::AudioBuffer<float> dummy;
+  audio_plugin::ModulationBus mod_bus;
   juce::Array<float> dummy_indices;
-  WaveGenerator<false> gen(dummy, dummy, dummy, dummy, dummy_indices);
+  WaveGenerator<false> gen(mod_bus, dummy_indices);
   juce::AudioSampleBuffer raw_buf(2, kNumSamples);
   PrepareAndRender(gen, raw_buf, audio_plugin::square);
 
   // BLEPs: square has position discontinuities twice per period
-  auto* blep_gen = gen.blep_generator();
-  const auto& bleps = blep_gen->currentActiveBlepOffsets;
+  const auto& bleps = gen.detected_bleps();
 
   EXPECT_EQ(bleps.size(), 19);
 
@@ -209,4 +211,224 @@ TEST(WaveGeneratorSquareTest, RendersAndReportsSquareBleps) {
     prev = s;
   }
 }
-}
\ No newline at end of file
+
+TEST(WaveGeneratorSquareTest, PolyBlepSpreadsStepsWithoutOvershoot) {
+  audio_plugin::ModulationBus mod_bus;
+  juce::Array<float> dummy_indices;
+  WaveGenerator<false> gen(mod_bus, dummy_indices);
+  juce::AudioSampleBuffer raw_buf(2, kNumSamples);
+  PrepareAndRender(gen, raw_buf, audio_plugin::square, audio_plugin::POLYBLEP);
+
+  // nothing is recorded outside of BUILD_AA
+  EXPECT_EQ(gen.detected_bleps().size(), 0);
+
+  // full scale, only ANTIALIAS is scaled down
+  constexpr float kLevel = 1.f;
+  const float* ch0 = raw_buf.getReadPointer(0);
+  int transitions = 0;
+  for (int i = 1; i < kNumSamples; ++i) {
+    // the corrections only ever move samples towards the other level
+    EXPECT_LE(std::abs(ch0[i]), kLevel + 1e-2f);
+    // the step is spread over 2 samples, so no single sample makes more
+    // than 3/4 of it
+    const float diff = std::abs(ch0[i] - ch0[i - 1]);
+    EXPECT_LT(diff, .76f * 2 * kLevel);
+    if (diff > .5f * kLevel) {
+      transitions++;
+    }
+  }
+  // one (or two, if the step is near the middle of a sample) big step per
+  // transition, 19 transitions
+  EXPECT_GE(transitions, 19);
+  EXPECT_LE(transitions, 2 * 19);
+}
+
+// Cross mod switches the oscillators in and out of POLYBLEP, which outputs a
+// sample late. Going in, the first block has to start from the sample the
+// last one ended on, and coming out the held back sample can't be lost.
+TEST(WaveGeneratorPolyBlepTest, SwitchesModeWithoutClicks) {
+  // slow enough that a sample's step is tiny next to a click
+  constexpr double kSlowFreq = 20.0;
+  constexpr int kBlockSize = 64;
+  constexpr int kNumBlocks = 36;
+  constexpr auto kSlope = static_cast<float>(2 * kSlowFreq / kSampleRate);
+
+  audio_plugin::ModulationBus mod_bus;
+  juce::Array<float> dummy_indices;
+  WaveGenerator<false> gen(mod_bus, dummy_indices);
+  gen.PrepareToPlay(kSampleRate, kBlockSize);
+  gen.set_wave_type(audio_plugin::sawFall);
+  gen.set_pitch_hz(kSlowFreq);
+  gen.set_dc_blocker_enabled(false);
+
+  juce::AudioSampleBuffer buf(1, kBlockSize * kNumBlocks);
+  buf.clear();
+  for (int block = 0; block < kNumBlocks; ++block) {
+    // both modes are full scale, so the level doesn't change either
+    gen.set_mode(block % 3 == 1 ? audio_plugin::POLYBLEP
+                                : audio_plugin::NO_ANTIALIAS);
+    gen.RenderNextBlock(buf, block * kBlockSize, kBlockSize);
+  }
+
+  // a steady ramp up apart from the reset, which POLYBLEP spreads over 2
+  // samples. Across a switch a step can be half again as big, when the held
+  // sample is averaged in, or none at all, when it's repeated.
+  const float* data = buf.getReadPointer(0);
+  int reset_steps = 0;
+  for (int i = 1; i < buf.getNumSamples(); ++i) {
+    const auto step = data[i] - data[i - 1];
+    if (step < -.5f) {
+      reset_steps++;
+      continue;
+    }
+    EXPECT_GE(step, -1e-6f) << "sample " << i;
+    EXPECT_LE(step, 1.5f * kSlope + 1e-6f) << "sample " << i;
+  }
+  EXPECT_GE(reset_steps, 1);
+  EXPECT_LE(reset_steps, 2);
+}
+
+class WaveGeneratorPhaseAccumulatorTest
+    : public ::testing::TestWithParam<WaveType> {};
+
+// Through-zero cross mod: with VCO 2 at -1 the pitch is -3 times the note's,
+// so the wave runs backwards.
+constexpr float kThroughZeroCrossMod = 4.f;
+
+TEST_P(WaveGeneratorPhaseAccumulatorTest, MatchesAngleBasedWave) {
+  for (const auto cross_mod : {0.f, kThroughZeroCrossMod}) {
+    SCOPED_TRACE(testing::Message() << "cross mod " << cross_mod);
+    audio_plugin::ModulationBus mod_bus;
+    mod_bus.Prepare(kNumSamples);
+    auto* modulator =
+        mod_bus.buffer(audio_plugin::ModulationBus::kModulator)
+            .getWritePointer(0);
+    std::fill(modulator, modulator + kNumSamples, -1.f);
+    juce::Array<float> dummy_indices;
+    WaveGenerator<false> angle_gen(mod_bus, dummy_indices);
+    WaveGenerator<false> phase_gen(mod_bus, dummy_indices);
+    phase_gen.set_phase_accumulator_enabled(true);
+    for (auto* gen : {&angle_gen, &phase_gen}) {
+      gen->set_cross_mod(cross_mod);
+    }
+    juce::AudioSampleBuffer angle_buf(2, kNumSamples);
+    juce::AudioSampleBuffer phase_buf(2, kNumSamples);
+    PrepareAndRender(angle_gen, angle_buf, GetParam());
+    PrepareAndRender(phase_gen, phase_buf, GetParam());
+
+    // same discontinuities, in the same places - at most two a period, not
+    // one every sample
+    const auto& angle_bleps = angle_gen.detected_bleps();
+    const auto& phase_bleps = phase_gen.detected_bleps();
+    ASSERT_EQ(phase_bleps.size(), angle_bleps.size());
+    EXPECT_LT(phase_bleps.size(), kNumSamples / 8);
+    for (int i = 0; i < angle_bleps.size(); ++i) {
+      EXPECT_NEAR(phase_bleps[i].offset, angle_bleps[i].offset, 1e-4);
+      EXPECT_NEAR(phase_bleps[i].pos_change_magnitude,
+                  angle_bleps[i].pos_change_magnitude, 1e-6);
+      EXPECT_NEAR(phase_bleps[i].vel_change_magnitude,
+                  angle_bleps[i].vel_change_magnitude, 1e-3);
+    }
+
+    // and the same wave, apart from samples right on a discontinuity
+    int differing = 0;
+    for (int i = 0; i < kNumSamples; ++i) {
+      if (std::abs(phase_buf.getSample(0, i) - angle_buf.getSample(0, i)) >
+          1e-4f) {
+        differing++;
+      }
+    }
+    EXPECT_LE(differing, 1);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(WaveGenerator, WaveGeneratorPhaseAccumulatorTest,
+                         ::testing::Values(audio_plugin::sine,
+                                           audio_plugin::sawRise,
+                                           audio_plugin::sawFall,
+                                           audio_plugin::triangle,
+                                           audio_plugin::square));
+
+struct MixCase {
+  WaveMode mode_;
+  bool hard_sync_;
+  bool vca_;
+};
+
+class WaveGeneratorRenderMixedTest : public ::testing::TestWithParam<MixCase> {
+};
+
+// RenderMixed is the voice's fused oscillator stage, so it has to come out
+// exactly the same as rendering each generator in turn and then applying the
+// VCA, across blocks of any size
+TEST_P(WaveGeneratorRenderMixedTest, MatchesSeparatePasses) {
+  const auto [mode, hard_sync, vca] = GetParam();
+  audio_plugin::ModulationBus mod_bus;
+  mod_bus.Prepare(kNumSamples);
+  // a separately rendered pair and a mixed pair, each with its own sync
+  // reset points
+  juce::Array<float> separate_indices;
+  juce::Array<float> mixed_indices;
+  WaveGenerator<false> separate1(mod_bus, separate_indices);
+  WaveGenerator<false> separate2(mod_bus, separate_indices);
+  WaveGenerator<false> mixed1(mod_bus, mixed_indices);
+  WaveGenerator<false> mixed2(mod_bus, mixed_indices);
+  for (auto* gen : {&separate1, &separate2, &mixed1, &mixed2}) {
+    gen->PrepareToPlay(kSampleRate, kNumSamples);
+    gen->set_mode(mode);
+    gen->set_phase_accumulator_enabled(true);
+  }
+  for (auto* gen : {&separate1, &mixed1}) {
+    gen->set_wave_type(audio_plugin::sawFall);
+    gen->set_pitch_hz(kFreq);
+    gen->set_hard_sync_mode(hard_sync ? audio_plugin::PRIMARY
+                                      : audio_plugin::DISABLED);
+  }
+  for (auto* gen : {&separate2, &mixed2}) {
+    gen->set_wave_type(audio_plugin::square);
+    gen->set_pitch_hz(kFreq * 1.37);
+    gen->set_hard_sync_mode(hard_sync ? audio_plugin::SECONDARY
+                                      : audio_plugin::DISABLED);
+  }
+
+  std::vector<float> envelope(static_cast<std::size_t>(kNumSamples));
+  for (std::size_t i = 0; i < envelope.size(); ++i) {
+    envelope[i] = static_cast<float>(i) / static_cast<float>(kNumSamples);
+  }
+  juce::AudioSampleBuffer separate_buf(1, kNumSamples);
+  juce::AudioSampleBuffer mixed_buf(1, kNumSamples);
+  // blocks that don't line up with anything in particular
+  for (const auto block_size : {1, 100, 257, 64, 333}) {
+    for (int block = 0; block < 4; ++block) {
+      separate_buf.clear(0, 0, block_size);
+      separate1.RenderNextBlock(separate_buf, 0, block_size);
+      separate2.RenderNextBlock(separate_buf, 0, block_size);
+      auto* separate = separate_buf.getWritePointer(0);
+      if (vca) {
+        for (int i = 0; i < block_size; ++i) {
+          separate[i] *= envelope[static_cast<std::size_t>(i)];
+        }
+      }
+      WaveGenerator<false>::RenderMixed({&mixed1, &mixed2}, mixed_buf, 0,
+                                        block_size,
+                                        vca ? envelope.data() : nullptr);
+      const auto* mixed = mixed_buf.getReadPointer(0);
+      for (int i = 0; i < block_size; ++i) {
+        ASSERT_EQ(std::bit_cast<std::uint32_t>(mixed[i]),
+                  std::bit_cast<std::uint32_t>(separate[i]))
+            << "block size " << block_size << ", sample " << i << ": "
+            << mixed[i] << " vs " << separate[i];
+      }
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    WaveGenerator, WaveGeneratorRenderMixedTest,
+    ::testing::Values(MixCase{audio_plugin::ANTIALIAS, false, false},
+                      MixCase{audio_plugin::ANTIALIAS, false, true},
+                      MixCase{audio_plugin::ANTIALIAS, true, true},
+                      MixCase{audio_plugin::POLYBLEP, false, true},
+                      MixCase{audio_plugin::POLYBLEP, true, false},
+                      MixCase{audio_plugin::NO_ANTIALIAS, false, true}));
+}